@@ -0,0 +1,106 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include "Base/Base.h"
+#include "Base/Timer.h"
+#include "SubhypergraphMatching/HyperGraphGenerator.h"
+using namespace std;
+using namespace GraphLib;
+
+/**
+ * @brief Read a motif in the query format: "|V| |E|", the vertex labels, then one comma-separated hyperedge per line
+ */
+void ReadMotif(const std::string &filename, std::vector<int> &labels, std::vector<std::vector<int>> &hyperedges) {
+    std::ifstream fin(filename);
+    if (!fin.is_open()) {
+        fprintf(stderr, "Cannot open motif %s\n", filename.c_str());
+        exit(1);
+    }
+    int n = 0, m = 0;
+    fin >> n >> m;
+    labels.resize(n);
+    for (int &l : labels) fin >> l;
+    std::string line;
+    for (int i = 0; i < m; i++) {
+        fin >> line;
+        hyperedges.emplace_back();
+        for (auto &elem : parse(line, ",")) hyperedges.back().push_back(stoi(elem));
+    }
+}
+
+/**
+ * Usage: -d dataset [-p path] [-n num_vertices] [-m num_hyperedges] [-a min_arity] [-A max_arity] [-x arity_skew]
+ *        [-g degree_skew] [-l num_labels] [-L label_skew] [-q motif.txt -k num_planted] [-s seed] [-T threads]
+ * Writes path/dataset/hyperedges-dataset.txt and node-labels-dataset.txt. The output only depends on the options,
+ * so a seed identifies an instance. -q plants num_planted copies of the motif (a query file).
+ */
+int32_t main(int argc, char *argv[]) {
+    std::string dataset = "synthetic", path = "../dataset/hypergraphs/", motif;
+    SubHyperGraphMatching::HyperGraphGeneratorOption opt;
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] == '-') {
+            switch (argv[i][1]) {
+                case 'd':
+                    dataset = argv[i + 1];
+                    break;
+                case 'p':
+                    path = argv[i + 1];
+                    break;
+                case 'n':
+                    opt.num_vertices = atoll(argv[i + 1]);
+                    break;
+                case 'm':
+                    opt.num_hyperedges = atoll(argv[i + 1]);
+                    break;
+                case 'a':
+                    opt.min_arity = atoi(argv[i + 1]);
+                    break;
+                case 'A':
+                    opt.max_arity = atoi(argv[i + 1]);
+                    break;
+                case 'x':
+                    opt.arity_skew = atof(argv[i + 1]);
+                    break;
+                case 'g':
+                    opt.degree_skew = atof(argv[i + 1]);
+                    break;
+                case 'l':
+                    opt.num_labels = atoi(argv[i + 1]);
+                    break;
+                case 'L':
+                    opt.label_skew = atof(argv[i + 1]);
+                    break;
+                case 'q':
+                    motif = argv[i + 1];
+                    break;
+                case 'k':
+                    opt.num_planted = atoll(argv[i + 1]);
+                    break;
+                case 's':
+                    opt.seed = strtoull(argv[i + 1], nullptr, 10);
+                    break;
+                case 'T':
+                    num_worker_threads = std::max(1, atoi(argv[i + 1]));
+                    break;
+            }
+        }
+    }
+    // the generator also checks the total with the planted motifs, once it is known
+    if (opt.num_vertices > std::numeric_limits<int>::max()) {
+        fprintf(stderr, "At most %d vertices are supported\n", std::numeric_limits<int>::max());
+        return 1;
+    }
+    SubHyperGraphMatching::HyperGraphGenerator generator(opt);
+    if (!motif.empty()) {
+        std::vector<int> labels;
+        std::vector<std::vector<int>> hyperedges;
+        ReadMotif(motif, labels, hyperedges);
+        generator.SetPlantedMotif(labels, hyperedges);
+    }
+    Timer timer;
+    timer.Start();
+    long long total_arity = generator.Write(dataset, path);
+    timer.Stop();
+    fprintf(stderr, "Generated %s: %lld vertices, %lld hyperedges, %lld incidences in %.02lf ms\n", dataset.c_str(),
+            generator.GetNumVertices(), generator.GetNumHyperedges(), total_arity, timer.GetTime());
+}
@@ -0,0 +1,467 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <unistd.h>
+#include "Base/Base.h"
+#include "Base/BasicAlgorithms.h"
+#include "Base/Random.h"
+#include "Base/ResultTable.h"
+#include "Base/Timer.h"
+#include "DataStructure/Graph.h"
+#include "SpecialSubgraphs/SmallCycle.h"
+#include "SubgraphMatching/DataGraph.h"
+#include "SubgraphMatching/PatternGraph.h"
+#include "SubgraphMatching/CandidateSpace.h"
+#include "SubgraphMatching/CandidateFilter.h"
+#include "SubgraphMatching/Backtrack.h"
+#include "SubhypergraphMatching/DataHyperGraph.h"
+#include "SubhypergraphMatching/PatternHyperGraph.h"
+#include "SubhypergraphMatching/HyperCandidateSpace.h"
+using namespace std;
+using namespace GraphLib;
+
+/**
+ * @brief Microbenchmarks of the hot kernels on synthetic inputs of controlled size and skew.
+ * @details Every kernel is run repeatedly until it has been timed for at least min_time_ms; per-op setup (e.g.
+ * restoring a candidate space that the kernel destroys) is not timed. Reported per kernel and input:
+ * ns per op and items per second, where the items of an op are what the kernel scans (list elements,
+ * bipartite edges, candidate pairs, graph edges, ...).
+ */
+struct BenchmarkOption {
+    double min_time_ms = 200.0;
+    // multiplies the input sizes
+    int scale = 1;
+    // Zipf exponent of degrees and labels of the synthetic graphs
+    double skew = 0.5;
+    unsigned seed = 42;
+    // only kernels whose name contains this
+    std::string filter;
+    // if set, the data graph of the graph kernels is loaded from this snapshot, written there on the first run
+    std::string snapshot;
+};
+
+template <typename T>
+inline void DoNotOptimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class MicroBenchmark {
+    BenchmarkOption opt;
+    FILE *out;
+    ResultTable *results;
+
+    void Report(const std::string &kernel, const std::string &input, long long num_ops, double total_ms,
+                double items_per_op) {
+        double ns_per_op = total_ms * 1e6 / num_ops;
+        double items_per_sec = items_per_op * num_ops / (total_ms / 1e3);
+        if (items_per_op > 0) {
+            fprintf(out, "%-28s %-36s %14.1lf ns/op %12.3e items/s %10lld ops\n", kernel.c_str(), input.c_str(),
+                    ns_per_op, items_per_sec, num_ops);
+        }
+        else {
+            fprintf(out, "%-28s %-36s %14.1lf ns/op %12s items/s %10lld ops\n", kernel.c_str(), input.c_str(),
+                    ns_per_op, "-", num_ops);
+        }
+        fflush(out);
+        if (results != nullptr) {
+            results->Set("kernel", kernel);
+            results->Set("input", input);
+            results->Set("ns_per_op", ns_per_op);
+            results->Set("items_per_sec", items_per_sec);
+            results->Set("ops", num_ops);
+            results->EndRow();
+        }
+    }
+public:
+    MicroBenchmark(const BenchmarkOption &opt_, FILE *out_, ResultTable *results_)
+        : opt(opt_), out(out_), results(results_) {}
+
+    bool Selected(const std::string &kernel) const {
+        return opt.filter.empty() or kernel.find(opt.filter) != std::string::npos;
+    }
+
+    /**
+     * @brief Time op in batches (doubling the batch size) until a batch takes at least min_time_ms
+     * @param items_per_op items processed by one op, for the items/s column; 0 reports ns/op only
+     */
+    template <typename Op>
+    void Run(const std::string &kernel, const std::string &input, double items_per_op, Op &&op) {
+        if (!Selected(kernel)) return;
+        op();
+        for (long long batch = 1;; batch *= 2) {
+            Timer timer;
+            timer.Start();
+            for (long long i = 0; i < batch; i++) op();
+            timer.Stop();
+            if (timer.GetTime() >= opt.min_time_ms or batch >= (1LL << 40)) {
+                Report(kernel, input, batch, timer.GetTime(), items_per_op);
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Time op alone, calling the untimed setup before every op, until op has taken min_time_ms in total
+     * (or the whole loop ten times as long)
+     */
+    template <typename Setup, typename Op>
+    void RunWithSetup(const std::string &kernel, const std::string &input, double items_per_op, Setup &&setup,
+                      Op &&op) {
+        if (!Selected(kernel)) return;
+        Timer op_timer, wall_timer;
+        wall_timer.Start();
+        long long num_ops = 0;
+        while (num_ops == 0 or (op_timer.GetTime() < opt.min_time_ms and wall_timer.Peek() < 10 * opt.min_time_ms)) {
+            setup();
+            op_timer.Start();
+            op();
+            op_timer.Stop();
+            num_ops++;
+        }
+        Report(kernel, input, num_ops, op_timer.GetTime(), items_per_op);
+    }
+};
+
+/**
+ * @brief Sorted list of about size distinct values from [0, universe)
+ */
+std::vector<int> RandomSortedList(int size, int universe, std::mt19937 &rng) {
+    std::vector<int> list;
+    std::bernoulli_distribution keep(std::min(1.0, 1.0 * size / universe));
+    for (int x = 0; x < universe; x++) {
+        if (keep(rng)) list.push_back(x);
+    }
+    return list;
+}
+
+void BenchmarkIntersections(MicroBenchmark &bench, const BenchmarkOption &opt, std::mt19937 &rng) {
+    for (int size : {64, 1024, 16384}) {
+        size *= opt.scale;
+        for (int ratio : {1, 16}) {
+            int universe = 4 * size * ratio;
+            auto A = RandomSortedList(size, universe, rng);
+            auto B = RandomSortedList(size * ratio, universe, rng);
+            std::string input = "|A|=" + std::to_string(A.size()) + " |B|=" + std::to_string(B.size());
+            std::vector<int> out;
+            out.reserve(A.size());
+            bench.Run("VectorIntersection", input, A.size() + B.size(), [&]() {
+                out.clear();
+                VectorIntersection(A, B, out);
+                DoNotOptimize(out.size());
+            });
+            bench.Run("SortedIntersectionCount", input, A.size() + B.size(), [&]() {
+                DoNotOptimize(SortedIntersectionCount(A.data(), A.size(), B.data(), B.size()));
+            });
+        }
+        for (int k : {2, 4, 8}) {
+            std::vector<std::vector<int>> lists;
+            long long total = 0;
+            for (int i = 0; i < k; i++) {
+                lists.push_back(RandomSortedList(size, 2 * size, rng));
+                total += lists.back().size();
+            }
+            std::vector<int> out(size);
+            std::vector<std::pair<std::vector<int>::iterator, std::vector<int>::iterator>> iterators(k);
+            std::string input = "k=" + std::to_string(k) + " |L|=" + std::to_string(size);
+            bench.Run("MultiWayIntersection", input, total, [&]() {
+                for (int i = 0; i < k; i++) iterators[i] = {lists[i].begin(), lists[i].end()};
+                int out_size = 0;
+                MultiWayIntersection(iterators, out.data(), out_size);
+                DoNotOptimize(out_size);
+            });
+        }
+    }
+}
+
+void BenchmarkBipartiteMatching(MicroBenchmark &bench, const BenchmarkOption &, std::mt19937 &rng) {
+    for (int left : {8, 16, 32}) {
+        for (int degree : {2, 8}) {
+            int right = 4 * left;
+            if (degree > right) continue;
+            BipartiteMaximumMatching solver;
+            solver.Initialize(left, right, left);
+            solver.Reset();
+            // a planted perfect matching of the left side, plus random edges
+            std::vector<int> perm(right);
+            std::iota(perm.begin(), perm.end(), 0);
+            std::shuffle(perm.begin(), perm.end(), rng);
+            std::uniform_int_distribution<int> pick(0, right - 1);
+            long long num_edges = 0;
+            for (int u = 0; u < left; u++) {
+                std::vector<int> nbrs = {perm[u]};
+                while ((int)nbrs.size() < degree) {
+                    int v = pick(rng);
+                    if (std::find(nbrs.begin(), nbrs.end(), v) == nbrs.end()) nbrs.push_back(v);
+                }
+                std::shuffle(nbrs.begin(), nbrs.end(), rng);
+                for (int v : nbrs) solver.AddEdge(u, v);
+                num_edges += nbrs.size();
+            }
+            std::string input = "L=" + std::to_string(left) + " R=" + std::to_string(right) + " deg=" +
+                                std::to_string(degree);
+            bench.Run("BipartiteMatching::Solve", input, num_edges, [&]() {
+                solver.Reset(false);
+                DoNotOptimize(solver.Solve());
+            });
+            bench.Run("FindUnmatchableEdges", input, num_edges, [&]() {
+                solver.Reset(false);
+                DoNotOptimize(solver.FindUnmatchableEdges(left));
+            });
+        }
+    }
+}
+
+/**
+ * @brief Simple undirected graph with Zipf(skew) endpoint popularity and Zipf(skew) labels
+ */
+Graph RandomGraph(int num_vertices, long long num_edges, int num_labels, double skew, std::mt19937 &rng) {
+    ZipfDistribution endpoint(num_vertices, skew), label(num_labels, skew);
+    std::vector<int> id(num_vertices);
+    std::iota(id.begin(), id.end(), 0);
+    std::shuffle(id.begin(), id.end(), rng);
+    std::vector<std::pair<int, int>> edges;
+    for (long long i = 0; i < num_edges; i++) {
+        int u = id[endpoint(rng)], v = id[endpoint(rng)];
+        if (u == v) continue;
+        edges.emplace_back(std::min(u, v), std::max(u, v));
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    std::vector<int> labels(num_vertices), edge_labels;
+    for (int &l : labels) l = label(rng);
+    Graph G;
+    G.LoadGraph(labels, edges, edge_labels, false);
+    return G;
+}
+
+void BenchmarkGraphKernels(MicroBenchmark &bench, const BenchmarkOption &opt, std::mt19937 &rng) {
+    if (!bench.Selected("EnumerateLocalTriangles") and !bench.Selected("CountMaximumMatchings")) return;
+    int n = 20000 * opt.scale;
+    std::unique_ptr<SubgraphMatching::DataGraph> graph;
+    if (!opt.snapshot.empty() and std::filesystem::exists(opt.snapshot)) {
+        Timer timer;
+        timer.Start();
+        graph = std::make_unique<SubgraphMatching::DataGraph>();
+        graph->LoadSnapshot(opt.snapshot);
+        timer.Stop();
+        fprintf(stderr, "Loaded snapshot %s in %.02lf ms\n", opt.snapshot.c_str(), timer.GetTime());
+        if (graph->GetNumVertices() != n) {
+            fprintf(stderr, "Snapshot %s has %d vertices, expected %d: regenerated\n", opt.snapshot.c_str(),
+                    graph->GetNumVertices(), n);
+            graph.reset();
+        }
+    }
+    if (graph == nullptr) {
+        // with a snapshot, the graph has its own generator, so that the later inputs do not depend on whether
+        // the snapshot already existed
+        std::mt19937 graph_rng(opt.seed);
+        graph = std::make_unique<SubgraphMatching::DataGraph>(
+                RandomGraph(n, 8LL * n, 4, opt.skew, opt.snapshot.empty() ? rng : graph_rng));
+        graph->Preprocess();
+        if (!opt.snapshot.empty()) graph->WriteSnapshot(opt.snapshot);
+    }
+    auto &D = *graph;
+    std::string input = "V=" + std::to_string(D.GetNumVertices()) + " E=" + std::to_string(D.GetNumEdges() / 2) +
+                        " skew=" + std::to_string(opt.skew).substr(0, 4);
+    bench.Run("EnumerateLocalTriangles", input, D.GetNumEdges() / 2, [&]() {
+        D.EnumerateLocalTriangles();
+    });
+
+    // a star whose leaves share one label: after the center, the leaves are isolated and their embeddings are
+    // counted by CountMaximumMatchings, which is private to the backtracking; Match is timed as a whole, so only
+    // its ns/op is reported
+    if (!bench.Selected("CountMaximumMatchings")) return;
+    for (int num_leaves : {3, 5}) {
+        std::vector<int> labels(num_leaves + 1, 1), edge_labels;
+        labels[0] = 0;
+        std::vector<std::pair<int, int>> edges;
+        for (int i = 1; i <= num_leaves; i++) edges.emplace_back(0, i);
+        Graph star;
+        star.LoadGraph(labels, edges, edge_labels, false);
+        SubgraphMatching::PatternGraph P(star);
+        P.ProcessPattern(D);
+        P.EnumerateLocalTriangles();
+        P.EnumerateLocalFourCycles();
+        SubgraphMatching::SubgraphMatchingOption match_opt;
+        SubgraphMatching::BacktrackEngine engine(&D, match_opt);
+        bench.Run("CountMaximumMatchings", input + " star-" + std::to_string(num_leaves), 0, [&]() {
+            engine.Match(&P);
+        });
+    }
+}
+
+/**
+ * @brief Hypergraph with Zipf(skew) vertex popularity, arities 2 + Zipf(skew) over [0, 6) and Zipf(skew) labels
+ */
+SubHyperGraphMatching::HyperGraphDataset RandomHyperGraph(int num_vertices, int num_hyperedges, int num_labels,
+                                                          double skew, std::mt19937 &rng) {
+    ZipfDistribution member(num_vertices, skew), arity(6, skew), label(num_labels, skew);
+    SubHyperGraphMatching::HyperGraphDataset D;
+    D.name = "synthetic";
+    D.vertex_label.resize(num_vertices);
+    for (int &l : D.vertex_label) l = label(rng);
+    std::vector<int> id(num_vertices);
+    std::iota(id.begin(), id.end(), 0);
+    std::shuffle(id.begin(), id.end(), rng);
+    for (int i = 0; i < num_hyperedges; i++) {
+        int a = 2 + arity(rng);
+        std::vector<int> e;
+        while ((int)e.size() < a) {
+            int v = id[member(rng)];
+            if (std::find(e.begin(), e.end(), v) == e.end()) e.push_back(v);
+        }
+        std::sort(e.begin(), e.end());
+        D.hyperedges.push_back(e);
+    }
+    std::sort(D.hyperedges.begin(), D.hyperedges.end());
+    D.hyperedges.erase(std::unique(D.hyperedges.begin(), D.hyperedges.end()), D.hyperedges.end());
+    return D;
+}
+
+/**
+ * @brief Pattern made of a chain of num_hyperedges data hyperedges, each sharing a vertex with the previous one
+ * (so that it has embeddings), relabeled to 0..k-1
+ */
+void ChainPattern(const SubHyperGraphMatching::HyperGraphDataset &D, int num_hyperedges, std::mt19937 &rng,
+                  SubHyperGraphMatching::PatternHyperGraph &P) {
+    std::vector<std::vector<int>> incidence(D.vertex_label.size());
+    for (int i = 0; i < (int)D.hyperedges.size(); i++) {
+        for (int v : D.hyperedges[i]) incidence[v].push_back(i);
+    }
+    std::uniform_int_distribution<int> pick_edge(0, D.hyperedges.size() - 1);
+    std::vector<int> chain = {pick_edge(rng)};
+    for (int attempt = 0; (int)chain.size() < num_hyperedges and attempt < 1000; attempt++) {
+        auto &last = D.hyperedges[chain.back()];
+        int v = last[rng() % last.size()];
+        int f = incidence[v][rng() % incidence[v].size()];
+        if (std::find(chain.begin(), chain.end(), f) == chain.end()) chain.push_back(f);
+    }
+    std::map<int, int> local_id;
+    std::vector<int> labels;
+    std::vector<std::vector<int>> edges;
+    for (int f : chain) {
+        edges.emplace_back();
+        for (int v : D.hyperedges[f]) {
+            if (!local_id.count(v)) {
+                local_id[v] = labels.size();
+                labels.push_back(D.vertex_label[v]);
+            }
+            edges.back().push_back(local_id[v]);
+        }
+    }
+    P.LoadPatternHyperGraph(labels, edges);
+}
+
+void BenchmarkHyperCandidateSpace(MicroBenchmark &bench, const BenchmarkOption &opt, std::mt19937 &rng) {
+    if (!bench.Selected("Safety") and !bench.Selected("Remove")) return;
+    int n = 5000 * opt.scale;
+    auto dataset = RandomHyperGraph(n, 2 * n, 3, opt.skew, rng);
+    SubHyperGraphMatching::PatternHyperGraph P;
+    ChainPattern(dataset, 3, rng, P);
+    SubHyperGraphMatching::DataHyperGraph H;
+    H.BuildFromDataset(dataset, P);
+    SubHyperGraphMatching::SubHyperGraphMatchingOption hcs_opt;
+    SubHyperGraphMatching::HyperCandidateSpace pristine(&H, &P, hcs_opt);
+    std::string input = "V=" + std::to_string(H.GetNumVertices()) + " E=" + std::to_string(H.GetNumHyperedges()) +
+                        " A=" + std::to_string(H.GetTotalArity()) + " Vq=" + std::to_string(P.GetNumVertices()) +
+                        " Eq=" + std::to_string(P.GetNumHyperedges());
+
+    std::vector<std::pair<int, int>> vertex_pairs, hyperedge_pairs;
+    for (int u = 0; u < P.GetNumVertices(); u++) {
+        for (int v = 0; v < H.GetNumVertices(); v++) {
+            if (pristine.isVertexCandidate(u, v)) vertex_pairs.emplace_back(u, v);
+        }
+    }
+    for (int e = 0; e < P.GetNumHyperedges(); e++) {
+        for (int f = 0; f < H.GetNumHyperedges(); f++) {
+            if (pristine.isHyperedgeCandidate(e, f)) hyperedge_pairs.emplace_back(e, f);
+        }
+    }
+    bench.Run("HyperEdgeSafety", input, hyperedge_pairs.size(), [&]() {
+        int num_safe = 0;
+        for (auto &[e, f] : hyperedge_pairs) num_safe += pristine.HyperEdgeSafety(e, f);
+        DoNotOptimize(num_safe);
+    });
+    bench.Run("VertexSafety", input, vertex_pairs.size(), [&]() {
+        int num_safe = 0;
+        for (auto &[u, v] : vertex_pairs) num_safe += pristine.VertexSafety(u, v);
+        DoNotOptimize(num_safe);
+    });
+
+    // remove every candidate but the last one of each query vertex (hyperedge); removal empties no set
+    auto AllButLast = [](const std::vector<std::pair<int, int>> &pairs) {
+        std::vector<std::pair<int, int>> removable;
+        for (size_t i = 0; i + 1 < pairs.size(); i++) {
+            if (pairs[i].first == pairs[i + 1].first) removable.push_back(pairs[i]);
+        }
+        return removable;
+    };
+    auto removable_vertices = AllButLast(vertex_pairs), removable_hyperedges = AllButLast(hyperedge_pairs);
+    std::unique_ptr<SubHyperGraphMatching::HyperCandidateSpace> HCS;
+    bench.RunWithSetup("RemoveVertex", input, removable_vertices.size(),
+                       [&]() { HCS = std::make_unique<SubHyperGraphMatching::HyperCandidateSpace>(pristine); },
+                       [&]() { for (auto &[u, v] : removable_vertices) HCS->RemoveVertex(u, v); });
+    bench.RunWithSetup("RemoveHyperedge", input, removable_hyperedges.size(),
+                       [&]() { HCS = std::make_unique<SubHyperGraphMatching::HyperCandidateSpace>(pristine); },
+                       [&]() { for (auto &[e, f] : removable_hyperedges) HCS->RemoveHyperedge(e, f); });
+}
+
+/**
+ * Usage: [-t min_time_ms] [-s scale] [-k skew] [-r seed] [-f kernel_filter] [-o results.csv|results.json] [-T threads]
+ *        [-g graph_snapshot]
+ * Runs every kernel (or those whose name contains kernel_filter) and prints ns/op and items/s; -o also writes one
+ * row per kernel and input. Inputs are generated from the seed, so runs with the same flags are comparable.
+ * -g writes the preprocessed data graph of the graph kernels to graph_snapshot if it does not exist, and otherwise
+ * maps it instead of generating and preprocessing the graph again (DataGraph::LoadSnapshot). The snapshot is only
+ * checked against the scale: remove it after changing -k or -r.
+ */
+int32_t main(int argc, char *argv[]) {
+    BenchmarkOption opt;
+    std::string output;
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] == '-') {
+            switch (argv[i][1]) {
+                case 't':
+                    opt.min_time_ms = atof(argv[i + 1]);
+                    break;
+                case 's':
+                    opt.scale = atoi(argv[i + 1]);
+                    break;
+                case 'k':
+                    opt.skew = atof(argv[i + 1]);
+                    break;
+                case 'r':
+                    opt.seed = atoi(argv[i + 1]);
+                    break;
+                case 'f':
+                    opt.filter = argv[i + 1];
+                    break;
+                case 'o':
+                    output = argv[i + 1];
+                    break;
+                case 'T':
+                    num_worker_threads = std::max(1, atoi(argv[i + 1]));
+                    break;
+                case 'g':
+                    opt.snapshot = argv[i + 1];
+                    break;
+            }
+        }
+    }
+    std::unique_ptr<ResultTable> results;
+    if (!output.empty()) results = std::make_unique<ResultTable>(output);
+    // the kernels print their own statistics to stdout and log_to; the report goes to the original stdout
+    FILE *report = fdopen(dup(STDOUT_FILENO), "w");
+    if (freopen("/dev/null", "w", stdout) == nullptr) {
+        fprintf(stderr, "Cannot redirect stdout\n");
+        return 1;
+    }
+    log_to = stdout;
+    MicroBenchmark bench(opt, report, results.get());
+    std::mt19937 rng(opt.seed);
+    BenchmarkIntersections(bench, opt, rng);
+    BenchmarkBipartiteMatching(bench, opt, rng);
+    BenchmarkGraphKernels(bench, opt, rng);
+    BenchmarkHyperCandidateSpace(bench, opt, rng);
+}
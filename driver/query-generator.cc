@@ -0,0 +1,92 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include "Base/Base.h"
+#include "Base/Timer.h"
+#include "SubhypergraphMatching/DataHyperGraph.h"
+#include "SubhypergraphMatching/QueryGenerator.h"
+using namespace std;
+using namespace GraphLib;
+
+/**
+ * Usage: -d dataset [-p path] [-s sizes] [-c queries_per_size] [-a min_arity] [-A max_arity]
+ *        [-l min_distinct_labels] [-L max_distinct_labels] [-v max_vertices] [-r seed] [-o name_prefix]
+ * Samples queries of every size (number of hyperedges, e.g. -s 3,4,5) by random walks over the dataset and writes
+ * them to path/dataset/queries/<prefix>_<size>_<i>.txt, with the query names of each size listed in
+ * path/dataset/queries/<prefix>_<size>.list (for the -b mode of subhypergraph-matching). Every query has an
+ * embedding. The queries depend only on the dataset, the options and the seed.
+ */
+int32_t main(int argc, char *argv[]) {
+    std::string dataset = "amazon-reviews", path = "../dataset/hypergraphs/", sizes = "3,4,5,6,7,8", prefix = "query";
+    int num_queries = 200;
+    unsigned long long seed = 1;
+    SubHyperGraphMatching::QueryGeneratorOption opt;
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] == '-') {
+            switch (argv[i][1]) {
+                case 'd':
+                    dataset = argv[i + 1];
+                    break;
+                case 'p':
+                    path = argv[i + 1];
+                    break;
+                case 's':
+                    sizes = argv[i + 1];
+                    break;
+                case 'c':
+                    num_queries = atoi(argv[i + 1]);
+                    break;
+                case 'a':
+                    opt.min_arity = atoi(argv[i + 1]);
+                    break;
+                case 'A':
+                    opt.max_arity = atoi(argv[i + 1]);
+                    break;
+                case 'l':
+                    opt.min_distinct_labels = atoi(argv[i + 1]);
+                    break;
+                case 'L':
+                    opt.max_distinct_labels = atoi(argv[i + 1]);
+                    break;
+                case 'v':
+                    opt.max_vertices = atoi(argv[i + 1]);
+                    break;
+                case 'r':
+                    seed = strtoull(argv[i + 1], nullptr, 10);
+                    break;
+                case 'o':
+                    prefix = argv[i + 1];
+                    break;
+            }
+        }
+    }
+    SubHyperGraphMatching::HyperGraphDataset D;
+    D.Load(dataset, path);
+    SubHyperGraphMatching::QueryGenerator generator(D, opt);
+    std::string query_dir = path + "/" + dataset + "/queries/";
+    std::filesystem::create_directories(query_dir);
+
+    Timer timer;
+    timer.Start();
+    std::vector<int> labels;
+    std::vector<std::vector<int>> hyperedges;
+    for (auto &size_str : parse(sizes, ",")) {
+        int size = stoi(size_str);
+        std::string list_file = query_dir + prefix + "_" + std::to_string(size) + ".list";
+        std::ofstream list(list_file);
+        int num_written = 0;
+        for (int i = 0; i < num_queries; i++) {
+            // one stream per (size, index), so that a query does not depend on the others
+            SplitMix64 rng(SplitMix64::StreamSeed(seed, ((unsigned long long)size << 32) | i));
+            if (!generator.Sample(size, rng, labels, hyperedges)) continue;
+            std::string name = prefix + "_" + std::to_string(size) + "_" + std::to_string(i);
+            SubHyperGraphMatching::QueryGenerator::WriteQuery(query_dir + name + ".txt", labels, hyperedges);
+            list << name << '\n';
+            num_written++;
+        }
+        fprintf(stderr, "Size %d: %d / %d queries written, listed in %s\n", size, num_written, num_queries,
+                list_file.c_str());
+    }
+    timer.Stop();
+    fprintf(stderr, "QueryGenerationTime: %.02lf\n", timer.GetTime());
+}
@@ -0,0 +1,382 @@
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Base/Base.h"
+#include "Base/Profiler.h"
+#include "Base/Timer.h"
+#include "Base/WorkerPool.h"
+#include "SubhypergraphMatching/DataHyperGraph.h"
+#include "SubhypergraphMatching/PatternHyperGraph.h"
+#include "SubhypergraphMatching/MatchingService.h"
+using namespace std;
+using namespace GraphLib;
+using GraphLib::SubHyperGraphMatching::QueryAnswer;
+
+/**
+ * @brief One client: answers are written to out_fd as JSON lines, in order of completion
+ */
+class Connection {
+    int out_fd;
+    std::mutex mutex;
+    std::condition_variable idle;
+    int num_pending = 0;
+public:
+    explicit Connection(int out_fd_) : out_fd(out_fd_) {};
+
+    /**
+     * @return false if the client went away (its remaining answers are dropped)
+     */
+    bool Reply(const std::string &line) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string buffer = line + "\n";
+        size_t written = 0;
+        while (written < buffer.size()) {
+            ssize_t n = write(out_fd, buffer.data() + written, buffer.size() - written);
+            if (n <= 0) return false;
+            written += n;
+        }
+        return true;
+    }
+    void BeginQuery() {
+        std::lock_guard<std::mutex> lock(mutex);
+        num_pending++;
+    }
+    void EndQuery() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--num_pending == 0) idle.notify_all();
+    }
+    /**
+     * @brief Block until every query of this client has been answered
+     */
+    void WaitIdle() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return num_pending == 0; });
+    }
+};
+
+std::string JsonString(const std::string &s) {
+    std::string quoted = "\"";
+    for (char c : s) {
+        if (c == '"' or c == '\\') quoted.push_back('\\');
+        if (c == '\n') { quoted += "\\n"; continue; }
+        quoted.push_back(c);
+    }
+    return quoted + "\"";
+}
+
+std::string ErrorJson(const std::string &id, const std::string &message) {
+    return "{\"id\": " + JsonString(id) + ", \"status\": \"error\", \"message\": " + JsonString(message) + "}";
+}
+
+/**
+ * @brief One embedding of an enumerate request: the dataset vertex matched to each query vertex (numbered as in the
+ * dataset files) and the dataset hyperedge matched to each query hyperedge (0-based line of the dataset)
+ */
+std::string EmbeddingJson(const std::string &id, const EmbeddingView &embedding) {
+    std::string json = "{\"id\": " + JsonString(id) + ", \"vertices\": [";
+    for (size_t i = 0; i < embedding.vertices.size(); i++) {
+        json += (i ? ", " : "") + std::to_string(embedding.vertices[i] + 1);
+    }
+    json += "], \"hyperedges\": [";
+    for (size_t i = 0; i < embedding.hyperedges.size(); i++) {
+        json += (i ? ", " : "") + std::to_string(embedding.hyperedges[i]);
+    }
+    return json + "]}";
+}
+
+/**
+ * @brief Name of a query file of the dataset, queries/<name>.txt, or "" if name could leave that directory
+ * (absolute, or with a .. component)
+ */
+std::string QueryFilePath(const std::string &query_dir, const std::string &name) {
+    std::filesystem::path relative(name);
+    if (name.empty() or relative.is_absolute() or relative.has_root_path()) return "";
+    for (auto &component : relative) {
+        if (component == "..") return "";
+    }
+    return query_dir + name + ".txt";
+}
+
+std::string AnswerJson(const std::string &id, const QueryAnswer &answer, double queue_ms) {
+    char timing[256];
+    snprintf(timing, sizeof(timing),
+             "\"queue_ms\": %.4lf, \"extract_ms\": %.4lf, \"filter_ms\": %.4lf, \"refine_ms\": %.4lf, "
+             "\"enumerate_ms\": %.4lf, \"total_ms\": %.4lf", queue_ms, answer.extract_ms, answer.filter_ms,
+             answer.refine_ms, answer.enumerate_ms, answer.total_ms);
+    std::string json = "{\"id\": " + JsonString(id) + ", \"status\": " + JsonString(answer.status);
+    if (!answer.message.empty()) json += ", \"message\": " + JsonString(answer.message);
+    json += ", \"method\": " + JsonString(answer.method);
+    json += ", \"num_embeddings\": " + std::to_string(answer.num_embeddings);
+    json += ", \"Vq\": " + std::to_string(answer.num_query_vertices);
+    json += ", \"Eq\": " + std::to_string(answer.num_query_hyperedges);
+    json += ", \"Vg\": " + std::to_string(answer.num_data_vertices);
+    json += ", \"Eg\": " + std::to_string(answer.num_data_hyperedges);
+    json += std::string(", \"cached\": ") + (answer.cached ? "true" : "false");
+    return json + ", " + timing + "}";
+}
+
+struct ServerContext {
+    const SubHyperGraphMatching::MatchingService *service;
+    WorkerPool *pool;
+    // directory of the dataset's query files, the only place "file" requests are read from
+    std::string query_dir;
+};
+
+/**
+ * @brief Read the requests of one client until it closes or sends quit / shutdown, then wait for its answers
+ * @return true if the client asked the server to shut down
+ */
+bool ServeConnection(FILE *in, int out_fd, const ServerContext &ctx) {
+    Connection connection(out_fd);
+    bool shutdown_requested = false;
+    char *buffer = nullptr;
+    size_t capacity = 0;
+    while (getline(&buffer, &capacity, in) >= 0) {
+        std::istringstream request(buffer);
+        std::string command, id;
+        if (!(request >> command)) continue;
+        if (command == "quit") break;
+        if (command == "shutdown") {
+            shutdown_requested = true;
+            break;
+        }
+        if (command == "stats") {
+            auto &cache = ctx.service->GetCache();
+            connection.Reply("{\"cache_size\": " + std::to_string(cache.Size()) + ", \"cache_capacity\": " +
+                             std::to_string(cache.GetCapacity()) + ", \"cache_hits\": " +
+                             std::to_string(cache.GetNumHits()) + ", \"cache_misses\": " +
+                             std::to_string(cache.GetNumMisses()) + ", \"cache_evictions\": " +
+                             std::to_string(cache.GetNumEvictions()) + "}");
+            continue;
+        }
+        if (!(request >> id)) {
+            connection.Reply(ErrorJson("", "missing query id"));
+            continue;
+        }
+        std::vector<int> labels;
+        std::vector<std::vector<int>> hyperedges;
+        bool parsed = false;
+        long long max_num_matches = -1;
+        if (command == "query") {
+            parsed = SubHyperGraphMatching::PatternHyperGraph::ParsePatternHyperGraph(request, labels, hyperedges);
+        }
+        else if (command == "enumerate") {
+            parsed = (request >> max_num_matches) and
+                     SubHyperGraphMatching::PatternHyperGraph::ParsePatternHyperGraph(request, labels, hyperedges);
+        }
+        else if (command == "file") {
+            std::string query_name;
+            request >> query_name;
+            std::string query_file = QueryFilePath(ctx.query_dir, query_name);
+            if (query_file.empty()) {
+                connection.Reply(ErrorJson(id, "invalid query name " + query_name));
+                continue;
+            }
+            std::ifstream fin(query_file);
+            if (!fin.is_open()) {
+                connection.Reply(ErrorJson(id, "cannot open query " + query_name));
+                continue;
+            }
+            parsed = SubHyperGraphMatching::PatternHyperGraph::ParsePatternHyperGraph(fin, labels, hyperedges);
+        }
+        else {
+            connection.Reply(ErrorJson(id, "unknown command " + command));
+            continue;
+        }
+        if (!parsed) {
+            connection.Reply(ErrorJson(id, "malformed query"));
+            continue;
+        }
+        connection.BeginQuery();
+        Timer queue_timer;
+        queue_timer.Start();
+        bool enumerate = command == "enumerate";
+        ctx.pool->Submit([&connection, &ctx, id, labels = std::move(labels), hyperedges = std::move(hyperedges),
+                          queue_timer, enumerate, max_num_matches](int) {
+            double queue_ms = queue_timer.Peek();
+            QueryAnswer answer;
+            if (enumerate) {
+                // a client that went away stops the search
+                CallbackSink sink([&](const EmbeddingView &embedding) {
+                    return connection.Reply(EmbeddingJson(id, embedding));
+                });
+                answer = ctx.service->Enumerate(labels, hyperedges, sink, max_num_matches);
+            }
+            else answer = ctx.service->Answer(labels, hyperedges);
+            connection.Reply(AnswerJson(id, answer, queue_ms));
+            connection.EndQuery();
+        });
+    }
+    free(buffer);
+    connection.WaitIdle();
+    return shutdown_requested;
+}
+
+/**
+ * @brief Accept clients on a Unix domain socket, each served by its own thread, until one sends shutdown
+ */
+int ServeSocket(const std::string &socket_path, const ServerContext &ctx) {
+    sockaddr_un addr{};
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", socket_path.c_str());
+        return 1;
+    }
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path.c_str());
+    unlink(socket_path.c_str());
+    if (listen_fd < 0 or bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) < 0 or listen(listen_fd, 64) < 0) {
+        fprintf(stderr, "Cannot listen on %s: %s\n", socket_path.c_str(), strerror(errno));
+        if (listen_fd >= 0) close(listen_fd);
+        return 1;
+    }
+    fprintf(stderr, "Listening on %s\n", socket_path.c_str());
+    // client threads are detached, so that a finished one releases its resources at once; the last one to
+    // finish wakes up the shutdown below
+    std::mutex clients_mutex;
+    std::condition_variable clients_done;
+    std::set<int> client_fds;
+    int num_clients = 0;
+    std::atomic<bool> stopping = false;
+    while (!stopping) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        client_fds.insert(fd);
+        num_clients++;
+        std::thread([&, fd] {
+            FILE *in = fdopen(dup(fd), "r");
+            bool shutdown_requested = ServeConnection(in, fd, ctx);
+            fclose(in);
+            std::lock_guard<std::mutex> lock(clients_mutex);
+            client_fds.erase(fd);
+            close(fd);
+            if (shutdown_requested and !stopping.exchange(true)) {
+                // wake up accept and the other clients' reads
+                shutdown(listen_fd, SHUT_RDWR);
+                for (int client_fd : client_fds) shutdown(client_fd, SHUT_RD);
+            }
+            if (--num_clients == 0) clients_done.notify_all();
+        }).detach();
+    }
+    {
+        std::unique_lock<std::mutex> lock(clients_mutex);
+        clients_done.wait(lock, [&] { return num_clients == 0; });
+    }
+    close(listen_fd);
+    unlink(socket_path.c_str());
+    return 0;
+}
+
+/**
+ * Usage: -d dataset [-p dataset_path] [-u socket_path] [-w num_workers] [-T threads_per_query] [-n]
+ *        [-m max_hcs_mb] [-c cache_capacity] [-H] [-P] [-L max_embeddings] [-N max_search_nodes] [-t time_limit_ms]
+ * Loads the dataset once and answers queries until stdin ends (or, with -u, until a client sends shutdown),
+ * up to num_workers at a time. A request is one line:
+ *   query <id> <|V|> <|E|> <labels...> <hyperedges...>   the query inline, as in a query file
+ *   file <id> <query_name>                               the query file queries/<query_name>.txt of the dataset
+ *                                                        (no absolute path or .. component)
+ *   enumerate <id> <max_embeddings> <|V|> <|E|> ...      the query inline, answered with its embeddings first
+ *   stats                                                cache size, hits, misses and evictions (one JSON line)
+ *   quit                                                 close this client once its queries are answered
+ *   shutdown                                             stop the server (with -u)
+ * Every query is answered by one JSON line with its id, status, method, num_embeddings and the time spent
+ * waiting for a worker and in each phase; answers come in order of completion. -n only builds the HCS of the
+ * queries that are not counted directly (num_embeddings is then -1). -c keeps the answers of the last
+ * cache_capacity distinct queries up to isomorphism, so a repeated query (in any vertex numbering) is answered
+ * from the cache ("cached": true); -H also keeps their data hypergraph and refined HCS, over which enumerate then
+ * backtracks for an isomorphic query instead of building them again. -L, -N and -t bound the enumeration of each
+ * query (embeddings, search nodes, milliseconds): a query stopped by one is answered with the embeddings found so
+ * far and status match_limit, node_limit or time_limit, and is cached only for the first two.
+ * enumerate streams one JSON line per embedding, {"id", "vertices", "hyperedges"}: the dataset vertex matched to
+ * each query vertex (numbered as in the dataset files) and the dataset hyperedge matched to each query hyperedge
+ * (0-based line of the dataset, query hyperedges sorted as in PatternHyperGraph), then its answer line, whose
+ * num_embeddings counts the lines sent. At most max_embeddings are sent (status match_limit if more exist); a
+ * negative max_embeddings keeps -L. It bypasses direct counting, and the cache without -H. Logs go to stderr.
+ */
+int32_t main(int argc, char *argv[]) {
+    std::string dataset = "amazon-reviews", path = "../dataset/hypergraphs/", socket_path;
+    int num_workers = std::max(1u, std::thread::hardware_concurrency());
+    int threads_per_query = 1;
+    SubHyperGraphMatching::MatchingServiceOption opt;
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] == '-') {
+            switch (argv[i][1]) {
+                case 'd':
+                    dataset = argv[i + 1];
+                    break;
+                case 'p':
+                    path = argv[i + 1];
+                    break;
+                case 'u':
+                    socket_path = argv[i + 1];
+                    break;
+                case 'w':
+                    num_workers = std::max(1, atoi(argv[i + 1]));
+                    break;
+                case 'T':
+                    threads_per_query = std::max(1, atoi(argv[i + 1]));
+                    break;
+                case 'n':
+                    opt.enumerate = false;
+                    break;
+                case 'm':
+                    opt.matching.max_memory_bytes = (size_t)(atof(argv[i + 1]) * 1048576);
+                    break;
+                case 'c':
+                    opt.cache_capacity = std::max(0, atoi(argv[i + 1]));
+                    break;
+                case 'H':
+                    opt.cache_candidate_space = true;
+                    break;
+                case 'P':
+                    Profiler::Global().SetEnabled(true);
+                    break;
+                case 'L':
+                    opt.backtrack.max_num_matches = atoll(argv[i + 1]);
+                    break;
+                case 'N':
+                    opt.backtrack.max_search_nodes = atoll(argv[i + 1]);
+                    break;
+                case 't':
+                    opt.backtrack.time_limit_ms = atof(argv[i + 1]);
+                    break;
+            }
+        }
+    }
+    // the engines print their statistics to stdout; answers go to the original stdout only
+    int out_fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    signal(SIGPIPE, SIG_IGN);
+    num_worker_threads = threads_per_query;
+
+    SubHyperGraphMatching::HyperGraphDataset D;
+    Timer load_timer;
+    load_timer.Start();
+    D.Load(dataset, path);
+    D.BuildSignatureIndex();
+    load_timer.Stop();
+    fprintf(stderr, "LoadingTime: %.02lf (%zu label signatures)\n", load_timer.GetTime(),
+            D.hyperedges_by_signature.size());
+
+    SubHyperGraphMatching::MatchingService service(D, opt);
+    int rc = 0;
+    {
+        WorkerPool pool(num_workers);
+        ServerContext ctx{&service, &pool, path + "/" + dataset + "/queries/"};
+        if (socket_path.empty()) ServeConnection(stdin, out_fd, ctx);
+        else rc = ServeSocket(socket_path, ctx);
+    }
+    if (Profiler::Global().Enabled()) Profiler::Global().Report(log_to);
+    return rc;
+}
@@ -6,7 +6,12 @@
 #include "SubgraphMatching/DataGraph.h"
 #include "SubgraphMatching/PatternGraph.h"
 
+#include "Base/FactorizedResults.h"
 #include "Base/Metrics.h"
+#include "Base/Profiler.h"
+#include "Base/RefinementStatistics.h"
+#include "Base/ResourceUsage.h"
+#include "Base/ResultTable.h"
 #include "Base/Timer.h"
 #include "DataStructure/Graph.h"
 #include "SpecialSubgraphs/SmallCycle.h"
@@ -19,14 +24,374 @@
 
 #include "SubhypergraphMatching/HyperCandidateSpace.h"
 #include "SubhypergraphMatching/Preprocess.h"
+#include "SubhypergraphMatching/DirectCounting.h"
+#include "SubhypergraphMatching/BatchFiltering.h"
+#include "SubhypergraphMatching/HyperEmbeddingSink.h"
+#include "SubhypergraphMatching/CardinalityEstimation.h"
 using namespace std;
 using namespace GraphLib;
 
 const int MAX_NUM_VERTICES = 300;
-Timer timer;
+
+struct DriverOption {
+    // enumerate the queries that are not counted directly, through the bipartite representation
+    bool enumerate = false;
+    // print the memory used by each structure
+    bool report_memory = false;
+    // if set, receives the candidates left after each round of RefineHCS, one row per (query, round)
+    ResultTable *refinement_rounds = nullptr;
+    // if set, receives every embedding found by enumeration, one line per embedding
+    FILE *embeddings = nullptr;
+    // if set, receives the embeddings found by enumeration in factorized form, one section per query
+    FactorizedResultWriter *factorized = nullptr;
+    // options of the enumeration, with its limits (embeddings, search nodes, time)
+    SubgraphMatching::SubgraphMatchingOption backtrack;
+    // if set, every query is also estimated by sampling over its HCS
+    const SubHyperGraphMatching::EstimationOption *estimation = nullptr;
+    // if nonzero, the bipartite data graph computes its local motifs on demand, cached in this many bytes
+    size_t motif_cache_bytes = 0;
+    // enumerate the queries once more through GenerateEmbeddings, checking each embedding and their number
+    bool check_generator = false;
+};
+
+/**
+ * @brief Whether embedding (dataset ids, as given by HyperEmbeddingSink) is an embedding of PG into dataset:
+ * distinct vertices with the labels of the query vertices, and each query hyperedge mapped onto its hyperedge
+ */
+bool IsEmbedding(const SubHyperGraphMatching::HyperGraphDataset &dataset,
+                 SubHyperGraphMatching::PatternHyperGraph &PG, const EmbeddingView &embedding) {
+    if ((int)embedding.vertices.size() != PG.GetNumVertices() or
+        (int)embedding.hyperedges.size() != PG.GetNumHyperedges()) return false;
+    std::vector<int> image(embedding.vertices.begin(), embedding.vertices.end());
+    std::sort(image.begin(), image.end());
+    if (std::adjacent_find(image.begin(), image.end()) != image.end()) return false;
+    for (int u = 0; u < PG.GetNumVertices(); u++) {
+        int v = embedding.vertices[u];
+        if (v < 0 or v >= (int)dataset.vertex_label.size()) return false;
+        if (PG.GetMappedVertexLabel(dataset.vertex_label[v]) != PG.GetVertexLabel(u)) return false;
+    }
+    for (int e = 0; e < PG.GetNumHyperedges(); e++) {
+        int f = embedding.hyperedges[e];
+        if (f < 0 or f >= (int)dataset.hyperedges.size()) return false;
+        image.clear();
+        for (int u : PG.GetHyperedge(e)) image.push_back(embedding.vertices[u]);
+        std::sort(image.begin(), image.end());
+        if (image != dataset.hyperedges[f]) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Match one query against the (already loaded) dataset; fills one row of results if given
+ * @param vertex_candidates if given, the candidate dataset vertices of each query vertex (from BatchFilter)
+ * @return 5 if the query is too large, 0 otherwise
+ */
+int RunQuery(const SubHyperGraphMatching::HyperGraphDataset &dataset,
+             GraphLib::SubHyperGraphMatching::PatternHyperGraph &PG, const std::string &query_name, SubHyperGraphMatching::SubHyperGraphMatchingOption &opt_,
+             const DriverOption &driver_opt, ResultTable *results,
+             const std::vector<std::vector<int>> *vertex_candidates = nullptr) {
+    PROFILE_SCOPE("RunQuery");
+    ResetPeakRSS();
+    if (results != nullptr) {
+        results->Set("dataset", dataset.name);
+        results->Set("query", query_name);
+    }
+    PG.PrintStatistics("PatternGraph");
+    if (PG.GetNumVertices() >= MAX_NUM_VERTICES) {
+        if (results != nullptr) {
+            results->Set("status", "too_large");
+            results->EndRow();
+        }
+        return 5;
+    }
+    Timer extract_timer;
+    extract_timer.Start();
+    GraphLib::SubHyperGraphMatching::DataHyperGraph HG;
+    HG.BuildFromDataset(dataset, PG, vertex_candidates);
+    extract_timer.Stop();
+    HG.PrintStatistics("Extracted DataGraph");
+    MemoryReport memory;
+    HG.ReportMemory(memory);
+
+    std::string method = "none", status = "ok", generator_check = "none";
+    long long num_embeddings = -1, generated_embeddings = -1;
+    double filter_time = 0.0, refine_time = 0.0, enumerate_time = 0.0;
+    long long cs_v_init = -1, cs_e_init = -1, cs_v_after = -1, cs_e_after = -1;
+    size_t hcs_estimate = 0;
+    RefinementStatistics refine_stats(SubHyperGraphMatching::hcs_refinement_rule_names);
+    bool counted = false, over_memory_limit = false, estimated = false;
+    SubHyperGraphMatching::CardinalityEstimate estimate;
+    if (opt_.use_direct_counting and driver_opt.embeddings == nullptr and driver_opt.factorized == nullptr and
+        !driver_opt.check_generator) {
+        PROFILE_SCOPE("DirectCounting");
+        unsigned long long count = 0;
+        Timer timer;
+        timer.Start();
+        GraphLib::SubHyperGraphMatching::DirectCounter counter(&HG, &PG);
+        counted = counter.Count(count);
+        timer.Stop();
+        if (counted) {
+            fprintf(stderr, "DirectCountingTime: %.02lf\n", timer.GetTime());
+            if (results == nullptr) cout << count << endl;
+            method = "direct";
+            num_embeddings = count;
+            enumerate_time = timer.GetTime();
+        }
+    }
+    // the estimator samples over the HCS, so it is built for the directly counted queries too
+    bool need_hcs = !counted or driver_opt.estimation != nullptr;
+    if (need_hcs) {
+        hcs_estimate = SubHyperGraphMatching::HyperCandidateSpace::EstimateMemory(&HG, &PG);
+        over_memory_limit = opt_.max_memory_bytes > 0 and hcs_estimate > opt_.max_memory_bytes;
+        if (over_memory_limit) {
+            fprintf(stderr, "HCS would need %.2lf MB (limit %.2lf MB), skipped\n", hcs_estimate / 1048576.0,
+                    opt_.max_memory_bytes / 1048576.0);
+        }
+    }
+    if (need_hcs and !over_memory_limit) {
+        Timer timer;
+        timer.Start();
+        std::vector<std::vector<int>> initial_candidates;
+        if (vertex_candidates != nullptr) initial_candidates = HG.ToLocalVertices(*vertex_candidates);
+        GraphLib::SubHyperGraphMatching::HyperCandidateSpace HCS(&HG, &PG, opt_,
+                                                                 vertex_candidates != nullptr ? &initial_candidates : nullptr);
+        timer.Stop();
+        fprintf(stderr, "FilteringTime: %.02lf\n", timer.GetTime());
+        if (!counted) method = "hcs";
+        filter_time = HCS.initial_time;
+        refine_time = HCS.refine_time;
+        cs_v_init = HCS.num_initial_candidate_vertices;
+        cs_e_init = HCS.num_initial_candidate_hyperedges;
+        cs_v_after = HCS.GetNumCandidateVertices();
+        cs_e_after = HCS.GetNumCandidateHyperedges();
+        refine_stats = HCS.refine_stats;
+        if (driver_opt.refinement_rounds != nullptr) {
+            refine_stats.WriteRounds(*driver_opt.refinement_rounds, {{"dataset", dataset.name}, {"query", query_name}});
+        }
+        HCS.ReportMemory(memory);
+        if (driver_opt.estimation != nullptr) {
+            SubHyperGraphMatching::CardinalityEstimator estimator(&HG, &PG, &HCS);
+            estimate = estimator.Estimate(*driver_opt.estimation);
+            estimated = true;
+            fprintf(stderr, "Estimate: %.2lf [%.2lf, %.2lf] from %lld samples in %.02lf ms\n", estimate.estimate,
+                    estimate.ci_low, estimate.ci_high, estimate.num_samples, estimate.time_ms);
+        }
+    }
+    if (!counted and driver_opt.enumerate) {
+        // every embedding of the bipartite incidence graphs is one hypergraph embedding, since data hyperedges
+        // only match pattern hyperedges of the same label signature (hence the same arity)
+        PROFILE_SCOPE("Enumerate");
+        Timer timer;
+        timer.Start();
+        SubgraphMatching::DataGraph D(HG.BipartiteRepresentation());
+        D.Preprocess();
+        if (driver_opt.motif_cache_bytes > 0) D.EnableLazyLocalMotifs(driver_opt.motif_cache_bytes);
+        else {
+            D.EnumerateLocalTriangles();
+            D.EnumerateLocalFourCycles();
+        }
+        SubgraphMatching::PatternGraph P(PG.BipartiteRepresentation());
+        GraphLib::SubgraphMatching::BacktrackEngine backtrack(&D, driver_opt.backtrack);
+        P.ProcessPattern(D);
+        P.EnumerateLocalTriangles();
+        P.EnumerateLocalFourCycles();
+        if (driver_opt.embeddings != nullptr) {
+            BatchSink writer(1024, [&](const EmbeddingBatch &batch) {
+                for (size_t i = 0; i < batch.Size(); i++) {
+                    fprintf(driver_opt.embeddings, "%s", query_name.c_str());
+                    for (int v : batch[i].vertices) fprintf(driver_opt.embeddings, " %d", v + 1);
+                    fprintf(driver_opt.embeddings, "\n");
+                }
+                // no use searching further once the file cannot take more
+                return !ferror(driver_opt.embeddings);
+            });
+            SubHyperGraphMatching::HyperEmbeddingSink hyper_writer(writer, HG, PG.GetNumVertices(),
+                                                                   PG.GetNumHyperedges());
+            backtrack.Match(&P, &hyper_writer);
+            writer.Finish();
+        }
+        else if (driver_opt.factorized != nullptr) {
+            driver_opt.factorized->BeginQuery(query_name, PG.GetNumVertices(), PG.GetNumHyperedges());
+            SubHyperGraphMatching::HyperEmbeddingSink hyper_writer(*driver_opt.factorized, HG, PG.GetNumVertices(),
+                                                                   PG.GetNumHyperedges());
+            backtrack.Match(&P, &hyper_writer);
+            driver_opt.factorized->Finish();
+        }
+        else backtrack.Match(&P);
+        timer.Stop();
+        D.ReportMemory(memory, "BipartiteDataGraph");
+        backtrack.ReportMemory(memory);
+        if (driver_opt.report_memory) D.PrintLocalMotifStatistics();
+        if (results == nullptr) cout << backtrack.num_embeddings << endl;
+        method = "backtrack";
+        num_embeddings = backtrack.num_embeddings;
+        enumerate_time = timer.GetTime();
+        status = SubgraphMatching::search_status_names[backtrack.GetStatus()];
+        if (driver_opt.check_generator) {
+            // the same search on the thread of GenerateEmbeddings, with its own engine
+            long long num_generated = 0, num_invalid = 0;
+            auto search = [&](EmbeddingSink &sink, const std::atomic<bool> &cancel) {
+                SubgraphMatching::SubgraphMatchingOption generator_opt = driver_opt.backtrack;
+                generator_opt.cancel = &cancel;
+                auto engine = std::make_unique<SubgraphMatching::BacktrackEngine>(&D, generator_opt);
+                SubHyperGraphMatching::HyperEmbeddingSink hyper_sink(sink, HG, PG.GetNumVertices(),
+                                                                     PG.GetNumHyperedges());
+                engine->Match(&P, &hyper_sink);
+            };
+            for (const EmbeddingView &embedding : GenerateEmbeddings(search)) {
+                num_generated++;
+                num_invalid += !IsEmbedding(dataset, PG, embedding);
+            }
+            // a time limit may cut the two searches at different points
+            bool consistent = num_invalid == 0 and
+                              (num_generated == num_embeddings or status == "time_limit");
+            fprintf(stderr, "GeneratorCheck: %lld embeddings (%lld invalid), %lld counted: %s\n", num_generated,
+                    num_invalid, num_embeddings, consistent ? "ok" : "MISMATCH");
+            generator_check = consistent ? "ok" : "mismatch";
+            generated_embeddings = num_generated;
+        }
+    }
+    if (over_memory_limit) status = "memory_limit";
+
+    if (driver_opt.report_memory) memory.Print(log_to, query_name);
+
+    if (results != nullptr) {
+        results->Set("status", status);
+        results->Set("method", method);
+        results->Set("Vq", PG.GetNumVertices());
+        results->Set("Eq", PG.GetNumHyperedges());
+        results->Set("Aq", PG.GetTotalArity());
+        results->Set("Vg", HG.GetNumVertices());
+        results->Set("Eg", HG.GetNumHyperedges());
+        results->Set("Ag", HG.GetTotalArity());
+        results->Set("extract_ms", extract_timer.GetTime());
+        results->Set("filter_ms", filter_time);
+        results->Set("refine_ms", refine_time);
+        results->Set("enumerate_ms", enumerate_time);
+        results->Set("cs_v_init", cs_v_init);
+        results->Set("cs_e_init", cs_e_init);
+        results->Set("cs_v_after", cs_v_after);
+        results->Set("cs_e_after", cs_e_after);
+        refine_stats.WriteColumns(*results, "refine_");
+        // under -M the phases below reset the high-water mark: take the peak of the whole RunQuery phase
+        results->Set("peak_rss_kb", Profiler::Global().GetPhasePeakRSSKB());
+        results->Set("data_bytes", (long long)memory.Total("DataHyperGraph"));
+        results->Set("hcs_estimate_bytes", (long long)hcs_estimate);
+        results->Set("hcs_bytes", (long long)memory.Total("HCS"));
+        results->Set("num_embeddings", num_embeddings);
+        if (driver_opt.check_generator) {
+            results->Set("generated_embeddings", generated_embeddings);
+            results->Set("generator_check", generator_check);
+        }
+        if (driver_opt.estimation != nullptr) {
+            // q-error only against a complete exact count
+            bool exact = num_embeddings >= 0 and status == "ok";
+            results->Set("estimate", estimated ? estimate.estimate : -1.0);
+            results->Set("estimate_ci_low", estimated ? estimate.ci_low : -1.0);
+            results->Set("estimate_ci_high", estimated ? estimate.ci_high : -1.0);
+            results->Set("estimate_samples", estimate.num_samples);
+            results->Set("estimate_ms", estimate.time_ms);
+            results->Set("q_error", estimated and exact ? QError(num_embeddings, estimate.estimate) : -1.0);
+            results->Set("log_q_error", estimated and exact ? logQError(num_embeddings, estimate.estimate) : 0.0);
+        }
+        results->EndRow();
+    }
+    return 0;
+}
+
+/**
+ * @brief Expand every result of a file written by -X and check each embedding against the dataset, which must be
+ * loaded as when the file was written (hyperedge ids are indices of the loaded hyperedges); fills one row of
+ * results per section if given
+ * @return 0 if every section matches its query, expands to valid embeddings and to the number it records
+ */
+int CheckFactorizedResults(const SubHyperGraphMatching::HyperGraphDataset &dataset,
+                           std::vector<SubHyperGraphMatching::PatternHyperGraph> &patterns,
+                           const std::vector<std::string> &query_names, const std::string &filename,
+                           ResultTable *results) {
+    FactorizedResultReader reader(filename);
+    std::string name;
+    FactorizedEmbedding result;
+    int rc = 0;
+    while (reader.NextQuery(name)) {
+        size_t idx = std::find(query_names.begin(), query_names.end(), name) - query_names.begin();
+        bool known = idx < query_names.size() and reader.GetNumVertices() == patterns[idx].GetNumVertices() and
+                     reader.GetNumHyperedges() == patterns[idx].GetNumHyperedges();
+        long long num_expanded = 0, num_invalid = 0;
+        while (reader.Next(result)) {
+            ExpandFactorized(result, [&](const EmbeddingView &embedding) {
+                num_expanded++;
+                num_invalid += !known or !IsEmbedding(dataset, patterns[idx], embedding);
+                return true;
+            });
+        }
+        bool consistent = known and num_invalid == 0 and num_expanded == (long long)reader.GetNumEmbeddings();
+        if (!consistent) rc = 1;
+        fprintf(stderr, "FactorizedCheck %s: %llu results, %lld embeddings (%lld invalid), %llu recorded: %s\n",
+                name.c_str(), reader.GetNumResults(), num_expanded, num_invalid, reader.GetNumEmbeddings(),
+                consistent ? "ok" : (known ? "MISMATCH" : "UNKNOWN QUERY"));
+        if (results != nullptr) {
+            results->Set("dataset", dataset.name);
+            results->Set("query", name);
+            results->Set("num_results", (long long)reader.GetNumResults());
+            results->Set("num_embeddings", num_expanded);
+            results->Set("recorded_embeddings", (long long)reader.GetNumEmbeddings());
+            results->Set("invalid_embeddings", num_invalid);
+            results->Set("factorized_check", consistent ? "ok" : "mismatch");
+            results->EndRow();
+        }
+    }
+    return rc;
+}
+
+/**
+ * Usage: -d dataset -q query_name [-p dataset_path] [-e] [-E embeddings.txt] [-X results.bin] [-F] [-P] [-C] [-M]
+ *        [-m max_hcs_mb] [-r rounds.csv] [-L max_embeddings] [-N max_search_nodes] [-t time_limit_ms]
+ *        [-A estimate_ms] [-l motif_cache_mb] [-G]
+ *        -d dataset (-q query_name | -b query_list) -R results.bin [-o results.csv|results.json] [-p dataset_path]
+ *        [-F]
+ *        -d dataset -b query_list [-o results.csv|results.json] [-p dataset_path] [-e] [-E embeddings.txt]
+ *        [-X results.bin] [-F] [-S] [-P] [-C] [-M] [-m max_hcs_mb] [-r rounds.csv] [-L max_embeddings]
+ *        [-N max_search_nodes] [-t time_limit_ms] [-A estimate_ms] [-l motif_cache_mb] [-G]
+ * -b runs every query named in query_list (one per line) against a single copy of the dataset and writes one
+ * row per query; -e enumerates the queries that are not counted directly (through the bipartite representation).
+ * -E enumerates every query (no direct counting) and writes each embedding as a line "query v_1 .. v_k": the
+ * dataset vertex (numbered as in the dataset files) matched to each query vertex, which determine the matched
+ * hyperedges. Exits with 1 if the file cannot be written in full.
+ * -X enumerates every query likewise, but writes its embeddings factorized (FactorizedResults.h): the query
+ * vertices left independent by a partial embedding are written as candidate lists instead of expanded, with
+ * dataset ids (0-based vertices, indices of the loaded hyperedges). -E takes precedence.
+ * -R reads such a file back instead of matching: every result is expanded (ExpandFactorized) and each embedding
+ * checked against the dataset and its query, which must be named as when the file was written (same query list
+ * and -F, so that the hyperedges are loaded alike); one row per section gives the number of embeddings expanded,
+ * comparable to the num_embeddings of -e, and factorized_check (ok or mismatch). Exits with 1 on a mismatch.
+ * -L, -N and -t stop the enumeration of a query after that many embeddings, search nodes or milliseconds; the
+ * query then reports the embeddings found so far, with status match_limit, node_limit or time_limit.
+ * -G enumerates every query (no direct counting) and checks the enumeration: the search runs again through
+ * GenerateEmbeddings, each embedding it yields is checked against the dataset and their number against the count;
+ * with -b, each row gets generated_embeddings and generator_check (ok, mismatch, or none if nothing was enumerated).
+ * -A also estimates the number of embeddings of every query by sampling over its HCS for estimate_ms
+ * (CardinalityEstimator); with -b, each row gets the estimate, its 95% confidence interval and, where the exact
+ * count is known (directly counted, or enumerated with -e), the q-error of the estimate (QError, logQError).
+ * -l computes the local triangles and four-cycles of the bipartite data graph on demand, in LRU caches of
+ * motif_cache_mb, instead of enumerating them for every data edge before the search (Graph::EnableLazyLocalMotifs).
+ * -P prints the phase profile at exit, -C adds hardware counters to it, -M prints the memory of each structure
+ * (and, for enumerated queries, the local motifs of the bipartite data graph) and adds the peak RSS of each phase
+ * to the profile. -m skips the HCS of queries whose estimated size exceeds it.
+ * -r writes the candidates left after each round of RefineHCS (with timestamps), one row per query and round.
+ * The queries are read first, and the dataset is loaded in one scan keeping only the hyperedges whose label
+ * signature appears in some query (the others match no query); -F loads the whole dataset instead.
+ * -S filters the batch first by its stars (BatchFilter), each distinct star once, and starts each query from the
+ * candidates left; refining a star costs about as much as a small query, so it pays when the queries share stars.
+ */
 int32_t main(int argc, char *argv[]) {
-    std::string dataset = "amazon-reviews";
-    std::string query_name = "query_3_0", query;
+    std::string dataset = "amazon-reviews", path = "../dataset/hypergraphs/";
+    std::string query_name = "query_3_0", query_list, output = "results.csv", rounds_output, embeddings_output;
+    std::string factorized_output, factorized_input;
+    DriverOption driver_opt;
+    SubHyperGraphMatching::EstimationOption estimation;
+    bool load_full_dataset = false, share_filtering = false;
+    GraphLib::SubHyperGraphMatching::SubHyperGraphMatchingOption opt_;
     for (int i = 1; i < argc; ++i) {
         if (argv[i][0] == '-') {
             switch (argv[i][1]) {
@@ -36,39 +401,155 @@ int32_t main(int argc, char *argv[]) {
                 case 'q':
                     query_name = argv[i + 1];
                     break;
+                case 'p':
+                    path = argv[i + 1];
+                    break;
+                case 'b':
+                    query_list = argv[i + 1];
+                    break;
+                case 'o':
+                    output = argv[i + 1];
+                    break;
+                case 'r':
+                    rounds_output = argv[i + 1];
+                    break;
+                case 'e':
+                    driver_opt.enumerate = true;
+                    break;
+                case 'E':
+                    embeddings_output = argv[i + 1];
+                    driver_opt.enumerate = true;
+                    break;
+                case 'X':
+                    factorized_output = argv[i + 1];
+                    driver_opt.enumerate = true;
+                    break;
+                case 'F':
+                    load_full_dataset = true;
+                    break;
+                case 'S':
+                    share_filtering = true;
+                    break;
+                case 'M':
+                    driver_opt.report_memory = true;
+                    Profiler::Global().SetEnabled(true);
+                    Profiler::Global().EnableMemoryTracking();
+                    break;
+                case 'm':
+                    opt_.max_memory_bytes = (size_t)(atof(argv[i + 1]) * 1048576);
+                    break;
+                case 'P':
+                    Profiler::Global().SetEnabled(true);
+                    break;
+                case 'C':
+                    Profiler::Global().SetEnabled(true);
+                    Profiler::Global().EnableHardwareCounters();
+                    break;
+                case 'L':
+                    driver_opt.backtrack.max_num_matches = atoll(argv[i + 1]);
+                    break;
+                case 'N':
+                    driver_opt.backtrack.max_search_nodes = atoll(argv[i + 1]);
+                    break;
+                case 't':
+                    driver_opt.backtrack.time_limit_ms = atof(argv[i + 1]);
+                    break;
+                case 'A':
+                    estimation.time_budget_ms = atof(argv[i + 1]);
+                    driver_opt.estimation = &estimation;
+                    break;
+                case 'l':
+                    driver_opt.motif_cache_bytes = (size_t)(atof(argv[i + 1]) * 1048576);
+                    break;
+                case 'G':
+                    driver_opt.check_generator = true;
+                    driver_opt.enumerate = true;
+                    break;
+                case 'R':
+                    factorized_input = argv[i + 1];
+                    break;
             }
         }
     }
-    query = "../dataset/hypergraphs/"+dataset+"/queries/"+query_name+".txt";
+    auto QueryPath = [&](const std::string &name) {
+        return path + "/" + dataset + "/queries/" + name + ".txt";
+    };
 
-    GraphLib::SubHyperGraphMatching::SubHyperGraphMatchingOption opt_;
-    GraphLib::SubHyperGraphMatching::PatternHyperGraph PG;
-    PG.ReadPatternHyperGraph(query);
-    PG.PrintStatistics("PatternGraph");
-    if (PG.GetNumVertices() >= MAX_NUM_VERTICES) {
-        return 5;
+    std::vector<std::string> query_names;
+    if (query_list.empty()) query_names.push_back(query_name);
+    else {
+        std::ifstream fin(query_list);
+        if (!fin.is_open()) {
+            fprintf(stderr, "Cannot open query list %s\n", query_list.c_str());
+            return 1;
+        }
+        std::string line;
+        while (getline(fin, line)) {
+            if (!line.empty()) query_names.push_back(line);
+        }
     }
-    GraphLib::SubHyperGraphMatching::DataHyperGraph HG;
-    HG.LoadDataGraph(dataset, "../dataset/hypergraphs/", PG);
-    HG.PrintStatistics("Extracted DataGraph");
+    std::vector<GraphLib::SubHyperGraphMatching::PatternHyperGraph> patterns(query_names.size());
+    for (size_t i = 0; i < query_names.size(); i++) patterns[i].ReadPatternHyperGraph(QueryPath(query_names[i]));
 
-    timer.Start();
-    GraphLib::SubHyperGraphMatching::HyperCandidateSpace HCS(&HG, &PG, opt_);
-    timer.Stop();
-    fprintf(stderr, "FilteringTime: %.02lf\n", timer.GetTime());
+    GraphLib::SubHyperGraphMatching::HyperGraphDataset D;
+    Timer load_timer;
+    load_timer.Start();
+    if (load_full_dataset) D.Load(dataset, path);
+    else D.LoadForPatterns(dataset, path, patterns);
+    load_timer.Stop();
+    fprintf(stderr, "LoadingTime: %.02lf (%zu hyperedges)\n", load_timer.GetTime(), D.hyperedges.size());
+    if (!factorized_input.empty()) {
+        std::unique_ptr<ResultTable> checks;
+        if (!query_list.empty()) checks = std::make_unique<ResultTable>(output);
+        return CheckFactorizedResults(D, patterns, query_names, factorized_input, checks.get());
+    }
+    std::unique_ptr<ResultTable> rounds;
+    if (!rounds_output.empty()) {
+        rounds = std::make_unique<ResultTable>(rounds_output);
+        driver_opt.refinement_rounds = rounds.get();
+    }
+    if (!embeddings_output.empty()) {
+        driver_opt.embeddings = fopen(embeddings_output.c_str(), "w");
+        if (driver_opt.embeddings == nullptr) {
+            fprintf(stderr, "Cannot open %s\n", embeddings_output.c_str());
+            return 1;
+        }
+    }
+    // a write error of -E (a full disk, say) fails the run
+    auto CloseEmbeddings = [&]() {
+        if (driver_opt.embeddings == nullptr) return true;
+        bool written = !ferror(driver_opt.embeddings);
+        written = fclose(driver_opt.embeddings) == 0 and written;
+        driver_opt.embeddings = nullptr;
+        if (!written) fprintf(stderr, "Cannot write %s\n", embeddings_output.c_str());
+        return written;
+    };
+    std::unique_ptr<FactorizedResultWriter> factorized;
+    if (!factorized_output.empty()) {
+        factorized = std::make_unique<FactorizedResultWriter>(factorized_output);
+        driver_opt.factorized = factorized.get();
+    }
 
-//    DataGraph D(HG.BipartiteRepresentation());
-//    D.Preprocess();
-//    D.EnumerateLocalTriangles();
-//    D.EnumerateLocalFourCycles();
-//    PatternGraph P(PG.BipartiteRepresentation());
-//    GraphLib::SubgraphMatching::SubgraphMatchingOption opt;
-//    GraphLib::SubgraphMatching::BacktrackEngine backtrack(&D, opt);
-//    P.ProcessPattern(D);
-//    timer.Start();
-//    P.EnumerateLocalTriangles();
-//    P.EnumerateLocalFourCycles();
-//    backtrack.Match(&P);
-//    cout << backtrack.num_embeddings << endl;
-//    timer.Stop();
-}
\ No newline at end of file
+    if (query_list.empty()) {
+        int rc = RunQuery(D, patterns[0], query_name, opt_, driver_opt, nullptr);
+        if (!CloseEmbeddings()) rc = 1;
+        if (Profiler::Global().Enabled()) Profiler::Global().Report(log_to);
+        return rc;
+    }
+    std::unique_ptr<SubHyperGraphMatching::BatchFilter> batch_filter;
+    if (share_filtering) {
+        if (D.hyperedges_by_signature.empty()) D.BuildSignatureIndex();
+        batch_filter = std::make_unique<SubHyperGraphMatching::BatchFilter>(D, patterns, opt_);
+        fprintf(stderr, "BatchFilteringTime: %.02lf (%lld stars, %lld distinct)\n", batch_filter->filter_time,
+                batch_filter->num_stars, batch_filter->num_distinct_stars);
+    }
+    ResultTable results(output);
+    for (size_t i = 0; i < query_names.size(); i++) {
+        results.Set("load_ms", load_timer.GetTime());
+        if (batch_filter != nullptr) results.Set("batch_filter_ms", batch_filter->filter_time);
+        RunQuery(D, patterns[i], query_names[i], opt_, driver_opt, &results,
+                 batch_filter != nullptr ? batch_filter->GetVertexCandidates(i) : nullptr);
+    }
+    if (Profiler::Global().Enabled()) Profiler::Global().Report(log_to);
+    return CloseEmbeddings() ? 0 : 1;
+}
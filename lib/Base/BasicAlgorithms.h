@@ -1,5 +1,8 @@
 #pragma once
 #include "Base.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 struct UnionFind {
     std::vector<int> par, sz;
@@ -34,22 +37,22 @@ struct UnionFind {
 };
 
 struct BipartiteMaximumMatching {
-    int *left, *right;
-    int left_len, right_len, arr_len;
-    bool *used;
-    int **adj, *adj_size;
-    int **adj_index;
+    int *left = nullptr, *right = nullptr;
+    int left_len = 0, right_len = 0, arr_len = 0;
+    bool *used = nullptr;
+    int **adj = nullptr, *adj_size = nullptr;
+    int **adj_index = nullptr;
 
-    bool **matchable;
-    bool *bfs_visited;
-    int *right_order, *inverse_right_order;
-    int **lower_graph, *lower_graph_size;
-    int **upper_graph, *upper_graph_size;
+    bool **matchable = nullptr;
+    bool *bfs_visited = nullptr;
+    int *right_order = nullptr, *inverse_right_order = nullptr;
+    int **lower_graph = nullptr, *lower_graph_size = nullptr;
+    int **upper_graph = nullptr, *upper_graph_size = nullptr;
 
-    int *Q, *S;
+    int *Q = nullptr, *S = nullptr;
     int qright = 0, qleft = 0;
     int stkright = 0;
-    int *dfsn, *scch, *scc_idx, ord, found_scc;
+    int *dfsn = nullptr, *scch = nullptr, *scc_idx = nullptr, ord, found_scc;
 
     /* SCC */
     int FindSCC(int v) {
@@ -79,9 +82,9 @@ struct BipartiteMaximumMatching {
     bool FindUnmatchableEdges(int required) {
         ord = 0;
         found_scc = 0;
-        memset(dfsn, 0, arr_len);
-        memset(scch, 0, arr_len);
-        memset(scc_idx, -1, arr_len);
+        memset(dfsn, 0, sizeof(int) * arr_len);
+        memset(scch, 0, sizeof(int) * arr_len);
+        memset(scc_idx, -1, sizeof(int) * arr_len);
         int num_matched_ans = Solve();
         if (num_matched_ans != required) return false;
         for (int i = 0; i < num_matched_ans; i++) {
@@ -148,27 +151,31 @@ struct BipartiteMaximumMatching {
 
 
     ~BipartiteMaximumMatching() {
-        delete[] left;
-        delete[] right;
-        delete[] used;
+        Release();
+    }
+
+    // free the arrays of the last Initialize, so that a solver can be initialized once per query
+    void Release() {
         for (int i = 0; i < left_len; i++) {
             delete[] adj[i];
+            delete[] adj_index[i];
             delete[] matchable[i];
             delete[] upper_graph[i];
         }
+        for (int i = 0; i < right_len; i++) {
+            delete[] lower_graph[i];
+        }
+        for (int **arr : {adj, adj_index, lower_graph, upper_graph}) delete[] arr;
+        for (int *arr : {left, right, adj_size, lower_graph_size, upper_graph_size, right_order,
+                         inverse_right_order, Q, S, dfsn, scch, scc_idx}) delete[] arr;
         delete[] matchable;
-        delete[] adj;
-        delete[] adj_size;
-        delete[] lower_graph;
-        delete[] upper_graph;
-        delete[] lower_graph_size;
-        delete[] upper_graph_size;
-        delete[] right_order;
-        delete[] inverse_right_order;
+        delete[] used;
         delete[] bfs_visited;
+        left_len = right_len = arr_len = 0;
     }
 
     void Initialize(int max_left, int max_right, int max_query_vertex) {
+        Release();
         Q = new int[max_right];
         S = new int[max_right];
         qleft = qright = stkright = 0;
@@ -330,23 +337,50 @@ void VectorIntersection(
         std::vector<int> &B,
         std::vector<int> &results
 ) {
-    int a_idx = 0, b_idx = 0;
-    while (a_idx < A.size()) {
-        int target = A[a_idx];
-        if (target > B[b_idx]) return;
-        while (b_idx < B.size()) {
-            if (B[b_idx] < target) {
-                b_idx++;
-            }
-            else if (B[b_idx] > target) {
-                goto nxt_target;
-            }
-            else break;
+    size_t a_idx = 0, b_idx = 0;
+    while (a_idx < A.size() and b_idx < B.size()) {
+        if (A[a_idx] < B[b_idx]) {
+            a_idx++;
         }
-        if (target == B[b_idx]) {
-            results.push_back(target);
+        else if (A[a_idx] > B[b_idx]) {
+            b_idx++;
+        }
+        else {
+            results.push_back(A[a_idx]);
+            a_idx++;
+            b_idx++;
+        }
+    }
+}
+
+/**
+ * @brief Size of the intersection of two sorted arrays of distinct values
+ * @details With SSE2, blocks of four are compared all-against-all (four rotations of one block), and the
+ * block with the smaller maximum is advanced; the tails are merged serially.
+ */
+inline int SortedIntersectionCount(const int *a, int na, const int *b, int nb) {
+    int i = 0, j = 0, count = 0;
+#ifdef __SSE2__
+    while (i + 4 <= na and j + 4 <= nb) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + j));
+        __m128i eq = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                             _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+                _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                             _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+        count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(eq)));
+        int a_max = a[i + 3], b_max = b[j + 3];
+        if (a_max <= b_max) i += 4;
+        if (b_max <= a_max) j += 4;
+    }
+#endif
+    while (i < na and j < nb) {
+        if (a[i] < b[j]) i++;
+        else if (a[i] > b[j]) j++;
+        else {
+            count++; i++; j++;
         }
-        nxt_target:
-        a_idx++;
     }
+    return count;
 }
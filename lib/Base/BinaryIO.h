@@ -0,0 +1,162 @@
+#pragma once
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Sequential writer of plain-old-data values and arrays, for binary snapshots.
+ * @details Arrays are written as (uint64 length, elements); every record is padded to 8 bytes.
+ */
+class BinaryWriter {
+    FILE *fp = nullptr;
+    uint64_t written = 0;
+
+    void WriteBytes(const void *src, size_t bytes) {
+        if (bytes > 0 and fwrite(src, 1, bytes, fp) != bytes) {
+            fprintf(stderr, "BinaryWriter: write failed after %llu bytes\n", (unsigned long long)written);
+            exit(1);
+        }
+        written += bytes;
+        static const char zeros[8] = {0};
+        if (written % 8 != 0) {
+            size_t pad = 8 - written % 8;
+            fwrite(zeros, 1, pad, fp);
+            written += pad;
+        }
+    }
+public:
+    explicit BinaryWriter(const std::string &filename) {
+        fp = fopen(filename.c_str(), "wb");
+        if (fp == nullptr) {
+            fprintf(stderr, "BinaryWriter: cannot open %s\n", filename.c_str());
+            exit(1);
+        }
+    }
+    ~BinaryWriter() { if (fp) fclose(fp); }
+    BinaryWriter(const BinaryWriter &) = delete;
+    BinaryWriter &operator=(const BinaryWriter &) = delete;
+
+    inline uint64_t BytesWritten() const { return written; }
+
+    template <typename T>
+    void Write(const T &value) {
+        static_assert(std::is_standard_layout_v<T>);
+        WriteBytes(&value, sizeof(T));
+    }
+
+    template <typename T>
+    void WriteVector(const std::vector<T> &vec) {
+        static_assert(std::is_standard_layout_v<T>);
+        Write<uint64_t>(vec.size());
+        WriteBytes(vec.data(), vec.size() * sizeof(T));
+    }
+
+    void WriteVector(const std::vector<bool> &vec) {
+        std::vector<char> bytes(vec.begin(), vec.end());
+        WriteVector(bytes);
+    }
+
+    /**
+     * @brief Nested vectors are flattened into (offsets, elements)
+     */
+    template <typename T>
+    void WriteNested(const std::vector<std::vector<T>> &nested) {
+        std::vector<uint64_t> offsets(1, 0);
+        std::vector<T> flat;
+        for (auto &vec : nested) {
+            flat.insert(flat.end(), vec.begin(), vec.end());
+            offsets.push_back(flat.size());
+        }
+        WriteVector(offsets);
+        WriteVector(flat);
+    }
+};
+
+/**
+ * @brief Read-only memory mapping of a file, read back in the order it was written by BinaryWriter.
+ */
+class MappedFileReader {
+    const char *data = nullptr;
+    size_t size = 0, pos = 0;
+    std::string filename;
+
+    const char *ReadBytes(size_t bytes) {
+        if (pos + bytes > size) {
+            fprintf(stderr, "MappedFileReader: %s is truncated (need %zu bytes at offset %zu)\n",
+                    filename.c_str(), bytes, pos);
+            exit(1);
+        }
+        const char *src = data + pos;
+        pos += (bytes + 7) / 8 * 8;
+        return src;
+    }
+public:
+    explicit MappedFileReader(const std::string &filename) : filename(filename) {
+        int fd = open(filename.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 or fstat(fd, &st) != 0) {
+            fprintf(stderr, "MappedFileReader: cannot open %s\n", filename.c_str());
+            exit(1);
+        }
+        size = st.st_size;
+        if (size > 0) {
+            void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                fprintf(stderr, "MappedFileReader: mmap of %s failed\n", filename.c_str());
+                exit(1);
+            }
+            madvise(mapped, size, MADV_SEQUENTIAL);
+            data = (const char *)mapped;
+        }
+        close(fd);
+    }
+    ~MappedFileReader() { if (data) munmap((void *)data, size); }
+    MappedFileReader(const MappedFileReader &) = delete;
+    MappedFileReader &operator=(const MappedFileReader &) = delete;
+
+    inline size_t Size() const { return size; }
+    inline bool AtEnd() const { return pos >= size; }
+
+    template <typename T>
+    T Read() {
+        T value;
+        memcpy((void *)&value, ReadBytes(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void ReadVector(std::vector<T> &vec) {
+        uint64_t n = Read<uint64_t>();
+        vec.resize(n);
+        memcpy((void *)vec.data(), ReadBytes(n * sizeof(T)), n * sizeof(T));
+    }
+
+    void ReadVector(std::vector<bool> &vec) {
+        std::vector<char> bytes;
+        ReadVector(bytes);
+        vec.assign(bytes.begin(), bytes.end());
+    }
+
+    template <typename T>
+    void ReadNested(std::vector<std::vector<T>> &nested) {
+        std::vector<uint64_t> offsets;
+        uint64_t n = Read<uint64_t>();
+        offsets.resize(n);
+        memcpy(offsets.data(), ReadBytes(n * sizeof(uint64_t)), n * sizeof(uint64_t));
+        uint64_t num_elements = Read<uint64_t>();
+        const T *flat = (const T *)ReadBytes(num_elements * sizeof(T));
+        nested.assign(n - 1, {});
+        for (uint64_t i = 0; i + 1 < n; i++) {
+            nested[i].resize(offsets[i + 1] - offsets[i]);
+            memcpy((void *)nested[i].data(), flat + offsets[i], (offsets[i + 1] - offsets[i]) * sizeof(T));
+        }
+    }
+};
@@ -0,0 +1,255 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+#include "Base/Generator.h"
+
+/**
+ * @brief One embedding: the data vertex matched to each query vertex and, for hypergraph queries, the data
+ * hyperedge matched to each query hyperedge (empty for graph queries)
+ */
+struct EmbeddingView {
+    std::span<const int> vertices, hyperedges;
+};
+
+/**
+ * @brief Embeddings sharing a partial match, in factorized form: the partial match, and the candidates of each
+ * remaining ("free") query element, none of whose neighbors is free
+ * @details Query element x is vertex x if x < vertices.size(), hyperedge x - vertices.size() otherwise; the
+ * partial match has -1 for the free elements. The free elements come group by group, group g being
+ * free[group_offsets[g] .. group_offsets[g+1]), and free[i] may take candidates[candidate_offsets[i] ..
+ * candidate_offsets[i+1]). Injectivity: the elements of one group take distinct candidates. The candidate sets of
+ * different groups are disjoint and avoid the partial match, so every other choice is free: the embeddings are
+ * the injective choices of each group, combined in every way (num_embeddings of them).
+ */
+struct FactorizedEmbedding {
+    std::span<const int> vertices, hyperedges;
+    std::span<const int> free, group_offsets, candidate_offsets, candidates;
+    unsigned long long num_embeddings = 0;
+};
+
+/**
+ * @brief Hand every embedding of a factorized result to consume, until it returns false
+ * @return false if consume stopped the expansion
+ */
+bool ExpandFactorized(const FactorizedEmbedding &f, const std::function<bool(const EmbeddingView &)> &consume) {
+    std::vector<int> vertices(f.vertices.begin(), f.vertices.end());
+    std::vector<int> hyperedges(f.hyperedges.begin(), f.hyperedges.end());
+    std::vector<int> group_begin(f.free.size());
+    for (size_t g = 0; g + 1 < f.group_offsets.size(); g++) {
+        for (int i = f.group_offsets[g]; i < f.group_offsets[g + 1]; i++) group_begin[i] = f.group_offsets[g];
+    }
+    auto Element = [&](int x) -> int & {
+        return x < (int)vertices.size() ? vertices[x] : hyperedges[x - vertices.size()];
+    };
+    std::function<bool(int)> Extend = [&](int i) {
+        if (i == (int)f.free.size()) return consume({vertices, hyperedges});
+        for (int c = f.candidate_offsets[i]; c < f.candidate_offsets[i + 1]; c++) {
+            int w = f.candidates[c];
+            bool used = false;
+            for (int j = group_begin[i]; j < i and !used; j++) used = Element(f.free[j]) == w;
+            if (used) continue;
+            Element(f.free[i]) = w;
+            if (!Extend(i + 1)) return false;
+        }
+        return true;
+    };
+    return Extend(0);
+}
+
+/**
+ * @brief Receiver of the embeddings found by a matching engine (BacktrackEngine::Match, MatchingService::Enumerate)
+ * @details The engine calls Consume on its own thread, once per embedding; the view is valid during the call only.
+ * Returning false stops the search (early stop), and blocking in Consume holds the search back (backpressure).
+ * Finish is called once when the search ends, stopped or not. Engines given no sink only count the embeddings,
+ * as before.
+ * A sink whose Factorized() is true receives, through ConsumeFactorized, all the embeddings of a partial match
+ * whose remaining query vertices are independent at once, instead of one Consume per embedding.
+ */
+class EmbeddingSink {
+public:
+    virtual ~EmbeddingSink() = default;
+    virtual bool Consume(const EmbeddingView &embedding) = 0;
+    virtual bool Factorized() const { return false; }
+    virtual bool ConsumeFactorized(const FactorizedEmbedding &embeddings) {
+        return ExpandFactorized(embeddings, [this](const EmbeddingView &embedding) { return Consume(embedding); });
+    }
+    virtual void Finish() {}
+};
+
+/**
+ * @brief Sink calling a function on each embedding
+ */
+class CallbackSink : public EmbeddingSink {
+    std::function<bool(const EmbeddingView &)> callback;
+public:
+    explicit CallbackSink(std::function<bool(const EmbeddingView &)> callback_) : callback(std::move(callback_)) {};
+    bool Consume(const EmbeddingView &embedding) override { return callback(embedding); }
+};
+
+/**
+ * @brief Embeddings of one query stored row by row, in two flat arrays
+ */
+class EmbeddingBatch {
+    size_t num_vertices = 0, num_hyperedges = 0, size = 0;
+    std::vector<int> vertices, hyperedges;
+public:
+    size_t Size() const { return size; }
+    bool Empty() const { return size == 0; }
+    EmbeddingView operator[](size_t i) const {
+        return {std::span<const int>(vertices).subspan(i * num_vertices, num_vertices),
+                std::span<const int>(hyperedges).subspan(i * num_hyperedges, num_hyperedges)};
+    }
+    void Add(const EmbeddingView &embedding) {
+        num_vertices = embedding.vertices.size();
+        num_hyperedges = embedding.hyperedges.size();
+        vertices.insert(vertices.end(), embedding.vertices.begin(), embedding.vertices.end());
+        hyperedges.insert(hyperedges.end(), embedding.hyperedges.begin(), embedding.hyperedges.end());
+        size++;
+    }
+    void Clear() {
+        vertices.clear();
+        hyperedges.clear();
+        size = 0;
+    }
+};
+
+/**
+ * @brief Sink handing the embeddings to a function in batches of batch_size (the last, partial one at Finish), to
+ * amortize the per-embedding cost of the consumer
+ */
+class BatchSink : public EmbeddingSink {
+    size_t batch_size;
+    EmbeddingBatch batch;
+    std::function<bool(const EmbeddingBatch &)> callback;
+public:
+    BatchSink(size_t batch_size_, std::function<bool(const EmbeddingBatch &)> callback_)
+        : batch_size(std::max<size_t>(batch_size_, 1)), callback(std::move(callback_)) {};
+    bool Consume(const EmbeddingView &embedding) override {
+        batch.Add(embedding);
+        if (batch.Size() < batch_size) return true;
+        bool go_on = callback(batch);
+        batch.Clear();
+        return go_on;
+    }
+    void Finish() override {
+        if (!batch.Empty()) callback(batch);
+        batch.Clear();
+    }
+};
+
+/**
+ * @brief Sink passing batches of embeddings from the thread of a search to the thread of GenerateEmbeddings, through
+ * a queue of at most max_pending batches; the search blocks while the queue is full
+ */
+class EmbeddingChannel : public EmbeddingSink {
+    size_t batch_size, max_pending;
+    EmbeddingBatch filling;
+    std::deque<EmbeddingBatch> pending;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool closed = false;
+    std::atomic<bool> cancelled = false;
+
+    bool Push() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return pending.size() < max_pending or cancelled; });
+        if (cancelled) return false;
+        pending.push_back(std::move(filling));
+        filling = EmbeddingBatch();
+        changed.notify_all();
+        return true;
+    }
+public:
+    EmbeddingChannel(size_t batch_size_, size_t max_pending_)
+        : batch_size(std::max<size_t>(batch_size_, 1)), max_pending(std::max<size_t>(max_pending_, 1)) {};
+
+    bool Consume(const EmbeddingView &embedding) override {
+        if (cancelled.load(std::memory_order_relaxed)) return false;
+        filling.Add(embedding);
+        return filling.Size() < batch_size or Push();
+    }
+    void Finish() override {
+        if (!filling.Empty()) Push();
+    }
+    /**
+     * @brief No more batches will come (called by the search thread when done)
+     */
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        changed.notify_all();
+    }
+    /**
+     * @brief Flag set by Cancel: the search should also poll it (SubgraphMatchingOption::cancel), since a search
+     * finding few embeddings may run long before its next Consume
+     */
+    const std::atomic<bool> &CancelFlag() const { return cancelled; }
+    /**
+     * @brief Make the search stop at its next embedding (or its next poll of CancelFlag), and unblock it
+     */
+    void Cancel() {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+        changed.notify_all();
+    }
+    /**
+     * @brief Wait for the next batch
+     * @return false once the channel is closed and drained
+     */
+    bool Pop(EmbeddingBatch &batch) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return !pending.empty() or closed; });
+        if (pending.empty()) return false;
+        batch = std::move(pending.front());
+        pending.pop_front();
+        changed.notify_all();
+        return true;
+    }
+};
+
+/**
+ * @brief Search running on its own thread into an EmbeddingChannel (run(sink, cancel_flag)), closing it when done;
+ * destroying the object cancels the search and waits for its thread
+ */
+class ChannelSearch {
+    EmbeddingChannel &channel;
+    std::thread thread;
+public:
+    ChannelSearch(EmbeddingChannel &channel_, std::function<void(EmbeddingSink &, const std::atomic<bool> &)> run)
+        : channel(channel_), thread([this, run = std::move(run)] {
+              run(channel, channel.CancelFlag());
+              channel.Finish();
+              channel.Close();
+          }) {};
+    ~ChannelSearch() {
+        channel.Cancel();
+        thread.join();
+    }
+};
+
+/**
+ * @brief Embeddings of a search as a coroutine generator: for (const EmbeddingView &e : GenerateEmbeddings(...))
+ * @param run runs the search with the given sink, polling the given flag, e.g.
+ * [&](EmbeddingSink &sink, const std::atomic<bool> &cancel) { opt.cancel = &cancel; ...; engine.Match(&query, &sink); }
+ * @details run is started on its own thread when the loop begins and hands its embeddings over in batches of
+ * batch_size; at most max_pending batches wait for the loop, after which the search blocks. Leaving the loop early
+ * (destroying the generator) sets the flag, stops the search at its next embedding or poll of the flag, and waits
+ * for its thread.
+ */
+Generator<EmbeddingView> GenerateEmbeddings(std::function<void(EmbeddingSink &, const std::atomic<bool> &)> run,
+                                           size_t batch_size = 1024, size_t max_pending = 4) {
+    EmbeddingChannel channel(batch_size, max_pending);
+    // destroyed when the coroutine ends or is destroyed while suspended
+    ChannelSearch search(channel, std::move(run));
+    EmbeddingBatch batch;
+    while (channel.Pop(batch)) {
+        for (size_t i = 0; i < batch.Size(); i++) co_yield batch[i];
+    }
+}
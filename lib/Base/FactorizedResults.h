@@ -0,0 +1,204 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Base/BinaryIO.h"
+#include "Base/EmbeddingSink.h"
+
+/**
+ * File of factorized results (FactorizedEmbedding), written with BinaryWriter:
+ *   magic, version, then one section per query:
+ *   name (chars), number of query vertices, number of query hyperedges,
+ *   blocks of results: (uint64 num_embeddings of each result), (int32 records of the results),
+ *   an empty block, then the number of results and of embeddings in the section.
+ * The record of a result is the partial match (one id per query vertex, then per query hyperedge, -1 for the
+ * free ones), the number of groups, and for each group its size and, for each of its free elements, the element,
+ * its number of candidates and the candidates. A plain embedding is a record with no group.
+ */
+static const uint64_t FACTORIZED_RESULTS_MAGIC = 0x3153455254434146ULL; // "FACTRES1"
+static const uint32_t FACTORIZED_RESULTS_VERSION = 1;
+
+/**
+ * @brief Sink writing factorized results to a file, one section per query: call BeginQuery, run the search, then
+ * Finish (engines call it at the end of the search; calling it again does nothing)
+ */
+class FactorizedResultWriter : public EmbeddingSink {
+    BinaryWriter out;
+    size_t block_size;
+    int num_vertices = 0, num_hyperedges = 0;
+    std::vector<uint64_t> counts;
+    std::vector<int32_t> records;
+    bool in_section = false;
+    unsigned long long num_results = 0, num_embeddings = 0;
+
+    void AddMatch(std::span<const int> vertices, std::span<const int> hyperedges) {
+        records.insert(records.end(), vertices.begin(), vertices.end());
+        records.insert(records.end(), hyperedges.begin(), hyperedges.end());
+    }
+    void EndResult(unsigned long long count) {
+        counts.push_back(count);
+        num_results++;
+        num_embeddings += count;
+        if (counts.size() >= block_size) Flush();
+    }
+    void Flush() {
+        if (counts.empty()) return;
+        out.WriteVector(counts);
+        out.WriteVector(records);
+        counts.clear();
+        records.clear();
+    }
+public:
+    explicit FactorizedResultWriter(const std::string &filename, size_t block_size_ = 4096)
+        : out(filename), block_size(std::max<size_t>(block_size_, 1)) {
+        out.Write<uint64_t>(FACTORIZED_RESULTS_MAGIC);
+        out.Write<uint32_t>(FACTORIZED_RESULTS_VERSION);
+    }
+
+    void BeginQuery(const std::string &name, int num_vertices_, int num_hyperedges_) {
+        Finish();
+        num_vertices = num_vertices_;
+        num_hyperedges = num_hyperedges_;
+        out.WriteVector(std::vector<char>(name.begin(), name.end()));
+        out.Write<uint32_t>(num_vertices);
+        out.Write<uint32_t>(num_hyperedges);
+        num_results = num_embeddings = 0;
+        in_section = true;
+    }
+    bool Consume(const EmbeddingView &embedding) override {
+        AddMatch(embedding.vertices, embedding.hyperedges);
+        records.push_back(0);
+        EndResult(1);
+        return true;
+    }
+    bool Factorized() const override { return true; }
+    bool ConsumeFactorized(const FactorizedEmbedding &f) override {
+        AddMatch(f.vertices, f.hyperedges);
+        int num_groups = f.group_offsets.empty() ? 0 : f.group_offsets.size() - 1;
+        records.push_back(num_groups);
+        for (int g = 0; g < num_groups; g++) {
+            records.push_back(f.group_offsets[g + 1] - f.group_offsets[g]);
+            for (int i = f.group_offsets[g]; i < f.group_offsets[g + 1]; i++) {
+                records.push_back(f.free[i]);
+                records.push_back(f.candidate_offsets[i + 1] - f.candidate_offsets[i]);
+                records.insert(records.end(), f.candidates.begin() + f.candidate_offsets[i],
+                               f.candidates.begin() + f.candidate_offsets[i + 1]);
+            }
+        }
+        EndResult(f.num_embeddings);
+        return true;
+    }
+    void Finish() override {
+        if (!in_section) return;
+        Flush();
+        out.WriteVector(std::vector<uint64_t>());
+        out.Write<uint64_t>(num_results);
+        out.Write<uint64_t>(num_embeddings);
+        in_section = false;
+    }
+    unsigned long long GetNumResults() const { return num_results; }
+    unsigned long long GetNumEmbeddings() const { return num_embeddings; }
+};
+
+/**
+ * @brief Reader of a file of FactorizedResultWriter, section by section; the results can be expanded
+ * (ExpandFactorized) or aggregated directly (FactorizedEmbedding::num_embeddings)
+ */
+class FactorizedResultReader {
+    MappedFileReader in;
+    std::string filename;
+    int num_vertices = 0, num_hyperedges = 0;
+    bool in_section = false;
+    std::vector<uint64_t> counts;
+    std::vector<int32_t> records;
+    size_t next_result = 0, pos = 0;
+    unsigned long long num_results = 0, num_embeddings = 0;
+    std::vector<int> free, group_offsets, candidate_offsets, candidates;
+
+    int32_t Take() {
+        if (pos >= records.size()) {
+            fprintf(stderr, "FactorizedResultReader: %s has a truncated record\n", filename.c_str());
+            exit(1);
+        }
+        return records[pos++];
+    }
+public:
+    explicit FactorizedResultReader(const std::string &filename_) : in(filename_), filename(filename_) {
+        if (in.Size() < 16 or in.Read<uint64_t>() != FACTORIZED_RESULTS_MAGIC) {
+            fprintf(stderr, "%s is not a factorized result file\n", filename.c_str());
+            exit(1);
+        }
+        uint32_t version = in.Read<uint32_t>();
+        if (version != FACTORIZED_RESULTS_VERSION) {
+            fprintf(stderr, "%s has version %u, expected %u\n", filename.c_str(), version, FACTORIZED_RESULTS_VERSION);
+            exit(1);
+        }
+    }
+
+    /**
+     * @brief Move to the next section, skipping what is left of the current one
+     * @return false at the end of the file
+     */
+    bool NextQuery(std::string &name) {
+        FactorizedEmbedding skipped;
+        while (in_section) Next(skipped);
+        if (in.AtEnd()) return false;
+        std::vector<char> chars;
+        in.ReadVector(chars);
+        name.assign(chars.begin(), chars.end());
+        num_vertices = in.Read<uint32_t>();
+        num_hyperedges = in.Read<uint32_t>();
+        counts.clear();
+        next_result = 0;
+        in_section = true;
+        return true;
+    }
+    /**
+     * @brief Read the next result of the section; its spans are valid until the next call
+     * @return false at the end of the section (GetNumResults and GetNumEmbeddings then give its totals)
+     */
+    bool Next(FactorizedEmbedding &result) {
+        if (!in_section) return false;
+        if (next_result == counts.size()) {
+            in.ReadVector(counts);
+            if (counts.empty()) {
+                num_results = in.Read<uint64_t>();
+                num_embeddings = in.Read<uint64_t>();
+                in_section = false;
+                return false;
+            }
+            in.ReadVector(records);
+            next_result = pos = 0;
+        }
+        size_t match = pos;
+        pos += num_vertices + num_hyperedges;
+        free.clear();
+        candidates.clear();
+        group_offsets.assign(1, 0);
+        candidate_offsets.assign(1, 0);
+        int num_groups = Take();
+        for (int g = 0; g < num_groups; g++) {
+            int size = Take();
+            for (int k = 0; k < size; k++) {
+                free.push_back(Take());
+                int num_candidates = Take();
+                for (int c = 0; c < num_candidates; c++) candidates.push_back(Take());
+                candidate_offsets.push_back(candidates.size());
+            }
+            group_offsets.push_back(free.size());
+        }
+        std::span<const int> match_ids(records.data() + match, num_vertices + num_hyperedges);
+        result.vertices = match_ids.first(num_vertices);
+        result.hyperedges = match_ids.subspan(num_vertices);
+        result.free = free;
+        result.group_offsets = group_offsets;
+        result.candidate_offsets = candidate_offsets;
+        result.candidates = candidates;
+        result.num_embeddings = counts[next_result++];
+        return true;
+    }
+
+    int GetNumVertices() const { return num_vertices; }
+    int GetNumHyperedges() const { return num_hyperedges; }
+    unsigned long long GetNumResults() const { return num_results; }
+    unsigned long long GetNumEmbeddings() const { return num_embeddings; }
+};
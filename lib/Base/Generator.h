@@ -0,0 +1,80 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <utility>
+
+/**
+ * @brief Minimal C++20 coroutine generator (std::generator is C++23): a coroutine returning Generator<T> produces
+ * its values with co_yield, and a range-for over the generator resumes it for each one
+ * @details The generator is lazy and single-pass. A yielded value lives in the coroutine, so a reference to it is
+ * valid until the iterator is incremented. Destroying the generator destroys the suspended coroutine, running the
+ * destructors of its locals.
+ */
+template<typename T>
+class Generator {
+public:
+    struct promise_type {
+        const T *current = nullptr;
+        std::exception_ptr exception;
+
+        Generator get_return_object() { return Generator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        std::suspend_always yield_value(const T &value) noexcept {
+            current = std::addressof(value);
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+
+    class iterator {
+        std::coroutine_handle<promise_type> handle;
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        explicit iterator(std::coroutine_handle<promise_type> handle_) : handle(handle_) {};
+        const T &operator*() const { return *handle.promise().current; }
+        const T *operator->() const { return handle.promise().current; }
+        iterator &operator++() {
+            Resume(handle);
+            return *this;
+        }
+        void operator++(int) { ++*this; }
+        bool operator==(std::default_sentinel_t) const { return !handle or handle.done(); }
+    };
+
+    Generator(Generator &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {};
+    Generator &operator=(Generator &&other) noexcept {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    Generator(const Generator &) = delete;
+    Generator &operator=(const Generator &) = delete;
+    ~Generator() {
+        if (handle) handle.destroy();
+    }
+
+    iterator begin() {
+        Resume(handle);
+        return iterator(handle);
+    }
+    std::default_sentinel_t end() { return {}; }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit Generator(std::coroutine_handle<promise_type> handle_) : handle(handle_) {};
+    // run to the next co_yield (or the end), rethrowing what the coroutine threw
+    static void Resume(std::coroutine_handle<promise_type> h) {
+        h.resume();
+        if (h.promise().exception) std::rethrow_exception(std::exchange(h.promise().exception, nullptr));
+    }
+};
@@ -0,0 +1,90 @@
+#pragma once
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * @brief Thread-safe map of bounded size that evicts its least recently used entry
+ * @details Get and Put take a lock; keep Value cheap to copy (e.g. a shared_ptr to the cached object).
+ * A capacity of 0 disables the cache: Put drops the entry and Get always misses.
+ */
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class LRUCache {
+    size_t capacity;
+    // most recently used first
+    std::list<std::pair<Key, Value>> entries;
+    std::unordered_map<Key, typename std::list<std::pair<Key, Value>>::iterator, Hash> index;
+    mutable std::mutex mutex;
+    long long num_hits = 0, num_misses = 0, num_evictions = 0;
+public:
+    explicit LRUCache(size_t capacity_) : capacity(capacity_) {};
+
+    /**
+     * @brief Copy the value of key to value and mark it most recently used
+     * @return false if key is not cached
+     */
+    bool Get(const Key &key, Value &value);
+    /**
+     * @brief Insert or replace the value of key, evicting the least recently used entry if full
+     */
+    void Put(const Key &key, Value value);
+    void Clear();
+
+    size_t Size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+    size_t GetCapacity() const { return capacity; }
+    long long GetNumHits() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return num_hits;
+    }
+    long long GetNumMisses() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return num_misses;
+    }
+    long long GetNumEvictions() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return num_evictions;
+    }
+};
+
+template<typename Key, typename Value, typename Hash>
+bool LRUCache<Key, Value, Hash>::Get(const Key &key, Value &value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it == index.end()) {
+        num_misses++;
+        return false;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    value = it->second->second;
+    num_hits++;
+    return true;
+}
+
+template<typename Key, typename Value, typename Hash>
+void LRUCache<Key, Value, Hash>::Put(const Key &key, Value value) {
+    if (capacity == 0) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it != index.end()) {
+        it->second->second = std::move(value);
+        entries.splice(entries.begin(), entries, it->second);
+        return;
+    }
+    if (entries.size() >= capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+        num_evictions++;
+    }
+    entries.emplace_front(key, std::move(value));
+    index[key] = entries.begin();
+}
+
+template<typename Key, typename Value, typename Hash>
+void LRUCache<Key, Value, Hash>::Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    index.clear();
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+template <typename T> struct IsVector : std::false_type {};
+template <typename T> struct IsVector<std::vector<T>> : std::true_type {};
+
+/**
+ * @brief Heap bytes held by a (possibly nested) vector, counted by capacity, excluding the outer header
+ */
+template <typename T>
+size_t MemoryBytes(const std::vector<T> &vec) {
+    size_t bytes = vec.capacity() * sizeof(T);
+    if constexpr (IsVector<T>::value) {
+        for (auto &elem : vec) bytes += MemoryBytes(elem);
+    }
+    return bytes;
+}
+
+inline size_t MemoryBytes(const std::vector<bool> &vec) {
+    return vec.capacity() / 8;
+}
+
+/**
+ * @brief Bytes used by named structures, e.g. "HCS/vertex_cs_index", printed by decreasing size
+ */
+class MemoryReport {
+    std::vector<std::pair<std::string, size_t>> items;
+public:
+    void Add(const std::string &name, size_t bytes) { items.emplace_back(name, bytes); }
+
+    template <typename T>
+    void AddVector(const std::string &name, const std::vector<T> &vec) { Add(name, MemoryBytes(vec)); }
+
+    size_t Total() const {
+        size_t total = 0;
+        for (auto &[name, bytes] : items) total += bytes;
+        return total;
+    }
+
+    /**
+     * @brief Bytes of the structures whose name starts with prefix
+     */
+    size_t Total(const std::string &prefix) const {
+        size_t total = 0;
+        for (auto &[name, bytes] : items) {
+            if (name.compare(0, prefix.size(), prefix) == 0) total += bytes;
+        }
+        return total;
+    }
+
+    void Print(FILE *out, const std::string &title) const {
+        auto sorted = items;
+        std::stable_sort(sorted.begin(), sorted.end(), [](auto &a, auto &b) { return a.second > b.second; });
+        size_t total = std::max<size_t>(Total(), 1);
+        fprintf(out, "\e[0;31m[Memory] %s : %.2lf MB\e[0m\n", title.c_str(), Total() / 1048576.0);
+        for (auto &[name, bytes] : sorted) {
+            if (bytes == 0) continue;
+            fprintf(out, "  %-44s %12.2lf MB %6.1lf%%\n", name.c_str(), bytes / 1048576.0, 100.0 * bytes / total);
+        }
+    }
+};
@@ -0,0 +1,42 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "Base/Profiler.h"
+
+/**
+ * @brief Number of worker threads used by the parallel kernels (defaults to the hardware concurrency)
+ */
+inline int num_worker_threads = std::max(1u, std::thread::hardware_concurrency());
+
+/**
+ * @brief Run fn(i, thread_id) for every i in [begin, end).
+ * @details Chunks of `grain` consecutive indices are handed out dynamically, so skewed per-index work
+ * (e.g. edges of high-degree vertices) is balanced. thread_id is in [0, num_threads).
+ */
+template <typename Fn>
+void ParallelFor(long long begin, long long end, Fn &&fn, long long grain = 256, int num_threads = num_worker_threads) {
+    if (end <= begin) return;
+    grain = std::max(1LL, grain);
+    num_threads = (int)std::max(1LL, std::min((long long)num_threads, (end - begin + grain - 1) / grain));
+    if (num_threads == 1) {
+        for (long long i = begin; i < end; i++) fn(i, 0);
+        return;
+    }
+    std::atomic<long long> next(begin);
+    PhaseContext context = PhaseContext::Capture();
+    auto worker = [&](int thread_id) {
+        if (thread_id > 0) context.Adopt();
+        while (true) {
+            long long chunk_begin = next.fetch_add(grain);
+            if (chunk_begin >= end) break;
+            long long chunk_end = std::min(end, chunk_begin + grain);
+            for (long long i = chunk_begin; i < chunk_end; i++) fn(i, thread_id);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads; t++) threads.emplace_back(worker, t);
+    worker(0);
+    for (auto &th : threads) th.join();
+}
@@ -0,0 +1,387 @@
+#pragma once
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "Base/ResourceUsage.h"
+
+/**
+ * @brief Hierarchical phase profiler.
+ * @details Phases are opened with PROFILE_SCOPE("Name") and closed at the end of the enclosing scope; nested
+ * scopes form a tree. Each thread records into its own tree, without locks; trees are merged by phase path
+ * when reported (so the time of a phase run by several threads is the sum over the threads). Worker threads of
+ * ParallelFor start below the phase that was open in the calling thread.
+ * Optionally, every phase also accumulates hardware counters read through perf_event_open, and the phases of
+ * one thread record their peak RSS (the kernel's high-water mark is reset at every phase boundary).
+ * Disabled by default: a closed profiler costs one branch per scope.
+ */
+class Profiler {
+public:
+    enum { CYCLES, LLC_MISSES, BRANCH_MISSES, NUM_COUNTERS };
+    struct Node {
+        const char *name;
+        int parent;
+        std::vector<int> children;
+        unsigned long long num_calls = 0;
+        double total_ms = 0.0;
+        uint64_t counters[NUM_COUNTERS] = {0};
+        long long peak_rss_kb = 0;
+
+        Node(const char *name_, int parent_) : name(name_), parent(parent_) {}
+    };
+    // phase tree of one thread; node 0 is the root
+    struct ThreadTree {
+        std::vector<Node> nodes;
+        int current = 0;
+        // peak RSS of the open phase before the last reset of the high-water mark
+        long long carried_peak_kb = 0;
+        // perf_fd[0] leads the counter group
+        int perf_fd[NUM_COUNTERS] = {-1, -1, -1};
+        ThreadTree() { nodes.push_back(Node{"", -1}); }
+        ~ThreadTree() { for (int fd : perf_fd) if (fd >= 0) close(fd); }
+        ThreadTree(const ThreadTree &) = delete;
+        ThreadTree &operator=(const ThreadTree &) = delete;
+
+        int Child(int parent, const char *name) {
+            for (int c : nodes[parent].children) {
+                if (nodes[c].name == name or strcmp(nodes[c].name, name) == 0) return c;
+            }
+            nodes.push_back(Node{name, parent});
+            nodes[parent].children.push_back(nodes.size() - 1);
+            return nodes.size() - 1;
+        }
+        void ReadCounters(uint64_t *values);
+    };
+
+    static Profiler &Global() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    inline bool Enabled() const { return enabled; }
+    void SetEnabled(bool enable) { enabled = enable; }
+    /**
+     * @brief Also count cycles, LLC misses and branch misses per phase
+     * @return false if perf_event_open is not permitted (e.g. perf_event_paranoid, containers)
+     */
+    bool EnableHardwareCounters();
+    inline bool HardwareCountersEnabled() const { return hardware_counters; }
+    /**
+     * @brief Record the peak RSS of the phases run by the calling thread (phases of other threads are not tracked,
+     * since the high-water mark is per process)
+     * @return false if the high-water mark cannot be reset
+     */
+    bool EnableMemoryTracking();
+    inline bool TracksMemory() const { return memory_tracking and std::this_thread::get_id() == memory_thread; }
+    /**
+     * @brief Peak RSS (KB) since the innermost phase open in the calling thread started, including the peaks of
+     * its finished subphases; with memory tracking off, GetPeakRSSKB()
+     * @details The phases reset the high-water mark, so GetPeakRSSKB() alone only covers the last subphase.
+     */
+    long long GetPhasePeakRSSKB();
+
+    /**
+     * @brief Tree of the calling thread, created on first use
+     */
+    ThreadTree &Local();
+
+    /**
+     * @brief Merged tree of all threads. Call it when no phase is open in another thread.
+     */
+    std::vector<Node> Merge();
+    /**
+     * @brief Total time (ms) of the phases with the given path, e.g. "RunQuery/BuildCS"
+     */
+    double GetTime(const std::string &path);
+    void Report(FILE *out);
+    /**
+     * @brief Forget everything recorded so far (the phases open in the calling thread are kept)
+     */
+    void Reset();
+
+private:
+    bool enabled = false, hardware_counters = false, memory_tracking = false;
+    std::thread::id memory_thread;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadTree>> trees;
+    // trees of finished threads, merged together
+    std::vector<Node> retired = {Node{"", -1}};
+
+    struct TreeOwner {
+        ThreadTree *tree = nullptr;
+        ~TreeOwner() { if (tree) Global().Retire(tree); }
+    };
+    void Retire(ThreadTree *tree);
+    static void MergeInto(std::vector<Node> &dst, int dst_node, const std::vector<Node> &src, int src_node);
+    static int FindChild(std::vector<Node> &tree, int parent, const char *name);
+    void PrintNode(FILE *out, const std::vector<Node> &tree, int node, int depth);
+};
+
+/**
+ * @brief RAII guard of one phase
+ */
+class ScopedPhase {
+    Profiler::ThreadTree *tree = nullptr;
+    int parent = 0;
+    bool with_counters = false, with_memory = false;
+    long long saved_peak_kb = 0, outer_carried_peak_kb = 0;
+    std::chrono::steady_clock::time_point start;
+    uint64_t start_counters[Profiler::NUM_COUNTERS];
+public:
+    explicit ScopedPhase(const char *name) {
+        Profiler &profiler = Profiler::Global();
+        if (!profiler.Enabled()) return;
+        tree = &profiler.Local();
+        parent = tree->current;
+        tree->current = tree->Child(parent, name);
+        with_counters = profiler.HardwareCountersEnabled();
+        if (with_counters) tree->ReadCounters(start_counters);
+        with_memory = profiler.TracksMemory();
+        if (with_memory) {
+            saved_peak_kb = GetPeakRSSKB();
+            outer_carried_peak_kb = tree->carried_peak_kb;
+            tree->carried_peak_kb = 0;
+            ResetPeakRSS();
+        }
+        start = std::chrono::steady_clock::now();
+    }
+    ~ScopedPhase() {
+        if (tree == nullptr) return;
+        auto end = std::chrono::steady_clock::now();
+        Profiler::Node &node = tree->nodes[tree->current];
+        node.num_calls++;
+        node.total_ms += std::chrono::duration<double, std::milli>(end - start).count();
+        if (with_counters) {
+            uint64_t end_counters[Profiler::NUM_COUNTERS];
+            tree->ReadCounters(end_counters);
+            for (int i = 0; i < Profiler::NUM_COUNTERS; i++) node.counters[i] += end_counters[i] - start_counters[i];
+        }
+        if (with_memory) {
+            long long peak_kb = std::max(GetPeakRSSKB(), tree->carried_peak_kb);
+            node.peak_rss_kb = std::max(node.peak_rss_kb, peak_kb);
+            // the enclosing phase saw both what came before our reset and our own peak
+            tree->carried_peak_kb = std::max({outer_carried_peak_kb, saved_peak_kb, peak_kb});
+        }
+        tree->current = parent;
+    }
+    ScopedPhase(const ScopedPhase &) = delete;
+    ScopedPhase &operator=(const ScopedPhase &) = delete;
+};
+
+/**
+ * @brief Open phase path of a thread, handed to the worker threads it starts so that their phases nest below it
+ */
+class PhaseContext {
+    std::vector<const char *> path;
+public:
+    static PhaseContext Capture() {
+        PhaseContext context;
+        if (!Profiler::Global().Enabled()) return context;
+        auto &tree = Profiler::Global().Local();
+        for (int node = tree.current; node > 0; node = tree.nodes[node].parent) context.path.push_back(tree.nodes[node].name);
+        std::reverse(context.path.begin(), context.path.end());
+        return context;
+    }
+    /**
+     * @brief Move the current position of the calling thread to the captured path (without timing it)
+     */
+    void Adopt() const {
+        if (path.empty() or !Profiler::Global().Enabled()) return;
+        auto &tree = Profiler::Global().Local();
+        int node = 0;
+        for (const char *name : path) node = tree.Child(node, name);
+        tree.current = node;
+    }
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ScopedPhase PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+
+void Profiler::ThreadTree::ReadCounters(uint64_t *values) {
+    // PERF_FORMAT_GROUP : {nr, value[nr]}
+    uint64_t buf[1 + NUM_COUNTERS] = {0};
+    if (perf_fd[0] < 0 or read(perf_fd[0], buf, sizeof(buf)) < (ssize_t)sizeof(uint64_t)) {
+        for (int i = 0; i < NUM_COUNTERS; i++) values[i] = 0;
+        return;
+    }
+    for (int i = 0; i < NUM_COUNTERS; i++) values[i] = ((uint64_t)i < buf[0]) ? buf[1 + i] : 0;
+}
+
+static int OpenPerfCounter(uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = (group_fd == -1);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/**
+ * @brief Open the counters (cycles, LLC misses, branch misses) of the calling thread as one group
+ * @return false if unavailable; fds is then left closed
+ */
+static bool OpenPerfCounterGroup(int *fds) {
+    const uint64_t configs[Profiler::NUM_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES,
+                                                      PERF_COUNT_HW_BRANCH_MISSES};
+    for (int i = 0; i < Profiler::NUM_COUNTERS; i++) {
+        fds[i] = OpenPerfCounter(configs[i], i == 0 ? -1 : fds[0]);
+        if (fds[i] < 0) {
+            int saved_errno = errno;
+            for (int j = 0; j < i; j++) { close(fds[j]); fds[j] = -1; }
+            errno = saved_errno;
+            return false;
+        }
+    }
+    ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+bool Profiler::EnableHardwareCounters() {
+    int fds[NUM_COUNTERS];
+    if (!OpenPerfCounterGroup(fds)) {
+        fprintf(stderr, "Profiler: hardware counters are not available (perf_event_open: %s)\n", strerror(errno));
+        return false;
+    }
+    for (int fd : fds) close(fd);
+    hardware_counters = true;
+    return true;
+}
+
+bool Profiler::EnableMemoryTracking() {
+    if (!ResetPeakRSS()) {
+        fprintf(stderr, "Profiler: the peak RSS cannot be reset, per-phase peaks are not available\n");
+        return false;
+    }
+    memory_tracking = true;
+    memory_thread = std::this_thread::get_id();
+    return true;
+}
+
+long long Profiler::GetPhasePeakRSSKB() {
+    if (!enabled or !TracksMemory()) return GetPeakRSSKB();
+    return std::max(GetPeakRSSKB(), Local().carried_peak_kb);
+}
+
+Profiler::ThreadTree &Profiler::Local() {
+    thread_local TreeOwner owner;
+    if (owner.tree == nullptr) {
+        auto tree = std::make_unique<ThreadTree>();
+        if (hardware_counters) OpenPerfCounterGroup(tree->perf_fd);
+        owner.tree = tree.get();
+        std::lock_guard<std::mutex> lock(mutex);
+        trees.push_back(std::move(tree));
+    }
+    return *owner.tree;
+}
+
+void Profiler::Retire(ThreadTree *tree) {
+    std::lock_guard<std::mutex> lock(mutex);
+    MergeInto(retired, 0, tree->nodes, 0);
+    for (size_t i = 0; i < trees.size(); i++) {
+        if (trees[i].get() == tree) {
+            trees.erase(trees.begin() + i);
+            break;
+        }
+    }
+}
+
+int Profiler::FindChild(std::vector<Node> &tree, int parent, const char *name) {
+    for (int c : tree[parent].children) {
+        if (strcmp(tree[c].name, name) == 0) return c;
+    }
+    tree.push_back(Node{name, parent});
+    tree[parent].children.push_back(tree.size() - 1);
+    return tree.size() - 1;
+}
+
+void Profiler::MergeInto(std::vector<Node> &dst, int dst_node, const std::vector<Node> &src, int src_node) {
+    dst[dst_node].num_calls += src[src_node].num_calls;
+    dst[dst_node].total_ms += src[src_node].total_ms;
+    for (int i = 0; i < NUM_COUNTERS; i++) dst[dst_node].counters[i] += src[src_node].counters[i];
+    dst[dst_node].peak_rss_kb = std::max(dst[dst_node].peak_rss_kb, src[src_node].peak_rss_kb);
+    for (int c : src[src_node].children) {
+        int d = FindChild(dst, dst_node, src[c].name);
+        MergeInto(dst, d, src, c);
+    }
+}
+
+std::vector<Profiler::Node> Profiler::Merge() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Node> merged = {Node{"", -1}};
+    MergeInto(merged, 0, retired, 0);
+    for (auto &tree : trees) MergeInto(merged, 0, tree->nodes, 0);
+    return merged;
+}
+
+double Profiler::GetTime(const std::string &path) {
+    auto merged = Merge();
+    int node = 0;
+    size_t pos = 0;
+    while (pos <= path.size()) {
+        size_t next = path.find('/', pos);
+        if (next == std::string::npos) next = path.size();
+        std::string name = path.substr(pos, next - pos);
+        int found = -1;
+        for (int c : merged[node].children) {
+            if (name == merged[c].name) found = c;
+        }
+        if (found == -1) return 0.0;
+        node = found;
+        pos = next + 1;
+    }
+    return merged[node].total_ms;
+}
+
+void Profiler::PrintNode(FILE *out, const std::vector<Node> &tree, int node, int depth) {
+    const Node &n = tree[node];
+    double children_ms = 0.0;
+    for (int c : n.children) children_ms += tree[c].total_ms;
+    fprintf(out, "%*s%-*s %10llu %12.3lf %12.3lf", 2 * depth, "", 36 - 2 * depth, n.name,
+            n.num_calls, n.total_ms, std::max(0.0, n.total_ms - children_ms));
+    if (hardware_counters) {
+        fprintf(out, " %14llu %12llu %12llu", (unsigned long long)n.counters[CYCLES],
+                (unsigned long long)n.counters[LLC_MISSES], (unsigned long long)n.counters[BRANCH_MISSES]);
+    }
+    if (memory_tracking) fprintf(out, " %12.1lf", n.peak_rss_kb / 1024.0);
+    fprintf(out, "\n");
+    for (int c : n.children) PrintNode(out, tree, c, depth + 1);
+}
+
+void Profiler::Report(FILE *out) {
+    auto merged = Merge();
+    fprintf(out, "[Profile] %-26s %10s %12s %12s", "Phase", "Calls", "Total(ms)", "Self(ms)");
+    if (hardware_counters) fprintf(out, " %14s %12s %12s", "Cycles", "LLC-misses", "Br-misses");
+    if (memory_tracking) fprintf(out, " %12s", "PeakRSS(MB)");
+    fprintf(out, "\n");
+    for (int c : merged[0].children) PrintNode(out, merged, c, 0);
+}
+
+void Profiler::Reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    retired = {Node{"", -1}};
+    for (auto &tree : trees) {
+        for (auto &node : tree->nodes) {
+            node.num_calls = 0;
+            node.total_ms = 0.0;
+            node.peak_rss_kb = 0;
+            for (auto &c : node.counters) c = 0;
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/**
+ * @brief Zipf distribution over {0, ..., n-1}: P(k) is proportional to 1 / (k+1)^exponent
+ * @details Rejection-inversion sampling (Hoermann and Derflinger, 1996): O(1) memory and expected O(1) time per
+ * sample for any n, so it can drive billion-element generators. exponent 0 gives the uniform distribution.
+ */
+class ZipfDistribution {
+    long long n;
+    double exponent;
+    double h_integral_x1, h_integral_n, s;
+    std::uniform_real_distribution<double> unif{0.0, 1.0};
+
+    // (exp(x) - 1) / x and log(1 + x) / x, accurate near 0
+    static double Expm1OverX(double x) { return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x / 2.0; }
+    static double Log1pOverX(double x) { return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x / 2.0; }
+    // h(x) = x^-exponent and its antiderivative H
+    double h(double x) const { return std::exp(-exponent * std::log(x)); }
+    double H(double x) const {
+        double log_x = std::log(x);
+        return Expm1OverX((1.0 - exponent) * log_x) * log_x;
+    }
+    double HInverse(double x) const {
+        double t = std::max(-1.0, x * (1.0 - exponent));
+        return std::exp(Log1pOverX(t) * x);
+    }
+public:
+    ZipfDistribution(long long n_, double exponent_) : n(std::max(1LL, n_)), exponent(exponent_) {
+        h_integral_x1 = H(1.5) - 1.0;
+        h_integral_n = H(n + 0.5);
+        s = 2.0 - HInverse(H(2.5) - h(2.0));
+    }
+
+    template <typename RNG>
+    long long operator()(RNG &rng) {
+        if (exponent == 0.0) return std::uniform_int_distribution<long long>(0, n - 1)(rng);
+        while (true) {
+            double u = h_integral_n + unif(rng) * (h_integral_x1 - h_integral_n);
+            double x = HInverse(u);
+            long long k = std::clamp((long long)(x + 0.5), 1LL, n);
+            if (k - x <= s or u >= H(k + 0.5) - h(k)) return k - 1;
+        }
+    }
+
+    long long size() const { return n; }
+};
+
+/**
+ * @brief SplitMix64: a tiny generator whose state is one word, for cheap independent streams (one per vertex,
+ * one per chunk) derived from a seed; satisfies UniformRandomBitGenerator
+ */
+class SplitMix64 {
+    uint64_t state;
+public:
+    using result_type = uint64_t;
+    explicit SplitMix64(uint64_t seed) : state(seed) {}
+    static constexpr uint64_t min() { return 0; }
+    static constexpr uint64_t max() { return ~0ULL; }
+    uint64_t operator()() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    /**
+     * @brief Seed of stream `stream` derived from `seed`
+     */
+    static uint64_t StreamSeed(uint64_t seed, uint64_t stream) {
+        SplitMix64 mix(seed ^ (stream * 0xD1B54A32D192ED03ULL));
+        return mix();
+    }
+};
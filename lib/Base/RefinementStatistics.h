@@ -0,0 +1,113 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Base/ResultTable.h"
+#include "Base/Timer.h"
+
+/**
+ * @brief Counters of one candidate refinement: removals per filtering rule, traffic of the refinement queue, and
+ * the candidates left after each round with the time the round ended.
+ * @details What a round is depends on the refinement: one popped query vertex for RefineCS, one generation of
+ * the queue (the entries pushed while the previous generation was processed) for RefineHCS.
+ */
+class RefinementStatistics {
+public:
+    struct Round {
+        // milliseconds since Start, and totals up to the end of this round
+        double elapsed_ms;
+        long long num_pops, num_removals;
+        // candidates left after this round
+        long long num_candidates;
+        // query vertex refined in this round and its priority when popped (RefineCS only, else -1)
+        int target = -1;
+        double priority = -1.0;
+    };
+    std::vector<std::string> rule_names;
+    std::vector<long long> removals;
+    long long queue_pushes = 0, queue_pops = 0;
+    long long initial_candidates = 0;
+    std::vector<Round> rounds;
+
+    RefinementStatistics() = default;
+    explicit RefinementStatistics(const std::vector<std::string> &rules) : rule_names(rules), removals(rules.size(), 0) {}
+
+    /**
+     * @brief Clear the counters and start the clock; rule i of Remove(i) is reported as rules[i]
+     */
+    void Start(const std::vector<std::string> &rules, long long num_candidates) {
+        *this = RefinementStatistics(rules);
+        initial_candidates = num_candidates;
+        timer.Start();
+    }
+
+    inline void Remove(int rule) { removals[rule]++; }
+    inline void Push() { queue_pushes++; }
+    inline void Pop() { queue_pops++; }
+
+    void EndRound(long long num_candidates, int target = -1, double priority = -1.0) {
+        rounds.push_back(Round{timer.Peek(), queue_pops, GetNumRemovals(), num_candidates, target, priority});
+    }
+
+    long long GetNumRemovals() const {
+        long long total = 0;
+        for (long long r : removals) total += r;
+        return total;
+    }
+
+    /**
+     * @brief Removals per rule and queue traffic; with level >= 1 also one line per round
+     */
+    void Print(FILE *out, const std::string &title, int level = 0) const {
+        fprintf(out, "\e[0;31m[Refinement] %s : %lld -> %lld candidates in %zu rounds, %.02lf ms\e[0m\n", title.c_str(),
+                initial_candidates, rounds.empty() ? initial_candidates : rounds.back().num_candidates,
+                rounds.size(), rounds.empty() ? 0.0 : rounds.back().elapsed_ms);
+        fprintf(out, "  queue pushes %lld, pops %lld\n", queue_pushes, queue_pops);
+        for (size_t i = 0; i < rule_names.size(); i++) {
+            fprintf(out, "  removed by %-24s %12lld\n", rule_names[i].c_str(), removals[i]);
+        }
+        if (level >= 1) {
+            for (int i = 0; i < (int)rounds.size(); i++) {
+                auto &r = rounds[i];
+                fprintf(out, "  round %4d at %10.3lf ms : pops %10lld removals %10lld candidates %10lld", i,
+                        r.elapsed_ms, r.num_pops, r.num_removals, r.num_candidates);
+                if (r.target >= 0) fprintf(out, " (u%d, priority %.4lf)", r.target, r.priority);
+                fputc('\n', out);
+            }
+        }
+    }
+
+    /**
+     * @brief Add the totals to the current row: <prefix>rounds, <prefix>pushes, <prefix>pops and
+     * <prefix>removed_<rule> for every rule
+     */
+    void WriteColumns(ResultTable &table, const std::string &prefix) const {
+        table.Set(prefix + "rounds", (long long)rounds.size());
+        table.Set(prefix + "pushes", queue_pushes);
+        table.Set(prefix + "pops", queue_pops);
+        for (size_t i = 0; i < rule_names.size(); i++) {
+            table.Set(prefix + "removed_" + rule_names[i], removals[i]);
+        }
+    }
+
+    /**
+     * @brief Write one row per round, each starting with the given key columns (e.g. dataset and query)
+     */
+    void WriteRounds(ResultTable &table, const std::vector<std::pair<std::string, std::string>> &keys) const {
+        for (int i = 0; i < (int)rounds.size(); i++) {
+            auto &r = rounds[i];
+            for (auto &[column, value] : keys) table.Set(column, value);
+            table.Set("round", i);
+            table.Set("elapsed_ms", r.elapsed_ms);
+            table.Set("pops", r.num_pops);
+            table.Set("removals", r.num_removals);
+            table.Set("candidates", r.num_candidates);
+            table.Set("target", r.target);
+            table.Set("priority", r.priority);
+            table.EndRow();
+        }
+    }
+
+private:
+    Timer timer;
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdio>
+#include <cstring>
+#include <sys/resource.h>
+
+/**
+ * @brief Value (in KB) of a field of /proc/self/status such as "VmHWM" or "VmRSS", -1 if unavailable
+ */
+inline long long ReadProcStatusKB(const char *field) {
+    FILE *fp = fopen("/proc/self/status", "r");
+    if (fp == nullptr) return -1;
+    char line[256];
+    long long value = -1;
+    size_t len = strlen(field);
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, field, len) == 0 and line[len] == ':') {
+            sscanf(line + len + 1, "%lld", &value);
+            break;
+        }
+    }
+    fclose(fp);
+    return value;
+}
+
+/**
+ * @brief Peak resident set size in KB since the start of the process, or since the last ResetPeakRSS
+ */
+inline long long GetPeakRSSKB() {
+    long long peak = ReadProcStatusKB("VmHWM");
+    if (peak >= 0) return peak;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+inline long long GetCurrentRSSKB() {
+    return ReadProcStatusKB("VmRSS");
+}
+
+/**
+ * @brief Reset the peak RSS to the current RSS (Linux >= 4.0), so that peaks can be measured per query
+ * @return false if the kernel does not support it; GetPeakRSSKB then keeps the process-wide peak
+ */
+inline bool ResetPeakRSS() {
+    FILE *fp = fopen("/proc/self/clear_refs", "w");
+    if (fp == nullptr) return false;
+    bool ok = fputs("5", fp) >= 0;
+    return (fclose(fp) == 0) and ok;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Rows of named values written as CSV, or as JSON lines when the file name ends with ".json".
+ * @details The columns of a CSV file are fixed by its first row; values of columns that first appear later are
+ * dropped (with a warning). The file name "-" writes to stdout.
+ */
+class ResultTable {
+    FILE *fp = nullptr;
+    bool json = false, header_written = false, warned = false;
+    std::vector<std::string> columns;
+    std::vector<std::pair<std::string, std::string>> row;
+
+    static std::string JsonString(const std::string &s) {
+        std::string quoted = "\"";
+        for (char c : s) {
+            if (c == '"' or c == '\\') quoted.push_back('\\');
+            quoted.push_back(c);
+        }
+        return quoted + "\"";
+    }
+    static std::string CsvField(const std::string &s) {
+        if (s.find_first_of(",\"\n") == std::string::npos) return s;
+        std::string quoted = "\"";
+        for (char c : s) {
+            if (c == '"') quoted.push_back('"');
+            quoted.push_back(c);
+        }
+        return quoted + "\"";
+    }
+public:
+    explicit ResultTable(const std::string &filename) {
+        json = filename.size() >= 5 and filename.compare(filename.size() - 5, 5, ".json") == 0;
+        fp = (filename == "-") ? stdout : fopen(filename.c_str(), "w");
+        if (fp == nullptr) {
+            fprintf(stderr, "ResultTable: cannot open %s\n", filename.c_str());
+            exit(1);
+        }
+    }
+    ~ResultTable() {
+        if (fp != nullptr and fp != stdout) fclose(fp);
+    }
+    ResultTable(const ResultTable &) = delete;
+    ResultTable &operator=(const ResultTable &) = delete;
+
+    void Set(const std::string &column, const std::string &value) {
+        row.emplace_back(column, json ? JsonString(value) : CsvField(value));
+    }
+    void Set(const std::string &column, const char *value) { Set(column, std::string(value)); }
+    void Set(const std::string &column, long long value) { row.emplace_back(column, std::to_string(value)); }
+    void Set(const std::string &column, unsigned long long value) { row.emplace_back(column, std::to_string(value)); }
+    void Set(const std::string &column, int value) { row.emplace_back(column, std::to_string(value)); }
+    void Set(const std::string &column, double value) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%.4lf", value);
+        row.emplace_back(column, buf);
+    }
+
+    /**
+     * @brief Write the values set since the last call as one row
+     */
+    void EndRow() {
+        if (json) {
+            fputc('{', fp);
+            for (size_t i = 0; i < row.size(); i++) {
+                fprintf(fp, "%s%s: %s", i ? ", " : "", JsonString(row[i].first).c_str(), row[i].second.c_str());
+            }
+            fputs("}\n", fp);
+        }
+        else {
+            if (!header_written) {
+                for (size_t i = 0; i < row.size(); i++) {
+                    columns.push_back(row[i].first);
+                    fprintf(fp, "%s%s", i ? "," : "", row[i].first.c_str());
+                }
+                fputc('\n', fp);
+                header_written = true;
+            }
+            std::vector<std::string> values(columns.size());
+            for (auto &[column, value] : row) {
+                size_t idx = 0;
+                while (idx < columns.size() and columns[idx] != column) idx++;
+                if (idx < columns.size()) values[idx] = value;
+                else if (!warned) {
+                    fprintf(stderr, "ResultTable: column %s is not in the CSV header, dropped\n", column.c_str());
+                    warned = true;
+                }
+            }
+            for (size_t i = 0; i < values.size(); i++) {
+                fprintf(fp, "%s%s", i ? "," : "", values[i].c_str());
+            }
+            fputc('\n', fp);
+        }
+        fflush(fp);
+        row.clear();
+    }
+};
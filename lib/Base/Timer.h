@@ -8,21 +8,27 @@ public:
     Timer() : time(0.0) {}
     ~Timer() {}
 
-    void Start() { s = std::chrono::high_resolution_clock::now(); }
+    void Start() { s = std::chrono::high_resolution_clock::now(); running = true; }
 
     void Stop() {
         e = std::chrono::high_resolution_clock::now();
         time += std::chrono::duration<double, std::milli>(e - s).count();
         s = std::chrono::high_resolution_clock::now();
+        running = false;
     }
 
     void Add(const Timer &other) { time += other.time; }
 
-    double Peek() { Stop(); return std::chrono::duration<double, std::milli>(e - s).count(); }
+    // accumulated time, including the running interval, without stopping the timer
+    double Peek() const {
+        if (!running) return time;
+        return time + std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - s).count();
+    }
     double GetTime() { return time; }
     double time;
 
 private:
     std::chrono::high_resolution_clock::time_point s, e;
+    bool running = false;
 };
 #endif
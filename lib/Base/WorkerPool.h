@@ -0,0 +1,83 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Base/Parallel.h"
+
+/**
+ * @brief Fixed set of threads running submitted tasks in submission order, for long-running services that
+ * answer independent requests (ParallelFor covers the data-parallel kernels).
+ * @details A task is called with the id of the thread running it, in [0, GetNumThreads()). The destructor
+ * runs the tasks still queued before joining the threads.
+ */
+class WorkerPool {
+    std::vector<std::thread> threads;
+    std::deque<std::function<void(int)>> tasks;
+    std::mutex mutex;
+    std::condition_variable task_ready, idle;
+    int num_running = 0;
+    bool stopping = false;
+
+    void Work(int thread_id);
+public:
+    explicit WorkerPool(int num_threads = num_worker_threads);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    void Submit(std::function<void(int)> task);
+    /**
+     * @brief Block until every submitted task has finished
+     */
+    void Wait();
+    int GetNumThreads() const { return threads.size(); }
+};
+
+WorkerPool::WorkerPool(int num_threads) {
+    for (int t = 0; t < std::max(1, num_threads); t++) threads.emplace_back(&WorkerPool::Work, this, t);
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    task_ready.notify_all();
+    for (auto &th : threads) th.join();
+}
+
+void WorkerPool::Work(int thread_id) {
+    while (true) {
+        std::function<void(int)> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            task_ready.wait(lock, [this] { return stopping or !tasks.empty(); });
+            if (tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            num_running++;
+        }
+        task(thread_id);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            num_running--;
+            if (num_running == 0 and tasks.empty()) idle.notify_all();
+        }
+    }
+}
+
+void WorkerPool::Submit(std::function<void(int)> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    task_ready.notify_one();
+}
+
+void WorkerPool::Wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return num_running == 0 and tasks.empty(); });
+}
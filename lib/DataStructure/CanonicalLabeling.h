@@ -0,0 +1,209 @@
+#pragma once
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+namespace GraphLib {
+    /**
+     * @brief Canonical labeling of a small vertex-colored undirected graph, by individualization-refinement
+     * @details The partition of the vertices by color is refined to an equitable one (the vertices of a cell
+     * have the same number of neighbors in every cell). While some cell has several vertices, each vertex of
+     * the first such cell is individualized in turn and the search recurses. Every leaf (a partition into
+     * singletons) orders the vertices; the code of the graph relabeled by the order of smallest code is the
+     * canonical code, so two graphs get the same code iff they are isomorphic. Two leaves of equal code give an
+     * automorphism, which prunes the children in the orbit of an explored child and the subtrees equivalent to
+     * an explored one (as in nauty). If the search is cut at max_leaves, the code still describes the graph
+     * exactly, but isomorphic graphs may get different codes.
+     */
+    class CanonicalLabeling {
+        int n = 0;
+        const std::vector<std::vector<int>> &adj;
+        std::vector<int> color_rank;
+        std::vector<int> palette;
+        // best and first leaves: their codes, vertex at each position, and individualized vertices
+        std::vector<int> best_code, first_code, best_order, first_order, best_path, first_path;
+        std::vector<int> path;
+        std::vector<std::vector<int>> automorphisms;
+        long long num_leaves = 0, max_leaves;
+        bool complete = true;
+        // depth at which the search resumes after a leaf equivalent to an explored one, -1 if none
+        int backjump = -1;
+
+        void Refine(std::vector<int> &cell) const;
+        void LeafCode(const std::vector<int> &cell, std::vector<int> &order, std::vector<int> &code) const;
+        void RecordAutomorphism(const std::vector<int> &from, const std::vector<int> &to);
+        // whether v is in the orbit of one of explored under the automorphisms that fix path pointwise
+        bool InExploredOrbit(int v, const std::vector<int> &explored) const;
+        void Search(std::vector<int> cell);
+    public:
+        /**
+         * @param colors color of each vertex, a tuple compared lexicographically
+         * @param adj_ neighbors of each vertex (symmetric; repeated neighbors are parallel edges)
+         */
+        CanonicalLabeling(const std::vector<std::vector<int>> &colors, const std::vector<std::vector<int>> &adj_,
+                          long long max_leaves_ = 100000);
+
+        /**
+         * @brief Canonical code: the colors, then the neighbors of each vertex, in canonical order
+         */
+        std::vector<int> GetCode() const;
+        /**
+         * @brief Canonical position of each vertex
+         */
+        std::vector<int> GetPosition() const;
+        bool IsComplete() const { return complete; }
+        long long GetNumLeaves() const { return num_leaves; }
+    };
+
+    CanonicalLabeling::CanonicalLabeling(const std::vector<std::vector<int>> &colors,
+                                         const std::vector<std::vector<int>> &adj_, long long max_leaves_)
+        : n(colors.size()), adj(adj_), max_leaves(max_leaves_) {
+        std::vector<int> by_color(n);
+        std::iota(by_color.begin(), by_color.end(), 0);
+        std::sort(by_color.begin(), by_color.end(), [&](int a, int b) { return colors[a] < colors[b]; });
+        color_rank.resize(n);
+        for (int i = 0, rank = -1; i < n; i++) {
+            if (i == 0 or colors[by_color[i]] != colors[by_color[i - 1]]) {
+                rank++;
+                auto &color = colors[by_color[i]];
+                palette.push_back(color.size());
+                palette.insert(palette.end(), color.begin(), color.end());
+            }
+            color_rank[by_color[i]] = rank;
+        }
+        if (n > 0) Search(color_rank);
+    }
+
+    void CanonicalLabeling::Refine(std::vector<int> &cell) const {
+        std::vector<std::vector<int>> key(n);
+        std::vector<int> order(n), refined(n);
+        int num_cells = -1;
+        while (true) {
+            for (int v = 0; v < n; v++) {
+                key[v].clear();
+                key[v].push_back(cell[v]);
+                for (int u : adj[v]) key[v].push_back(cell[u]);
+                std::sort(key[v].begin() + 1, key[v].end());
+            }
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](int a, int b) { return key[a] < key[b]; });
+            int rank = 0;
+            for (int i = 0; i < n; i++) {
+                if (i > 0 and key[order[i]] != key[order[i - 1]]) rank++;
+                refined[order[i]] = rank;
+            }
+            cell = refined;
+            if (rank + 1 == num_cells) break;
+            num_cells = rank + 1;
+        }
+    }
+
+    void CanonicalLabeling::LeafCode(const std::vector<int> &cell, std::vector<int> &order,
+                                     std::vector<int> &code) const {
+        order.assign(n, -1);
+        for (int v = 0; v < n; v++) order[cell[v]] = v;
+        code.clear();
+        for (int i = 0; i < n; i++) code.push_back(color_rank[order[i]]);
+        std::vector<int> nbrs;
+        for (int i = 0; i < n; i++) {
+            nbrs.clear();
+            for (int u : adj[order[i]]) nbrs.push_back(cell[u]);
+            std::sort(nbrs.begin(), nbrs.end());
+            code.push_back(nbrs.size());
+            code.insert(code.end(), nbrs.begin(), nbrs.end());
+        }
+    }
+
+    void CanonicalLabeling::RecordAutomorphism(const std::vector<int> &from, const std::vector<int> &to) {
+        std::vector<int> g(n);
+        for (int i = 0; i < n; i++) g[from[i]] = to[i];
+        automorphisms.push_back(g);
+    }
+
+    bool CanonicalLabeling::InExploredOrbit(int v, const std::vector<int> &explored) const {
+        if (explored.empty() or automorphisms.empty()) return false;
+        std::vector<int> parent(n);
+        std::iota(parent.begin(), parent.end(), 0);
+        auto Find = [&](int x) {
+            while (parent[x] != x) x = parent[x] = parent[parent[x]];
+            return x;
+        };
+        for (auto &g : automorphisms) {
+            bool fixes_path = std::all_of(path.begin(), path.end(), [&](int p) { return g[p] == p; });
+            if (!fixes_path) continue;
+            for (int x = 0; x < n; x++) parent[Find(x)] = Find(g[x]);
+        }
+        return std::any_of(explored.begin(), explored.end(), [&](int w) { return Find(w) == Find(v); });
+    }
+
+    void CanonicalLabeling::Search(std::vector<int> cell) {
+        Refine(cell);
+        std::vector<int> cell_size(n, 0);
+        for (int v = 0; v < n; v++) cell_size[cell[v]]++;
+        int target = 0;
+        while (target < n and cell_size[target] <= 1) target++;
+        if (target == n) {
+            num_leaves++;
+            std::vector<int> order, code;
+            LeafCode(cell, order, code);
+            auto Diverge = [&](const std::vector<int> &other) {
+                int depth = 0;
+                while (path[depth] == other[depth]) depth++;
+                return depth;
+            };
+            if (first_order.empty()) {
+                first_code = best_code = code;
+                first_order = best_order = order;
+                first_path = best_path = path;
+            }
+            else if (code == first_code) {
+                RecordAutomorphism(first_order, order);
+                backjump = Diverge(first_path);
+            }
+            else if (code == best_code) {
+                RecordAutomorphism(best_order, order);
+                backjump = Diverge(best_path);
+            }
+            else if (code < best_code) {
+                best_code = code;
+                best_order = order;
+                best_path = path;
+            }
+            return;
+        }
+        int depth = path.size();
+        std::vector<int> explored;
+        for (int v = 0; v < n; v++) {
+            if (cell[v] != target) continue;
+            if (num_leaves >= max_leaves) {
+                complete = false;
+                return;
+            }
+            if (InExploredOrbit(v, explored)) continue;
+            std::vector<int> child(n);
+            for (int x = 0; x < n; x++) child[x] = 2 * cell[x] + (cell[x] == target and x != v);
+            path.push_back(v);
+            Search(child);
+            path.pop_back();
+            explored.push_back(v);
+            if (backjump != -1) {
+                if (backjump < depth) return;
+                backjump = -1;
+            }
+            if (!complete) return;
+        }
+    }
+
+    std::vector<int> CanonicalLabeling::GetCode() const {
+        std::vector<int> code = {n, (int)palette.size()};
+        code.insert(code.end(), palette.begin(), palette.end());
+        code.insert(code.end(), best_code.begin(), best_code.end());
+        return code;
+    }
+
+    std::vector<int> CanonicalLabeling::GetPosition() const {
+        std::vector<int> position(n);
+        for (int i = 0; i < n; i++) position[best_order[i]] = i;
+        return position;
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+namespace GraphLib {
+    /**
+     * @brief Open-addressing (linear probing) hash table from a directed vertex pair (u, v) to an edge id.
+     * @details Used by Graph as a global edge index for high-degree vertices, where a binary search over
+     * the sorted neighbor range would take many cache misses.
+     */
+    class EdgeHashTable {
+        std::vector<uint64_t> keys;
+        std::vector<int> values;
+        uint64_t mask = 0;
+        size_t num_entries = 0;
+        static constexpr uint64_t EMPTY_KEY = ~0ULL;
+
+        static inline uint64_t Key(int u, int v) {
+            return ((uint64_t)(uint32_t)u << 32) | (uint32_t)v;
+        }
+
+        // splitmix64 finalizer
+        static inline uint64_t Hash(uint64_t x) {
+            x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+            x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+            x ^= x >> 31;
+            return x;
+        }
+    public:
+        /**
+         * @brief Clear the table and allocate room for max_entries entries at load factor <= 0.5
+         */
+        void Reserve(size_t max_entries) {
+            size_t capacity = 1;
+            while (capacity < 2 * max_entries) capacity <<= 1;
+            keys.assign(capacity, EMPTY_KEY);
+            values.assign(capacity, -1);
+            mask = capacity - 1;
+            num_entries = 0;
+        }
+
+        void Clear() {
+            keys.clear(); keys.shrink_to_fit();
+            values.clear(); values.shrink_to_fit();
+            mask = 0;
+            num_entries = 0;
+        }
+
+        inline bool Empty() const { return num_entries == 0; }
+        inline size_t Size() const { return num_entries; }
+        inline size_t GetMemoryUsage() const { return keys.capacity() * sizeof(uint64_t) + values.capacity() * sizeof(int); }
+
+        void Insert(int u, int v, int edge_id) {
+            uint64_t key = Key(u, v);
+            uint64_t pos = Hash(key) & mask;
+            while (keys[pos] != EMPTY_KEY and keys[pos] != key) pos = (pos + 1) & mask;
+            if (keys[pos] == EMPTY_KEY) num_entries++;
+            keys[pos] = key;
+            values[pos] = edge_id;
+        }
+
+        inline int Find(int u, int v) const {
+            if (keys.empty()) return -1;
+            uint64_t key = Key(u, v);
+            uint64_t pos = Hash(key) & mask;
+            while (keys[pos] != EMPTY_KEY) {
+                if (keys[pos] == key) return values[pos];
+                pos = (pos + 1) & mask;
+            }
+            return -1;
+        }
+    };
+}
@@ -1,18 +1,32 @@
 #pragma once
-#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <span>
+#include <tuple>
 #include <iostream>
 #include <fstream>
 #include "Base/Base.h"
+#include "Base/BinaryIO.h"
+#include "Base/MemoryReport.h"
+#include "Base/Parallel.h"
+#include "DataStructure/EdgeHashTable.h"
+#include "DataStructure/LocalMotifStore.h"
 
 namespace GraphLib {
     class Graph {
     protected:
-        // Adjacency List
-        std::vector<std::vector<int>> adj_list;
+        /**
+         * Adjacency in CSR form
+         * @attribute adj[adj_offset[v] .. adj_offset[v+1]) : neighbors of v, sorted by vertex id
+         * @attribute adj_edge_id : id of the edge to the neighbor at the same position of adj
+         */
+        std::vector<int> adj_offset, adj, adj_edge_id;
         std::vector<int> core_num, vertex_color;
         std::vector<int> degeneracy_order;
-        int num_vertex, num_edge, max_degree, degeneracy, num_color;
+        int num_vertex = 0, num_edge = 0, max_degree = 0, degeneracy = 0, num_color = 0;
         int num_vertex_labels = 0;
+        bool directed = false;
 
         /**
          * Basic data structures for graph
@@ -20,36 +34,82 @@ namespace GraphLib {
          * @attribute edge_list : list of edges as pair<int, int> form
          * @attribute incident_edges[v][l] : list of indices of incident edges from v and endpoint label l
          * @attribute all_incident_edges[v] : list of indices of all incident edges from v
-         * @attribute edge_index_map : Queryable as map[{u, v}].
+         * @attribute edge_hash : (u, v) -> edge id, only for sources of degree >= edge_hash_min_degree
          */
         std::vector<int> vertex_label, edge_label, edge_to;
         std::vector<std::pair<int, int>> edge_list;
         std::vector<std::vector<int>> all_incident_edges;
         std::vector<std::vector<std::vector<int>>> incident_edges;
-        std::vector<std::unordered_map<int, int>> edge_index_map;
+        EdgeHashTable edge_hash;
+        int edge_hash_min_degree = 256;
+
+        /**
+         * @brief Build the CSR adjacency (and max_degree) from edge_list
+         */
+        void BuildAdjacency();
+
+        /**
+         * @brief Build the global edge hash over vertices of degree >= edge_hash_min_degree
+         */
+        void BuildEdgeHash();
+
+        inline int FindOutgoingEdge(int u, int v) const {
+            if (GetDegree(u) >= edge_hash_min_degree and !edge_hash.Empty()) {
+                return edge_hash.Find(u, v);
+            }
+            auto first = adj.begin() + adj_offset[u], last = adj.begin() + adj_offset[u + 1];
+            auto it = std::lower_bound(first, last, v);
+            return (it == last or *it != v) ? -1 : adj_edge_id[it - adj.begin()];
+        }
 
         /*
          * Enumeration of Small Cycles for Cyclic Substructure Filter
-         * For each edge e, store local triangles and four-cycles
+         * For each edge e, store local triangles and four-cycles (see LocalMotifStore.h for the layout)
          */
-        struct FourMotif {
-            std::tuple<int, int, int, int> edges;
-            std::tuple<int, int> diags;
-            FourMotif(std::tuple<int, int, int, int> edges, std::tuple<int, int> diags) : edges(edges), diags(diags) {}
-        };
-        std::vector<std::vector<std::tuple<int, int, int>>> local_triangles;
-        std::vector<std::vector<FourMotif>> local_four_cycles;
+        LocalTriangleStore local_triangles;
+        LocalFourCycleStore local_four_cycles;
+        bool four_cycles_fully_enumerated = false;
+        // Full enumeration is skipped when sum of deg(u)*deg(v) over all edges exceeds this
+        double four_cycle_work_budget = 1e10;
+
+        /*
+         * Lazy mode: motifs of an edge are enumerated the first time they are requested and kept in a
+         * bounded LRU cache keyed like the stores, so the cache persists across queries on the same graph.
+         * Each thread reading motifs has its own caches.
+         */
+        bool lazy_local_motifs = false;
+        LazyMotifCaches lazy_caches;
+
+        LocalTriangleView GetLazyLocalTriangles(int edge_id);
+        LocalFourCycleView GetLazyLocalFourCycles(int edge_id);
+
+        /**
+         * @brief Binary snapshot of the graph and its preprocessed structures (see DataGraph::WriteSnapshot)
+         */
+        void WriteSnapshotBody(BinaryWriter &out, bool with_motifs) const;
+        void ReadSnapshotBody(MappedFileReader &in);
+
+        template <typename Emit>
+        void EnumerateLocalTrianglesAt(int edge_id, std::vector<int> &nbr_edge_id, Emit &&emit);
+
+        template <typename Emit>
+        void EnumerateLocalFourCyclesAt(int edge_id, std::vector<int> &u_edge_to, std::vector<int> &v_edge_to, Emit &&emit);
     public:
         Graph() {}
         ~Graph() {}
         Graph &operator=(const Graph &) = delete;
 
-        std::vector<int>& GetNeighbors(int v) {
-            return adj_list[v];
+        inline std::span<int> GetNeighbors(int v) {
+            return {adj.data() + adj_offset[v], adj.data() + adj_offset[v + 1]};
+        }
+
+        // Edge ids in the same order as GetNeighbors(v)
+        inline std::span<int> GetNeighborEdges(int v) {
+            return {adj_edge_id.data() + adj_offset[v], adj_edge_id.data() + adj_offset[v + 1]};
         }
 
         inline int GetDegree(int v) const {
-            return adj_list[v].size();
+            return adj_offset[v + 1] - adj_offset[v];
         }
 
         inline int GetNumVertices() const {
@@ -65,6 +125,10 @@ namespace GraphLib {
         }
 
         void ComputeCoreNum();
+        /**
+         * @brief Level-synchronous parallel peeling; exact core numbers, deterministic degeneracy_order.
+         */
+        void ComputeCoreNumParallel();
 
         inline int GetCoreNum(int v) const {
             return core_num[v];
@@ -72,7 +136,13 @@ namespace GraphLib {
 
         inline int GetDegeneracy() const {return degeneracy;}
 
+        inline const std::vector<int> &GetDegeneracyOrder() const {return degeneracy_order;}
+
         void AssignVertexColor();
+        /**
+         * @brief Parallel coloring with the same result as AssignVertexColor.
+         */
+        void AssignVertexColorParallel();
 
         inline int GetNumColors() const {return num_color;}
 
@@ -88,19 +158,63 @@ namespace GraphLib {
         inline int GetNumLabels() const {return num_vertex_labels;}
         inline int GetOppositeEdge(int edge_id) const {return edge_id^1;}
         inline int GetOppositePoint(int edge_id) const {return edge_to[edge_id];}
-        inline int GetEdgeIndex(int u, int v) {
-            auto it = edge_index_map[u].find(v);
-            return (it == edge_index_map[u].end() ? -1 : it->second);
+        /**
+         * @brief Index of the edge u->v, or -1 if there is none.
+         * @details For undirected graphs the lower-degree endpoint is searched, using the paired ids (e, e^1).
+         */
+        inline int GetEdgeIndex(int u, int v) const {
+            if (!directed and GetDegree(v) < GetDegree(u)) {
+                int e = FindOutgoingEdge(v, u);
+                return e == -1 ? -1 : (e ^ 1);
+            }
+            return FindOutgoingEdge(u, v);
         }
         inline std::pair<int, int>& GetEdge(int edge_id) {
             return edge_list[edge_id];
         }
 
-        inline std::vector<std::tuple<int, int, int>>& GetLocalTriangles(int edge_id) {return local_triangles[edge_id];}
-        inline std::vector<FourMotif>& GetLocalFourCycles(int edge_id) {return local_four_cycles[edge_id];}
+        /**
+         * @brief In lazy mode, the returned view is only valid until the next call for another edge.
+         */
+        inline LocalTriangleView GetLocalTriangles(int edge_id) {
+            if (lazy_local_motifs) return GetLazyLocalTriangles(edge_id);
+            return local_triangles.GetView(edge_id);
+        }
+        inline LocalFourCycleView GetLocalFourCycles(int edge_id) {
+            if (lazy_local_motifs) return GetLazyLocalFourCycles(edge_id);
+            return local_four_cycles.GetView(edge_id);
+        }
+
+        inline bool HasLocalFourCycles(int edge_id) const {return lazy_local_motifs or local_four_cycles.Covers(edge_id);}
+        inline bool LazyLocalMotifs() const {return lazy_local_motifs;}
+        /**
+         * @brief Switch to lazy motif computation, with cache_bytes for the triangle and four-cycle caches together
+         * (per thread that reads motifs).
+         * @details Replaces any eagerly enumerated motifs.
+         */
+        void EnableLazyLocalMotifs(size_t cache_bytes);
+        inline bool FourCyclesFullyEnumerated() const {return four_cycles_fully_enumerated;}
+        inline void SetFourCycleWorkBudget(double budget) {four_cycle_work_budget = budget;}
 
         void EnumerateLocalTriangles();
-        void EnumerateLocalFourCycles();
+        /**
+         * @brief Enumerate local four-cycles of every edge, unless the estimated work exceeds the budget.
+         * @return true if the enumeration was done
+         */
+        bool EnumerateLocalFourCycles();
+        /**
+         * @brief Enumerate local four-cycles only for the given edges into store; other edges are left
+         * unenumerated. The graph itself is not modified, so callers may keep per-query stores.
+         */
+        void EnumerateLocalFourCycles(const std::vector<int> &target_edges, LocalFourCycleStore &store);
+        /**
+         * @brief Print the number of stored local motifs and their memory, compared to per-edge tuple lists
+         */
+        void PrintLocalMotifStatistics();
+        /**
+         * @brief Add the bytes used by each structure of the graph, named prefix/structure
+         */
+        void ReportMemory(MemoryReport &report, const std::string &prefix = "Graph") const;
         void ChibaNishizeki();
 
         /**
@@ -114,6 +228,19 @@ namespace GraphLib {
         void WriteToFile(string filename);
     };
 
+    void Graph::ReportMemory(MemoryReport &report, const std::string &prefix) const {
+        report.Add(prefix + "/adjacency", MemoryBytes(adj_offset) + MemoryBytes(adj) + MemoryBytes(adj_edge_id));
+        report.Add(prefix + "/edge_list", MemoryBytes(edge_list) + MemoryBytes(edge_to));
+        report.Add(prefix + "/labels", MemoryBytes(vertex_label) + MemoryBytes(edge_label));
+        report.Add(prefix + "/core_color_order", MemoryBytes(core_num) + MemoryBytes(vertex_color) + MemoryBytes(degeneracy_order));
+        report.AddVector(prefix + "/all_incident_edges", all_incident_edges);
+        report.AddVector(prefix + "/incident_edges", incident_edges);
+        report.Add(prefix + "/edge_hash", edge_hash.GetMemoryUsage());
+        report.Add(prefix + "/local_triangles", local_triangles.GetMemoryUsage());
+        report.Add(prefix + "/local_four_cycles", local_four_cycles.GetMemoryUsage());
+        report.Add(prefix + "/motif_caches", lazy_caches.GetMemoryUsage());
+    }
+
     /**
      * @brief Compute the core number of each vertex
      * @date Oct 21, 2022
@@ -127,7 +254,7 @@ namespace GraphLib {
         std::fill(bin, bin + (GetMaxDegree() + 1), 0);
 
         for (int v = 0; v < GetNumVertices(); v++) {
-            core_num[v] = adj_list[v].size();
+            core_num[v] = GetDegree(v);
             bin[core_num[v]] += 1;
         }
 
@@ -195,20 +322,141 @@ namespace GraphLib {
     void Graph::AssignVertexColor() {
         vertex_color.resize(GetNumVertices(), -1);
         num_color = 0;
-        bool *used = new bool[GetNumVertices()];
+        bool *used = new bool[GetNumVertices() + 1]();
         for (int vertexID : degeneracy_order) {
-            for (int neighbor : adj_list[vertexID]) {
+            for (int neighbor : GetNeighbors(vertexID)) {
                 if (vertex_color[neighbor] == -1) continue;
                 used[vertex_color[neighbor]] = true;
             }
             int c = 0; while (used[c]) c++;
             vertex_color[vertexID] = c;
             num_color = std::max(num_color, c+1);
-            for (int neighbor : adj_list[vertexID]) {
+            for (int neighbor : GetNeighbors(vertexID)) {
                 if (vertex_color[neighbor] == -1) continue;
                 used[vertex_color[neighbor]] = false;
             }
         }
+        delete[] used;
+    }
+
+    /**
+     * @brief Parallel version of ComputeCoreNum.
+     * @details Peels levels k = 0, 1, ... : the frontier holds the remaining vertices of degree <= k, and
+     * removing a frontier vertex decrements its remaining neighbors atomically; a neighbor whose degree
+     * drops to k joins the next frontier of the same level. Each frontier is sorted by vertex id before it
+     * is appended to the peeling order, so the result does not depend on the number of threads.
+     * As in ComputeCoreNum, degeneracy_order is the reversed peeling order: every vertex has at most
+     * core_num[v] neighbors before it.
+     */
+    void Graph::ComputeCoreNumParallel() {
+        int n = GetNumVertices();
+        core_num.assign(n, 0);
+        std::vector<std::atomic<int>> deg(n);
+        std::vector<int> remaining;
+        remaining.reserve(n);
+        for (int v = 0; v < n; v++) {
+            deg[v].store(GetDegree(v), std::memory_order_relaxed);
+            remaining.push_back(v);
+        }
+        std::vector<int> peel_order;
+        peel_order.reserve(n);
+        std::vector<std::vector<int>> next_frontier(num_worker_threads);
+        std::vector<int> frontier;
+        int k = 0;
+        while (!remaining.empty()) {
+            int min_deg = INT_MAX;
+            for (int v : remaining) min_deg = std::min(min_deg, deg[v].load(std::memory_order_relaxed));
+            k = std::max(k, min_deg);
+            frontier.clear();
+            for (int v : remaining) {
+                if (deg[v].load(std::memory_order_relaxed) <= k) frontier.push_back(v);
+            }
+            while (!frontier.empty()) {
+                for (int v : frontier) {
+                    core_num[v] = k;
+                    peel_order.push_back(v);
+                    // mark as removed
+                    deg[v].store(-1, std::memory_order_relaxed);
+                }
+                ParallelFor(0, frontier.size(), [&](long long i, int thread_id) {
+                    for (int u : GetNeighbors(frontier[i])) {
+                        if (deg[u].load(std::memory_order_relaxed) <= k) continue;
+                        int before = deg[u].fetch_sub(1, std::memory_order_relaxed);
+                        if (before == k + 1) next_frontier[thread_id].push_back(u);
+                        else if (before <= k) deg[u].fetch_add(1, std::memory_order_relaxed);
+                    }
+                }, 256);
+                frontier.clear();
+                for (auto &buffer : next_frontier) {
+                    frontier.insert(frontier.end(), buffer.begin(), buffer.end());
+                    buffer.clear();
+                }
+                std::sort(frontier.begin(), frontier.end());
+            }
+            remaining.erase(std::remove_if(remaining.begin(), remaining.end(), [&](int v) {
+                return deg[v].load(std::memory_order_relaxed) < 0;
+            }), remaining.end());
+        }
+        degeneracy_order.assign(peel_order.rbegin(), peel_order.rend());
+        degeneracy = 0;
+        for (int i = 0; i < n; i++) {
+            degeneracy = std::max(core_num[i], degeneracy);
+        }
+    }
+
+    /**
+     * @brief Jones-Plassmann coloring with the degeneracy order as priority.
+     * @details A vertex is colored once all of its neighbors that come earlier in degeneracy_order are
+     * colored, so it picks exactly the color the serial greedy pass would; vertices of one round are
+     * pairwise non-adjacent and colored in parallel.
+     */
+    void Graph::AssignVertexColorParallel() {
+        int n = GetNumVertices();
+        std::vector<int> rank(n);
+        for (int i = 0; i < n; i++) rank[degeneracy_order[i]] = i;
+        std::vector<std::atomic<int>> num_waiting(n);
+        std::vector<int> frontier;
+        ParallelFor(0, n, [&](long long v, int) {
+            int cnt = 0;
+            for (int u : GetNeighbors(v)) cnt += (rank[u] < rank[v]);
+            num_waiting[v].store(cnt, std::memory_order_relaxed);
+        });
+        for (int v : degeneracy_order) {
+            if (num_waiting[v].load(std::memory_order_relaxed) == 0) frontier.push_back(v);
+        }
+        vertex_color.assign(n, -1);
+        std::vector<std::vector<char>> used(num_worker_threads);
+        std::vector<std::vector<int>> next_frontier(num_worker_threads);
+        std::vector<int> max_color(num_worker_threads, -1);
+        while (!frontier.empty()) {
+            ParallelFor(0, frontier.size(), [&](long long i, int thread_id) {
+                int v = frontier[i];
+                auto &mark = used[thread_id];
+                if (mark.empty()) mark.assign(GetMaxDegree() + 2, 0);
+                auto nbrs = GetNeighbors(v);
+                for (int u : nbrs) {
+                    if (rank[u] < rank[v] and (size_t)vertex_color[u] < mark.size()) mark[vertex_color[u]] = 1;
+                }
+                int c = 0;
+                while (mark[c]) c++;
+                vertex_color[v] = c;
+                max_color[thread_id] = std::max(max_color[thread_id], c);
+                for (int u : nbrs) {
+                    if (rank[u] < rank[v]) {
+                        if ((size_t)vertex_color[u] < mark.size()) mark[vertex_color[u]] = 0;
+                    }
+                    else if (num_waiting[u].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        next_frontier[thread_id].push_back(u);
+                    }
+                }
+            }, 256);
+            frontier.clear();
+            for (auto &buffer : next_frontier) {
+                frontier.insert(frontier.end(), buffer.begin(), buffer.end());
+                buffer.clear();
+            }
+        }
+        num_color = *std::max_element(max_color.begin(), max_color.end()) + 1;
     }
 
     void Graph::LoadLabeledGraph(const std::string &filename) {
@@ -220,7 +468,7 @@ namespace GraphLib {
         num_vertex = v;
         // add edges in both directions
         num_edge = e * 2;
-        adj_list.resize(num_vertex);
+        directed = false;
         vertex_label.resize(num_vertex);
         edge_label.resize(num_edge);
         int num_lines = 0;
@@ -243,17 +491,15 @@ namespace GraphLib {
                 int v1, v2;
                 v1 = std::stoi(tok.front()); tok.pop_front();
                 v2 = std::stoi(tok.front()); tok.pop_front();
-                adj_list[v1].push_back(v2);
-                adj_list[v2].push_back(v1);
                 edge_to.push_back(v2); edge_to.push_back(v1);
                 edge_list.push_back({v1, v2});
                 edge_list.push_back({v2, v1});
                 int el = tok.empty() ? 0 : std::stoi(tok.front());
                 edge_label[edge_list.size()-2] = edge_label[edge_list.size()-1] = el;
-                max_degree = std::max(max_degree, (int)std::max(adj_list[v1].size(), adj_list[v2].size()));
             }
             num_lines++;
         }
+        BuildAdjacency();
     }
 
     void Graph::LoadGraph(std::vector<int> &vertex_labels,
@@ -263,32 +509,77 @@ namespace GraphLib {
         num_vertex = vertex_labels.size();
         num_edge = edges.size();
         if (!directed) num_edge *= 2;
-        adj_list.resize(num_vertex);
+        this->directed = directed;
         vertex_label.resize(num_vertex);
         edge_label.resize(num_edge);
         for (int i = 0; i < num_vertex; i++) vertex_label[i] = vertex_labels[i];
-        for (int i = 0; i < edges.size(); i++) {
+        for (size_t i = 0; i < edges.size(); i++) {
             auto &[v1, v2] = edges[i];
             int el = (edge_labels.size() > i) ? edge_labels[i] : 0;
-            adj_list[v1].push_back(v2);
             edge_to.push_back(v2);
             edge_list.push_back({v1, v2});
             edge_label[edge_list.size()-1] = el;
 //            fprintf(stderr, "Edge %d %d\n", v1, v2);
             if (!directed) {
-                adj_list[v2].push_back(v1);
                 edge_to.push_back(v1);
                 edge_list.push_back({v2, v1});
                 edge_label[edge_list.size()-2] = edge_label[edge_list.size()-1] = el;
             }
         }
+        BuildAdjacency();
+    }
+
+    /**
+     * @brief Counting sort of edge_list by source, then sort each neighbor range by vertex id
+     */
+    void Graph::BuildAdjacency() {
+        adj_offset.assign(num_vertex + 1, 0);
+        for (auto &[u, v] : edge_list) adj_offset[u + 1]++;
+        for (int i = 0; i < num_vertex; i++) adj_offset[i + 1] += adj_offset[i];
+        adj.resize(edge_list.size());
+        adj_edge_id.resize(edge_list.size());
+        std::vector<int> fill_pos(adj_offset.begin(), adj_offset.end() - 1);
+        for (int edge_id = 0; edge_id < (int)edge_list.size(); edge_id++) {
+            int pos = fill_pos[edge_list[edge_id].first]++;
+            adj[pos] = edge_list[edge_id].second;
+            adj_edge_id[pos] = edge_id;
+        }
+        max_degree = 0;
+        std::vector<std::pair<int, int>> nbrs;
+        for (int v = 0; v < num_vertex; v++) {
+            max_degree = std::max(max_degree, GetDegree(v));
+            if (std::is_sorted(adj.begin() + adj_offset[v], adj.begin() + adj_offset[v + 1])) continue;
+            nbrs.clear();
+            for (int pos = adj_offset[v]; pos < adj_offset[v + 1]; pos++) {
+                nbrs.emplace_back(adj[pos], adj_edge_id[pos]);
+            }
+            std::sort(nbrs.begin(), nbrs.end());
+            for (int pos = adj_offset[v], i = 0; pos < adj_offset[v + 1]; pos++, i++) {
+                std::tie(adj[pos], adj_edge_id[pos]) = nbrs[i];
+            }
+        }
+    }
+
+    void Graph::BuildEdgeHash() {
+        edge_hash.Clear();
+        size_t num_hashed = 0;
+        for (int v = 0; v < num_vertex; v++) {
+            if (GetDegree(v) >= edge_hash_min_degree) num_hashed += GetDegree(v);
+        }
+        if (num_hashed == 0) return;
+        edge_hash.Reserve(num_hashed);
+        for (int v = 0; v < num_vertex; v++) {
+            if (GetDegree(v) < edge_hash_min_degree) continue;
+            for (int pos = adj_offset[v]; pos < adj_offset[v + 1]; pos++) {
+                edge_hash.Insert(v, adj[pos], adj_edge_id[pos]);
+            }
+        }
     }
 
 
     void Graph::BuildIncidenceList() {
         all_incident_edges.resize(num_vertex);
         incident_edges.resize(num_vertex);
-        edge_index_map.resize(num_vertex);
         for (int i = 0; i < GetNumVertices(); i++) {
             incident_edges[i].resize(GetNumLabels());
         }
@@ -296,9 +587,9 @@ namespace GraphLib {
         for (auto& [u, v] : edge_list) {
             all_incident_edges[u].push_back(edge_id);
             incident_edges[u][GetVertexLabel(v)].push_back(edge_id);
-            edge_index_map[u][v] = edge_id;
             edge_id++;
         }
+        BuildEdgeHash();
 
         // Sort edges by degree of endpoint
         for (int i = 0; i < GetNumVertices(); i++) {
@@ -306,15 +597,78 @@ namespace GraphLib {
                 std::sort(vec.begin(), vec.end(),[this](auto &a, auto &b) -> bool {
                     int opp_a = edge_list[a].second;
                     int opp_b = edge_list[b].second;
-                    return adj_list[opp_a].size() > adj_list[opp_b].size();
+                    return GetDegree(opp_a) > GetDegree(opp_b);
                 });
             }
             std::sort(all_incident_edges[i].begin(), all_incident_edges[i].end(), [this](auto &a, auto &b) -> bool {
-                return adj_list[edge_list[a].second].size() > adj_list[edge_list[b].second].size();
+                return GetDegree(edge_list[a].second) > GetDegree(edge_list[b].second);
             });
         }
     }
 
+    void Graph::WriteSnapshotBody(BinaryWriter &out, bool with_motifs) const {
+        for (int x : {num_vertex, num_edge, max_degree, degeneracy, num_color, num_vertex_labels,
+                      (int)directed, edge_hash_min_degree}) {
+            out.Write<int>(x);
+        }
+        for (auto *vec : {&adj_offset, &adj, &adj_edge_id, &core_num, &vertex_color, &degeneracy_order,
+                          &vertex_label, &edge_label, &edge_to}) {
+            out.WriteVector(*vec);
+        }
+        out.WriteVector(edge_list);
+        out.WriteNested(all_incident_edges);
+        // incident_edges[v][l] flattened over (v, l)
+        std::vector<uint64_t> offsets(1, 0);
+        std::vector<int> flat;
+        flat.reserve(edge_list.size());
+        for (auto &by_label : incident_edges) {
+            for (auto &vec : by_label) {
+                flat.insert(flat.end(), vec.begin(), vec.end());
+                offsets.push_back(flat.size());
+            }
+        }
+        out.WriteVector(offsets);
+        out.WriteVector(flat);
+
+        out.Write<int>(with_motifs);
+        if (with_motifs) {
+            local_triangles.WriteTo(out);
+            local_four_cycles.WriteTo(out);
+            out.Write<int>(four_cycles_fully_enumerated);
+        }
+    }
+
+    void Graph::ReadSnapshotBody(MappedFileReader &in) {
+        for (int *x : {&num_vertex, &num_edge, &max_degree, &degeneracy, &num_color, &num_vertex_labels}) {
+            *x = in.Read<int>();
+        }
+        directed = in.Read<int>();
+        edge_hash_min_degree = in.Read<int>();
+        for (auto *vec : {&adj_offset, &adj, &adj_edge_id, &core_num, &vertex_color, &degeneracy_order,
+                          &vertex_label, &edge_label, &edge_to}) {
+            in.ReadVector(*vec);
+        }
+        in.ReadVector(edge_list);
+        in.ReadNested(all_incident_edges);
+        std::vector<uint64_t> offsets;
+        std::vector<int> flat;
+        in.ReadVector(offsets);
+        in.ReadVector(flat);
+        incident_edges.assign(num_vertex, std::vector<std::vector<int>>(num_vertex_labels));
+        for (int v = 0, idx = 0; v < num_vertex; v++) {
+            for (int l = 0; l < num_vertex_labels; l++, idx++) {
+                incident_edges[v][l].assign(flat.begin() + offsets[idx], flat.begin() + offsets[idx + 1]);
+            }
+        }
+        BuildEdgeHash();
+
+        if (in.Read<int>()) {
+            local_triangles.ReadFrom(in);
+            local_four_cycles.ReadFrom(in);
+            four_cycles_fully_enumerated = in.Read<int>();
+        }
+    }
+
     void Graph::WriteToFile(std::string filename) {
         std::filesystem::path filepath = filename;
         std::filesystem::create_directories(filepath.parent_path());
@@ -52,6 +52,7 @@ namespace GraphLib {
         inline int GetInverseHyperedgeIndex(int i, int j) {return inverse_hyperedge_index[i][j];}
 
         void PrintStatistics(string name);
+        void ReportMemory(MemoryReport &report, const std::string &prefix = "HyperGraph") const;
 
     };
 
@@ -145,6 +146,14 @@ namespace GraphLib {
         return G;
     }
 
+    void HyperGraph::ReportMemory(MemoryReport &report, const std::string &prefix) const {
+        report.AddVector(prefix + "/hyperedges", hyperedges);
+        report.AddVector(prefix + "/incidence_list", incidence_list);
+        report.Add(prefix + "/labels", MemoryBytes(vertex_label) + MemoryBytes(hyperedge_label));
+        report.AddVector(prefix + "/hyperedge_signatures", hyperedge_signatures);
+        report.Add(prefix + "/inverse_index", MemoryBytes(inverse_vertex_index) + MemoryBytes(inverse_hyperedge_index));
+    }
+
     void HyperGraph::PrintStatistics(std::string name) {
 //        cout<<"\e\[0;32mProgram version: " << __head_version << "\e[0m"<<endl;
         fprintf(log_to,"\e\[0;31m[Statistics] %s \e[0m\n",name.c_str());
@@ -0,0 +1,395 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "Base/BinaryIO.h"
+#include "Base/Parallel.h"
+
+namespace GraphLib {
+    /**
+     * @brief Per-edge motif lists stored as CSR offsets plus packed structure-of-arrays columns.
+     * @details Motifs of key k occupy positions [offset[k], offset[k+1]) of every column.
+     * With symmetric storage (undirected graphs), key = edge_id >> 1: only the motifs of the even edge of
+     * each pair (e, e^1) are stored, and the view of the odd edge is derived from them on the fly.
+     */
+    template <int NUM_COLUMNS>
+    struct LocalMotifColumns {
+        bool symmetric = true;
+        std::vector<long long> offset;
+        std::array<std::vector<int>, NUM_COLUMNS> columns;
+        std::vector<bool> covered;
+
+        inline int Key(int edge_id) const { return symmetric ? (edge_id >> 1) : edge_id; }
+        inline bool Covers(int edge_id) const {
+            int key = Key(edge_id);
+            return key < (int)covered.size() and covered[key];
+        }
+        inline long long NumMotifs() const { return offset.empty() ? 0 : offset.back(); }
+
+        void Clear() {
+            offset.clear(); offset.shrink_to_fit();
+            for (auto &col : columns) { col.clear(); col.shrink_to_fit(); }
+            covered.clear(); covered.shrink_to_fit();
+        }
+
+        size_t GetMemoryUsage() const {
+            size_t bytes = offset.capacity() * sizeof(long long) + covered.capacity() / 8;
+            for (auto &col : columns) bytes += col.capacity() * sizeof(int);
+            return bytes;
+        }
+
+        void WriteTo(BinaryWriter &out) const {
+            out.Write<int>(symmetric);
+            out.WriteVector(offset);
+            for (auto &col : columns) out.WriteVector(col);
+            out.WriteVector(covered);
+        }
+
+        void ReadFrom(MappedFileReader &in) {
+            symmetric = in.Read<int>();
+            in.ReadVector(offset);
+            for (auto &col : columns) in.ReadVector(col);
+            in.ReadVector(covered);
+        }
+
+        /**
+         * @brief Build the motif lists of target_keys (distinct, ascending) in parallel.
+         * @param enumerate enumerate(key, thread_id, emit) calls emit(c_0, ..., c_{NUM_COLUMNS-1}) once per motif.
+         * @details Chunks of keys are enumerated into chunk-local columns, then copied into place.
+         */
+        template <typename Enumerate>
+        void Build(int num_keys, const std::vector<int> &target_keys, Enumerate &&enumerate) {
+            const int CHUNK_SIZE = 64;
+            struct Chunk {
+                std::array<std::vector<int>, NUM_COLUMNS> columns;
+                std::vector<long long> counts;
+            };
+            int num_chunks = (target_keys.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+            std::vector<Chunk> chunks(num_chunks);
+            ParallelFor(0, num_chunks, [&](long long c, int thread_id) {
+                auto &chunk = chunks[c];
+                int last = std::min((int)target_keys.size(), (int)(c + 1) * CHUNK_SIZE);
+                for (int idx = c * CHUNK_SIZE; idx < last; idx++) {
+                    size_t before = chunk.columns[0].size();
+                    enumerate(target_keys[idx], thread_id, [&](auto... values) {
+                        int col = 0;
+                        ((chunk.columns[col++].push_back(values)), ...);
+                    });
+                    chunk.counts.push_back(chunk.columns[0].size() - before);
+                }
+            }, 1);
+
+            offset.assign(num_keys + 1, 0);
+            covered.assign(num_keys, false);
+            for (int c = 0; c < num_chunks; c++) {
+                for (size_t j = 0; j < chunks[c].counts.size(); j++) {
+                    int key = target_keys[c * CHUNK_SIZE + j];
+                    offset[key + 1] = chunks[c].counts[j];
+                    covered[key] = true;
+                }
+            }
+            for (int k = 0; k < num_keys; k++) offset[k + 1] += offset[k];
+            for (auto &col : columns) {
+                col.clear();
+                col.resize(offset[num_keys]);
+                col.shrink_to_fit();
+            }
+            ParallelFor(0, num_chunks, [&](long long c, int) {
+                if (chunks[c].counts.empty()) return;
+                long long begin = offset[target_keys[c * CHUNK_SIZE]];
+                for (int col = 0; col < NUM_COLUMNS; col++) {
+                    std::copy(chunks[c].columns[col].begin(), chunks[c].columns[col].end(), columns[col].begin() + begin);
+                    std::vector<int>().swap(chunks[c].columns[col]);
+                }
+            }, 1);
+        }
+    };
+
+    /**
+     * @brief Triangles (u, v, w) of the edge u->v: FstEdge(j) = u->w, SndEdge(j) = v->w
+     */
+    struct LocalTriangleView {
+        const int *fst_edge = nullptr, *snd_edge = nullptr;
+        int num_motifs = 0;
+        inline int size() const { return num_motifs; }
+        inline bool empty() const { return num_motifs == 0; }
+        inline int FstEdge(int j) const { return fst_edge[j]; }
+        inline int SndEdge(int j) const { return snd_edge[j]; }
+
+        static inline LocalTriangleView FromColumns(std::array<const int *, 2> columns, int num_motifs, bool reverse) {
+            LocalTriangleView view;
+            view.num_motifs = num_motifs;
+            view.fst_edge = columns[reverse ? 1 : 0];
+            view.snd_edge = columns[reverse ? 0 : 1];
+            return view;
+        }
+    };
+
+    /**
+     * @brief Four-cycles u-v-x-y-u of the edge u->v: SndEdge = v->x, ThirdEdge = x->y, FourthEdge = y->u,
+     * FstDiag = u->x and SndDiag = v->y (-1 if missing).
+     * @details For the odd edge v->u of a symmetric store, the cycle is read backwards from the stored
+     * even edge: snd/fourth swap columns, all three cycle edges are reversed (^1) and the diagonals swap.
+     */
+    struct LocalFourCycleView {
+        const int *snd_edge = nullptr, *third_edge = nullptr, *fourth_edge = nullptr;
+        const int *fst_diag = nullptr, *snd_diag = nullptr;
+        int num_motifs = 0, reverse = 0;
+        inline int size() const { return num_motifs; }
+        inline bool empty() const { return num_motifs == 0; }
+        inline int SndEdge(int j) const { return snd_edge[j] ^ reverse; }
+        inline int ThirdEdge(int j) const { return third_edge[j] ^ reverse; }
+        inline int FourthEdge(int j) const { return fourth_edge[j] ^ reverse; }
+        inline int FstDiag(int j) const { return fst_diag[j]; }
+        inline int SndDiag(int j) const { return snd_diag[j]; }
+
+        static inline LocalFourCycleView FromColumns(std::array<const int *, 5> columns, int num_motifs, bool reverse) {
+            LocalFourCycleView view;
+            view.num_motifs = num_motifs;
+            view.reverse = reverse ? 1 : 0;
+            view.snd_edge = columns[reverse ? 2 : 0];
+            view.third_edge = columns[1];
+            view.fourth_edge = columns[reverse ? 0 : 2];
+            view.fst_diag = columns[reverse ? 4 : 3];
+            view.snd_diag = columns[reverse ? 3 : 4];
+            return view;
+        }
+    };
+
+    // columns: edge u->w, edge v->w
+    struct LocalTriangleStore : LocalMotifColumns<2> {
+        inline LocalTriangleView GetView(int edge_id) const {
+            int key = Key(edge_id);
+            long long begin = offset[key];
+            return LocalTriangleView::FromColumns({columns[0].data() + begin, columns[1].data() + begin},
+                                                  offset[key + 1] - begin, symmetric and (edge_id & 1));
+        }
+    };
+
+    // columns: edge v->x, edge x->y, edge y->u, diagonal u->x, diagonal v->y
+    struct LocalFourCycleStore : LocalMotifColumns<5> {
+        inline LocalFourCycleView GetView(int edge_id) const {
+            int key = Key(edge_id);
+            long long begin = offset[key];
+            std::array<const int *, 5> cols;
+            for (int c = 0; c < 5; c++) cols[c] = columns[c].data() + begin;
+            return LocalFourCycleView::FromColumns(cols, offset[key + 1] - begin, symmetric and (edge_id & 1));
+        }
+    };
+
+    /**
+     * @brief Bounded LRU cache of per-key motif lists, filled on demand.
+     * @details Each entry is one column-major block (NUM_COLUMNS x num_motifs). Pointers returned by Get
+     * stay valid until the next call to Get. Not thread-safe: LazyMotifCaches keeps one per thread.
+     */
+    template <int NUM_COLUMNS>
+    class LocalMotifCache {
+        struct Entry {
+            std::vector<int> block;
+            int num_motifs;
+            std::list<int>::iterator lru_position;
+        };
+        std::unordered_map<int, Entry> entries;
+        // most recently used key first
+        std::list<int> lru;
+        std::array<std::vector<int>, NUM_COLUMNS> staging;
+        size_t capacity_bytes = 0, used_bytes = 0;
+
+        static inline size_t EntryBytes(int num_motifs) {
+            // block + hash node + list node
+            return (size_t)NUM_COLUMNS * num_motifs * sizeof(int) + sizeof(Entry) + 64;
+        }
+    public:
+        unsigned long long num_hits = 0, num_misses = 0, num_evictions = 0;
+
+        void SetCapacity(size_t bytes) { capacity_bytes = bytes; }
+        inline size_t GetMemoryUsage() const { return used_bytes; }
+        inline size_t Size() const { return entries.size(); }
+
+        void Clear() {
+            entries.clear();
+            lru.clear();
+            used_bytes = 0;
+        }
+
+        /**
+         * @param enumerate enumerate(key, emit) calls emit(c_0, ..., c_{NUM_COLUMNS-1}) once per motif
+         * @return column-major block of the motifs of key; their number is written to num_motifs
+         */
+        template <typename Enumerate>
+        const int *Get(int key, int &num_motifs, Enumerate &&enumerate) {
+            auto it = entries.find(key);
+            if (it != entries.end()) {
+                num_hits++;
+                lru.splice(lru.begin(), lru, it->second.lru_position);
+                num_motifs = it->second.num_motifs;
+                return it->second.block.data();
+            }
+            num_misses++;
+            for (auto &col : staging) col.clear();
+            enumerate(key, [&](auto... values) {
+                int col = 0;
+                ((staging[col++].push_back(values)), ...);
+            });
+            num_motifs = staging[0].size();
+            lru.push_front(key);
+            Entry &entry = entries[key];
+            entry.num_motifs = num_motifs;
+            entry.lru_position = lru.begin();
+            entry.block.resize((size_t)NUM_COLUMNS * num_motifs);
+            for (int c = 0; c < NUM_COLUMNS; c++) {
+                std::copy(staging[c].begin(), staging[c].end(), entry.block.begin() + (size_t)c * num_motifs);
+            }
+            used_bytes += EntryBytes(num_motifs);
+            while (used_bytes > capacity_bytes and lru.size() > 1) {
+                auto victim = entries.find(lru.back());
+                used_bytes -= EntryBytes(victim->second.num_motifs);
+                entries.erase(victim);
+                lru.pop_back();
+                num_evictions++;
+            }
+            return entry.block.data();
+        }
+    };
+
+    /**
+     * @brief Lazy motif caches of one graph, one triangle and one four-cycle cache (with their scratch arrays)
+     * per thread that reads motifs, so that lookups from concurrent searches never share a cache.
+     * @details Each thread's caches get the full capacity. A thread keeps a pointer to the caches it used last,
+     * tagged with the generation of the store (unique across stores, bumped by Reset), so that Local takes no
+     * lock once they exist; the caches of a thread are dropped when it finishes. Copies start with no caches.
+     */
+    class LazyMotifCaches {
+    public:
+        struct ThreadCaches {
+            LocalMotifCache<2> triangles;
+            LocalMotifCache<5> four_cycles;
+            // scratch arrays of size |V| filled with -1, for the per-edge enumeration
+            std::vector<int> scratch[2];
+        };
+
+        LazyMotifCaches() : shared(std::make_shared<Shared>()) {}
+        LazyMotifCaches(const LazyMotifCaches &other) : LazyMotifCaches() {
+            std::lock_guard<std::mutex> lock(other.shared->mutex);
+            shared->capacity_bytes = other.shared->capacity_bytes;
+            shared->num_vertices = other.shared->num_vertices;
+        }
+        LazyMotifCaches &operator=(const LazyMotifCaches &other) {
+            if (this == &other) return *this;
+            size_t cache_bytes;
+            int num_vertices_;
+            {
+                std::lock_guard<std::mutex> lock(other.shared->mutex);
+                cache_bytes = other.shared->capacity_bytes;
+                num_vertices_ = other.shared->num_vertices;
+            }
+            Reset(cache_bytes, num_vertices_);
+            return *this;
+        }
+
+        /**
+         * @brief Drop every cache; later caches hold cache_bytes (a quarter for triangles) and scratch of size num_vertices
+         * @details Not concurrent with Local: the caches it returned are freed.
+         */
+        void Reset(size_t cache_bytes, int num_vertices_) {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            shared->caches.clear();
+            shared->capacity_bytes = cache_bytes;
+            shared->num_vertices = num_vertices_;
+            shared->generation.store(NextGeneration(), std::memory_order_release);
+        }
+
+        /**
+         * @brief Caches of the calling thread, created on its first call
+         */
+        ThreadCaches &Local() {
+            static thread_local unsigned long long last_generation = 0;
+            static thread_local ThreadCaches *last = nullptr;
+            unsigned long long generation = shared->generation.load(std::memory_order_acquire);
+            if (last_generation == generation) return *last;
+
+            // the slots of stores destroyed or reset since point to freed caches
+            auto &slots = Slots().slots;
+            std::erase_if(slots, [](const Slot &slot) {
+                auto owner = slot.shared.lock();
+                return owner == nullptr or owner->generation.load(std::memory_order_acquire) != slot.generation;
+            });
+            auto it = std::find_if(slots.begin(), slots.end(),
+                                   [&](const Slot &slot) { return slot.generation == generation; });
+            if (it == slots.end()) {
+                auto local = std::make_unique<ThreadCaches>();
+                std::lock_guard<std::mutex> lock(shared->mutex);
+                // four-cycle lists are typically much longer than triangle lists
+                local->triangles.SetCapacity(shared->capacity_bytes / 4);
+                local->four_cycles.SetCapacity(shared->capacity_bytes - shared->capacity_bytes / 4);
+                for (auto &scratch : local->scratch) scratch.assign(shared->num_vertices, -1);
+                slots.push_back({shared, generation, local.get()});
+                shared->caches.emplace(local.get(), std::move(local));
+                it = slots.end() - 1;
+            }
+            last_generation = generation;
+            last = it->caches;
+            return *last;
+        }
+
+        template <typename Visit>
+        void ForEach(Visit &&visit) const {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            for (auto &[ptr, local] : shared->caches) visit(*local);
+        }
+
+        size_t GetMemoryUsage() const {
+            size_t bytes = 0;
+            ForEach([&](const ThreadCaches &local) {
+                bytes += local.triangles.GetMemoryUsage() + local.four_cycles.GetMemoryUsage();
+            });
+            return bytes;
+        }
+
+    private:
+        // shared with the threads holding caches, which may outlive the store
+        struct Shared {
+            std::mutex mutex;
+            std::unordered_map<const ThreadCaches *, std::unique_ptr<ThreadCaches>> caches;
+            size_t capacity_bytes = 0;
+            int num_vertices = 0;
+            std::atomic<unsigned long long> generation = NextGeneration();
+        };
+        // caches created by a thread, under the generation of their store
+        struct Slot {
+            std::weak_ptr<Shared> shared;
+            unsigned long long generation;
+            ThreadCaches *caches;
+        };
+        // the slots of a thread, whose caches are dropped from their stores when it finishes
+        struct ThreadSlots {
+            std::vector<Slot> slots;
+            ~ThreadSlots() {
+                for (auto &slot : slots) {
+                    auto owner = slot.shared.lock();
+                    if (owner == nullptr) continue;
+                    std::lock_guard<std::mutex> lock(owner->mutex);
+                    if (owner->generation.load(std::memory_order_relaxed) == slot.generation) {
+                        owner->caches.erase(slot.caches);
+                    }
+                }
+            }
+        };
+
+        static unsigned long long NextGeneration() {
+            static std::atomic<unsigned long long> counter = 0;
+            return ++counter;
+        }
+        static ThreadSlots &Slots() {
+            static thread_local ThreadSlots slots;
+            return slots;
+        }
+
+        std::shared_ptr<Shared> shared;
+    };
+}
@@ -0,0 +1,248 @@
+#pragma once
+#include <span>
+#include "DataStructure/Graph.h"
+#include "Base/Parallel.h"
+
+namespace GraphLib {
+/**
+ * @brief Labeled k-clique counting and listing
+ * @details Every edge is oriented towards the endpoint that comes earlier in the degeneracy order, so each
+ * vertex has at most degeneracy out-neighbors. A clique is listed once, from its latest vertex v: the
+ * out-neighbors of v form a small induced subgraph whose adjacency is kept as bitsets, and the clique is
+ * grown inside it in decreasing local order. Branches are pruned by the required label multiset and by the
+ * vertex coloring (a clique needs pairwise distinct colors).
+ */
+    class CliqueEngine {
+        Graph *graph_;
+        // out-neighbors of v (earlier in the degeneracy order), sorted by rank
+        std::vector<int> out_offset, out_adj, rank;
+
+        struct Workspace {
+            int num_words = 0;
+            std::vector<int> local_vertex, local_slot, local_index;
+            // row i : local neighbors of i with smaller local index
+            std::vector<uint64_t> rows, label_bits;
+            // candidate set (restricted to needed labels) and child candidate set of each depth
+            std::vector<std::vector<uint64_t>> cand, child;
+            std::vector<int> need, clique, color_stamp;
+            int stamp = 0;
+        };
+        std::vector<Workspace> workspaces;
+        std::vector<int> label_slot;
+        int k = 0, num_slots = 0;
+
+        void Prepare(const std::vector<int> &labels);
+        bool EnoughColors(Workspace &ws, const uint64_t *bits, int num_words, int r);
+        template <bool LIST, typename Emit>
+        unsigned long long Extend(Workspace &ws, int depth, int r, const uint64_t *P, int num_words, Emit &emit, int thread_id);
+        template <bool LIST, typename Emit>
+        unsigned long long Run(const std::vector<int> &labels, Emit &&emit);
+    public:
+        /**
+         * @brief The graph must have its core numbers computed; vertex colors are assigned if missing.
+         */
+        explicit CliqueEngine(Graph *graph);
+
+        /**
+         * @brief Call emit(clique, thread_id) for every clique whose vertex labels form the multiset labels
+         * @return number of such cliques
+         */
+        template <typename Emit>
+        unsigned long long ListCliques(const std::vector<int> &labels, Emit &&emit) {
+            return Run<true>(labels, emit);
+        }
+
+        unsigned long long CountCliques(const std::vector<int> &labels) {
+            auto no_emit = [](std::span<const int>, int) {};
+            return Run<false>(labels, no_emit);
+        }
+
+        /**
+         * @brief Number of embeddings of a clique pattern with the given vertex labels: every data clique
+         * with the same label multiset is matched in prod(m_l!) ways, m_l being the multiplicity of label l.
+         */
+        unsigned long long CountEmbeddings(const std::vector<int> &labels) {
+            std::vector<int> sorted_labels(labels);
+            std::sort(sorted_labels.begin(), sorted_labels.end());
+            unsigned long long num_labelings = 1;
+            for (int i = 0, run = 0; i < (int)sorted_labels.size(); i++) {
+                run = (i > 0 and sorted_labels[i] == sorted_labels[i - 1]) ? run + 1 : 1;
+                num_labelings *= run;
+            }
+            return CountCliques(labels) * num_labelings;
+        }
+    };
+
+    CliqueEngine::CliqueEngine(Graph *graph) : graph_(graph) {
+        int n = graph_->GetNumVertices();
+        if (graph_->GetNumColors() == 0 and n > 0) {
+            if (num_worker_threads > 1) graph_->AssignVertexColorParallel();
+            else graph_->AssignVertexColor();
+        }
+        auto &order = graph_->GetDegeneracyOrder();
+        rank.resize(n);
+        for (int i = 0; i < n; i++) rank[order[i]] = i;
+        out_offset.assign(n + 1, 0);
+        for (int v = 0; v < n; v++) {
+            for (int u : graph_->GetNeighbors(v)) {
+                if (rank[u] < rank[v]) out_offset[v + 1]++;
+            }
+        }
+        for (int v = 0; v < n; v++) out_offset[v + 1] += out_offset[v];
+        out_adj.resize(out_offset[n]);
+        ParallelFor(0, n, [&](long long v, int) {
+            int pos = out_offset[v];
+            for (int u : graph_->GetNeighbors(v)) {
+                if (rank[u] < rank[v]) out_adj[pos++] = u;
+            }
+            std::sort(out_adj.begin() + out_offset[v], out_adj.begin() + out_offset[v + 1], [&](int a, int b) {
+                return rank[a] < rank[b];
+            });
+        }, 1024);
+    }
+
+    void CliqueEngine::Prepare(const std::vector<int> &labels) {
+        k = labels.size();
+        label_slot.assign(graph_->GetNumLabels() + 1, -1);
+        std::vector<int> need;
+        num_slots = 0;
+        for (int l : labels) {
+            if (l < 0 or l >= (int)label_slot.size()) continue;
+            if (label_slot[l] == -1) {
+                label_slot[l] = num_slots++;
+                need.push_back(0);
+            }
+            need[label_slot[l]]++;
+        }
+        workspaces.resize(num_worker_threads);
+        for (auto &ws : workspaces) {
+            ws.need = need;
+            ws.clique.assign(k, -1);
+            ws.cand.resize(k);
+            ws.child.resize(k);
+            if (ws.local_index.empty()) ws.local_index.assign(graph_->GetNumVertices(), -1);
+            ws.color_stamp.assign(graph_->GetNumColors() + 1, 0);
+            ws.stamp = 0;
+        }
+    }
+
+    bool CliqueEngine::EnoughColors(Workspace &ws, const uint64_t *bits, int num_words, int r) {
+        ws.stamp++;
+        int num_distinct = 0;
+        for (int w = 0; w < num_words; w++) {
+            for (uint64_t x = bits[w]; x; x &= x - 1) {
+                int c = graph_->GetVertexColor(ws.local_vertex[w * 64 + __builtin_ctzll(x)]);
+                if (ws.color_stamp[c] != ws.stamp) {
+                    ws.color_stamp[c] = ws.stamp;
+                    if (++num_distinct >= r) return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Count (and optionally list) the ways to add r more vertices from the local set P
+     */
+    template <bool LIST, typename Emit>
+    unsigned long long CliqueEngine::Extend(Workspace &ws, int depth, int r, const uint64_t *P, int num_words,
+                                            Emit &emit, int thread_id) {
+        auto &cand = ws.cand[depth];
+        cand.assign(num_words, 0);
+        int total = 0;
+        for (int s = 0; s < num_slots; s++) {
+            if (ws.need[s] == 0) continue;
+            const uint64_t *label_row = ws.label_bits.data() + (size_t)s * ws.num_words;
+            for (int w = 0; w < num_words; w++) cand[w] |= P[w] & label_row[w];
+        }
+        for (int w = 0; w < num_words; w++) total += __builtin_popcountll(cand[w]);
+        if (total < r) return 0;
+        if (r == 1) {
+            if constexpr (LIST) {
+                for (int w = 0; w < num_words; w++) {
+                    for (uint64_t x = cand[w]; x; x &= x - 1) {
+                        ws.clique[k - 1] = ws.local_vertex[w * 64 + __builtin_ctzll(x)];
+                        emit(std::span<const int>(ws.clique), thread_id);
+                    }
+                }
+            }
+            return total;
+        }
+        if (r >= 3 and !EnoughColors(ws, cand.data(), num_words, r)) return 0;
+        unsigned long long count = 0;
+        auto &child = ws.child[depth];
+        for (int w = num_words - 1; w >= 0; w--) {
+            for (uint64_t x = cand[w]; x; x &= x - 1) {
+                int i = w * 64 + __builtin_ctzll(x);
+                // fewer than r - 1 vertices below i
+                if (i < r - 1) continue;
+                int child_words = (i >> 6) + 1;
+                const uint64_t *row = ws.rows.data() + (size_t)i * ws.num_words;
+                child.resize(child_words);
+                for (int c = 0; c < child_words; c++) child[c] = cand[c] & row[c];
+                int slot = ws.local_slot[i];
+                ws.need[slot]--;
+                ws.clique[k - r] = ws.local_vertex[i];
+                count += Extend<LIST>(ws, depth + 1, r - 1, child.data(), child_words, emit, thread_id);
+                ws.need[slot]++;
+            }
+        }
+        return count;
+    }
+
+    template <bool LIST, typename Emit>
+    unsigned long long CliqueEngine::Run(const std::vector<int> &labels, Emit &&emit) {
+        Prepare(labels);
+        if (k == 0 or num_slots == 0) return 0;
+        std::vector<unsigned long long> thread_count(workspaces.size(), 0);
+        ParallelFor(0, graph_->GetNumVertices(), [&](long long v, int thread_id) {
+            auto &ws = workspaces[thread_id];
+            int v_label = graph_->GetVertexLabel(v);
+            int v_slot = (size_t)v_label < label_slot.size() ? label_slot[v_label] : -1;
+            if (v_slot == -1 or graph_->GetCoreNum(v) < k - 1) return;
+            if (out_offset[v + 1] - out_offset[v] < k - 1) return;
+            ws.clique[0] = v;
+            if (k == 1) {
+                if constexpr (LIST) emit(std::span<const int>(ws.clique), thread_id);
+                thread_count[thread_id]++;
+                return;
+            }
+            // local subgraph on the out-neighbors of v that may take part in the clique
+            ws.local_vertex.clear();
+            ws.local_slot.clear();
+            for (int pos = out_offset[v]; pos < out_offset[v + 1]; pos++) {
+                int u = out_adj[pos];
+                int u_label = graph_->GetVertexLabel(u);
+                int u_slot = (size_t)u_label < label_slot.size() ? label_slot[u_label] : -1;
+                if (u_slot == -1 or graph_->GetCoreNum(u) < k - 1) continue;
+                ws.local_index[u] = ws.local_vertex.size();
+                ws.local_vertex.push_back(u);
+                ws.local_slot.push_back(u_slot);
+            }
+            int num_local = ws.local_vertex.size();
+            if (num_local >= k - 1) {
+                ws.num_words = (num_local + 63) / 64;
+                ws.rows.assign((size_t)num_local * ws.num_words, 0);
+                ws.label_bits.assign((size_t)num_slots * ws.num_words, 0);
+                for (int i = 0; i < num_local; i++) {
+                    int u = ws.local_vertex[i];
+                    uint64_t *row = ws.rows.data() + (size_t)i * ws.num_words;
+                    for (int pos = out_offset[u]; pos < out_offset[u + 1]; pos++) {
+                        int j = ws.local_index[out_adj[pos]];
+                        if (j != -1) row[j >> 6] |= 1ULL << (j & 63);
+                    }
+                    ws.label_bits[(size_t)ws.local_slot[i] * ws.num_words + (i >> 6)] |= 1ULL << (i & 63);
+                }
+                std::vector<uint64_t> all(ws.num_words, ~0ULL);
+                if (num_local % 64) all.back() = (1ULL << (num_local % 64)) - 1;
+                ws.need[v_slot]--;
+                thread_count[thread_id] += Extend<LIST>(ws, 0, k - 1, all.data(), ws.num_words, emit, thread_id);
+                ws.need[v_slot]++;
+            }
+            for (int u : ws.local_vertex) ws.local_index[u] = -1;
+        }, 64);
+        unsigned long long total = 0;
+        for (auto c : thread_count) total += c;
+        return total;
+    }
+}
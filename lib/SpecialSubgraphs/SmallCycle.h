@@ -1,131 +1,237 @@
+#pragma once
 #include "DataStructure/Graph.h"
+#include "Base/Parallel.h"
 
 namespace GraphLib {
 /***
  * @brief Enumerate all small cycles
  */
-    void Graph::EnumerateLocalTriangles() {
-        local_triangles.resize(GetNumEdges());
-        int num_triangles = 0;
-        std::vector<int> nbr_edge_id(GetNumVertices(), -1);
-        for (int i = 0; i < GetNumEdges(); i++) {
-            auto &[u, v] = edge_list[i];
-            for (int &fst_edge : GetAllIncidentEdges(u)) {
-                nbr_edge_id[GetOppositePoint(fst_edge)] = fst_edge;
-            }
-            for (int &snd_edge : GetAllIncidentEdges(v)) {
-                int opp = GetOppositePoint(snd_edge);
-                if (nbr_edge_id[opp] != -1) {
-                    local_triangles[i].emplace_back(std::tuple(opp, nbr_edge_id[opp], snd_edge));
-                    num_triangles++;
-                }
-            }
-            for (int &fst_edge : GetAllIncidentEdges(u)) {
-                nbr_edge_id[GetOppositePoint(fst_edge)] = -1;
-            }
+    /**
+     * @brief Triangles (u, v, w) through the edge u->v, emitted as emit(w, edge u->w, edge v->w).
+     * @param nbr_edge_id scratch array of size |V| filled with -1
+     */
+    template <typename Emit>
+    void Graph::EnumerateLocalTrianglesAt(int edge_id, std::vector<int> &nbr_edge_id, Emit &&emit) {
+        auto &[u, v] = edge_list[edge_id];
+        auto u_nbrs = GetNeighbors(u), u_edges = GetNeighborEdges(u);
+        for (size_t j = 0; j < u_nbrs.size(); j++) {
+            nbr_edge_id[u_nbrs[j]] = u_edges[j];
         }
-    }
-
-
-    void Graph::EnumerateLocalFourCycles() {
-        Timer timer; timer.Start();
-        local_four_cycles.resize(GetNumEdges());
-        double total_required = 0, done = 0;
-        for (int i = 0; i < GetNumEdges(); i++) {
-            auto &[u, v] = edge_list[i];
-            total_required += GetDegree(u) * GetDegree(v);
+        auto v_nbrs = GetNeighbors(v), v_edges = GetNeighborEdges(v);
+        for (size_t j = 0; j < v_nbrs.size(); j++) {
+            int opp = v_nbrs[j];
+            if (nbr_edge_id[opp] != -1) {
+                emit(opp, nbr_edge_id[opp], v_edges[j]);
+            }
         }
-        if (total_required > 1e10) {
-            local_four_cycles.resize(0);
-            return;
+        for (int w : u_nbrs) {
+            nbr_edge_id[w] = -1;
         }
+    }
 
-        long long num_four_cycles = 0;
-        for (int i = 0; i < GetNumEdges(); i++) {
-            auto &[u, v] = edge_list[i];
-            if (GetDegree(u) < GetDegree(v)) {
-                for (int &fourth_edge_opp : GetAllIncidentEdges(u)) {
-                    int fourth_vertex = GetOppositePoint(fourth_edge_opp);
-                    if (fourth_vertex == v) continue;
-                    if (GetDegree(fourth_vertex) < GetDegree(v)) {
-                        for (int &third_edge_opp : GetAllIncidentEdges(fourth_vertex)) {
-                            int third_vertex = GetOppositePoint(third_edge_opp);
-                            if (third_vertex == u) continue;
-                            int snd_edge = GetEdgeIndex(v, third_vertex);
-                            if (snd_edge != -1) {
-                                int fourth_edge = fourth_edge_opp ^ 1;
-                                int third_edge = third_edge_opp ^ 1;
-                                int fst_diag = GetEdgeIndex(u, third_vertex);
-                                int snd_diag = GetEdgeIndex(v, fourth_vertex);
-                                local_four_cycles[i].emplace_back(FourMotif(
-                                        {i, snd_edge, third_edge, fourth_edge},
-                                        {fst_diag, snd_diag})
-                                );
-                                num_four_cycles++;
-                            }
+    /**
+     * @brief Four-cycles u-v-x-y-u through the edge u->v, emitted as
+     * emit(edge v->x, edge x->y, edge y->u, diagonal u->x, diagonal v->y) with -1 for missing diagonals.
+     * @details The neighborhoods of u and v are marked with their edge ids, so that closing edges and
+     * diagonals are found in O(1); only the closing edge towards a high-degree vertex needs GetEdgeIndex.
+     * @param u_edge_to, v_edge_to scratch arrays of size |V| filled with -1
+     */
+    template <typename Emit>
+    void Graph::EnumerateLocalFourCyclesAt(int edge_id, std::vector<int> &u_edge_to, std::vector<int> &v_edge_to, Emit &&emit) {
+        auto &[u, v] = edge_list[edge_id];
+        auto u_nbrs = GetNeighbors(u), u_edges = GetNeighborEdges(u);
+        auto v_nbrs = GetNeighbors(v), v_edges = GetNeighborEdges(v);
+        for (size_t j = 0; j < u_nbrs.size(); j++) u_edge_to[u_nbrs[j]] = u_edges[j];
+        for (size_t j = 0; j < v_nbrs.size(); j++) v_edge_to[v_nbrs[j]] = v_edges[j];
+        if (GetDegree(u) < GetDegree(v)) {
+            for (size_t j = 0; j < u_nbrs.size(); j++) {
+                int fourth_vertex = u_nbrs[j];
+                if (fourth_vertex == v) continue;
+                int fourth_edge = u_edges[j] ^ 1;
+                int snd_diag = v_edge_to[fourth_vertex];
+                if (GetDegree(fourth_vertex) < GetDegree(v)) {
+                    auto y_nbrs = GetNeighbors(fourth_vertex), y_edges = GetNeighborEdges(fourth_vertex);
+                    for (size_t k = 0; k < y_nbrs.size(); k++) {
+                        int third_vertex = y_nbrs[k];
+                        if (third_vertex == u) continue;
+                        int snd_edge = v_edge_to[third_vertex];
+                        if (snd_edge != -1) {
+                            emit(snd_edge, y_edges[k] ^ 1, fourth_edge, u_edge_to[third_vertex], snd_diag);
                         }
                     }
-                    else {
-                        for (int &snd_edge : GetAllIncidentEdges(v)) {
-                            int third_vertex = GetOppositePoint(snd_edge);
-                            if (third_vertex == u) continue;
-                            int third_edge = GetEdgeIndex(third_vertex, fourth_vertex);
-                            if (third_edge != -1) {
-                                int fourth_edge = fourth_edge_opp ^ 1;
-                                int fst_diag = GetEdgeIndex(u, third_vertex);
-                                int snd_diag = GetEdgeIndex(v, fourth_vertex);
-                                local_four_cycles[i].emplace_back(FourMotif(
-                                        {i, snd_edge, third_edge, fourth_edge},
-                                        {fst_diag, snd_diag})
-                                );
-                                num_four_cycles++;
-                            }
+                }
+                else {
+                    for (size_t k = 0; k < v_nbrs.size(); k++) {
+                        int third_vertex = v_nbrs[k];
+                        if (third_vertex == u) continue;
+                        int third_edge = GetEdgeIndex(third_vertex, fourth_vertex);
+                        if (third_edge != -1) {
+                            emit(v_edges[k], third_edge, fourth_edge, u_edge_to[third_vertex], snd_diag);
                         }
                     }
                 }
             }
-            else {
-                for (int &snd_edge : GetAllIncidentEdges(v)) {
-                    int third_vertex = GetOppositePoint(snd_edge);
-                    if (third_vertex == u) continue;
-                    if (GetDegree(third_vertex) < GetDegree(u)) {
-                        for (int &third_edge : GetAllIncidentEdges(third_vertex)) {
-                            int fourth_vertex = GetOppositePoint(third_edge);
-                            if (fourth_vertex == v) continue;
-                            int fourth_edge = GetEdgeIndex(fourth_vertex, u);
-                            if (fourth_edge != -1) {
-                                int fst_diag = GetEdgeIndex(u, third_vertex);
-                                int snd_diag = GetEdgeIndex(v, fourth_vertex);
-                                local_four_cycles[i].emplace_back(FourMotif(
-                                        {i, snd_edge, third_edge, fourth_edge},
-                                        {fst_diag, snd_diag})
-                                );
-                                num_four_cycles++;
-                            }
+        }
+        else {
+            for (size_t j = 0; j < v_nbrs.size(); j++) {
+                int third_vertex = v_nbrs[j];
+                if (third_vertex == u) continue;
+                int snd_edge = v_edges[j];
+                int fst_diag = u_edge_to[third_vertex];
+                if (GetDegree(third_vertex) < GetDegree(u)) {
+                    auto x_nbrs = GetNeighbors(third_vertex), x_edges = GetNeighborEdges(third_vertex);
+                    for (size_t k = 0; k < x_nbrs.size(); k++) {
+                        int fourth_vertex = x_nbrs[k];
+                        if (fourth_vertex == v) continue;
+                        int fourth_edge_opp = u_edge_to[fourth_vertex];
+                        if (fourth_edge_opp != -1) {
+                            emit(snd_edge, x_edges[k], fourth_edge_opp ^ 1, fst_diag, v_edge_to[fourth_vertex]);
                         }
                     }
-                    else {
-                        for (int &fourth_edge_opp : GetAllIncidentEdges(u)) {
-                            int fourth_vertex = GetOppositePoint(fourth_edge_opp);
-                            if (fourth_vertex == v) continue;
-                            int third_edge = GetEdgeIndex(third_vertex, fourth_vertex);
-                            if (third_edge != -1) {
-                                int fourth_edge = fourth_edge_opp ^ 1;
-                                int fst_diag = GetEdgeIndex(u, third_vertex);
-                                int snd_diag = GetEdgeIndex(v, fourth_vertex);
-                                local_four_cycles[i].emplace_back(FourMotif(
-                                        {i, snd_edge, third_edge, fourth_edge},
-                                        {fst_diag, snd_diag})
-                                );
-                                num_four_cycles++;
-                            }
+                }
+                else {
+                    for (size_t k = 0; k < u_nbrs.size(); k++) {
+                        int fourth_vertex = u_nbrs[k];
+                        if (fourth_vertex == v) continue;
+                        int third_edge = GetEdgeIndex(third_vertex, fourth_vertex);
+                        if (third_edge != -1) {
+                            emit(snd_edge, third_edge, u_edges[k] ^ 1, fst_diag, v_edge_to[fourth_vertex]);
                         }
                     }
                 }
             }
-            done += GetDegree(u) * GetDegree(v);
         }
-        timer.Stop();
+        for (int w : u_nbrs) u_edge_to[w] = -1;
+        for (int w : v_nbrs) v_edge_to[w] = -1;
+    }
+
+    /**
+     * @brief Parallel over edges; each thread owns a scratch array, and the per-chunk outputs are merged
+     * into the packed per-edge columns. Undirected graphs store only one edge of each pair (e, e^1).
+     */
+    void Graph::EnumerateLocalTriangles() {
+        PROFILE_SCOPE("EnumerateLocalTriangles");
+        local_triangles.symmetric = !directed;
+        int num_keys = local_triangles.symmetric ? GetNumEdges() / 2 : GetNumEdges();
+        std::vector<int> all_keys(num_keys);
+        for (int k = 0; k < num_keys; k++) all_keys[k] = k;
+        std::vector<std::vector<int>> nbr_edge_id(num_worker_threads);
+        local_triangles.Build(num_keys, all_keys, [&](int key, int thread_id, auto &&emit) {
+            auto &scratch = nbr_edge_id[thread_id];
+            if (scratch.empty()) scratch.resize(GetNumVertices(), -1);
+            int edge_id = local_triangles.symmetric ? 2 * key : key;
+            EnumerateLocalTrianglesAt(edge_id, scratch, [&](int, int fst_edge, int snd_edge) {
+                emit(fst_edge, snd_edge);
+            });
+        });
+    }
+
+    bool Graph::EnumerateLocalFourCycles() {
+        PROFILE_SCOPE("EnumerateLocalFourCycles");
+        double total_required = 0;
+        for (int i = 0; i < GetNumEdges(); i++) {
+            auto &[u, v] = edge_list[i];
+            total_required += 1.0 * GetDegree(u) * GetDegree(v);
+        }
+        if (total_required > four_cycle_work_budget) {
+            fprintf(log_to, "[FourCycle] Estimated work %.3e exceeds budget %.3e: "
+                            "four-cycles are enumerated only for candidate edges\n", total_required, four_cycle_work_budget);
+            local_four_cycles.Clear();
+            four_cycles_fully_enumerated = false;
+            return false;
+        }
+        std::vector<int> all_edges(GetNumEdges());
+        for (int i = 0; i < GetNumEdges(); i++) all_edges[i] = i;
+        EnumerateLocalFourCycles(all_edges, local_four_cycles);
+        four_cycles_fully_enumerated = true;
+        return true;
+    }
+
+    void Graph::EnumerateLocalFourCycles(const std::vector<int> &target_edges, LocalFourCycleStore &store) {
+        store.symmetric = !directed;
+        int num_keys = store.symmetric ? GetNumEdges() / 2 : GetNumEdges();
+        std::vector<int> target_keys;
+        target_keys.reserve(target_edges.size());
+        for (int e : target_edges) target_keys.push_back(store.Key(e));
+        std::sort(target_keys.begin(), target_keys.end());
+        target_keys.erase(std::unique(target_keys.begin(), target_keys.end()), target_keys.end());
+        std::vector<std::vector<int>> u_edge_to(num_worker_threads), v_edge_to(num_worker_threads);
+        store.Build(num_keys, target_keys, [&](int key, int thread_id, auto &&emit) {
+            if (u_edge_to[thread_id].empty()) {
+                u_edge_to[thread_id].resize(GetNumVertices(), -1);
+                v_edge_to[thread_id].resize(GetNumVertices(), -1);
+            }
+            int edge_id = store.symmetric ? 2 * key : key;
+            EnumerateLocalFourCyclesAt(edge_id, u_edge_to[thread_id], v_edge_to[thread_id], emit);
+        });
+    }
+
+    void Graph::EnableLazyLocalMotifs(size_t cache_bytes) {
+        lazy_local_motifs = true;
+        local_triangles.Clear();
+        local_four_cycles.Clear();
+        local_triangles.symmetric = local_four_cycles.symmetric = !directed;
+        four_cycles_fully_enumerated = false;
+        lazy_caches.Reset(cache_bytes, GetNumVertices());
+    }
+
+    LocalTriangleView Graph::GetLazyLocalTriangles(int edge_id) {
+        auto &local = lazy_caches.Local();
+        int key = local_triangles.Key(edge_id), num_motifs;
+        const int *block = local.triangles.Get(key, num_motifs, [&](int key, auto &&emit) {
+            int stored_edge = local_triangles.symmetric ? 2 * key : key;
+            EnumerateLocalTrianglesAt(stored_edge, local.scratch[0], [&](int, int fst_edge, int snd_edge) {
+                emit(fst_edge, snd_edge);
+            });
+        });
+        return LocalTriangleView::FromColumns({block, block + num_motifs}, num_motifs,
+                                              local_triangles.symmetric and (edge_id & 1));
+    }
+
+    LocalFourCycleView Graph::GetLazyLocalFourCycles(int edge_id) {
+        auto &local = lazy_caches.Local();
+        int key = local_four_cycles.Key(edge_id), num_motifs;
+        const int *block = local.four_cycles.Get(key, num_motifs, [&](int key, auto &&emit) {
+            int stored_edge = local_four_cycles.symmetric ? 2 * key : key;
+            EnumerateLocalFourCyclesAt(stored_edge, local.scratch[0], local.scratch[1], emit);
+        });
+        std::array<const int *, 5> cols;
+        for (int c = 0; c < 5; c++) cols[c] = block + (size_t)c * num_motifs;
+        return LocalFourCycleView::FromColumns(cols, num_motifs, local_four_cycles.symmetric and (edge_id & 1));
+    }
+
+    void Graph::PrintLocalMotifStatistics() {
+        if (lazy_local_motifs) {
+            // summed over the caches of every thread
+            size_t num_cached[2] = {0, 0}, bytes[2] = {0, 0};
+            unsigned long long hits[2] = {0, 0}, misses[2] = {0, 0}, evictions[2] = {0, 0};
+            lazy_caches.ForEach([&](const LazyMotifCaches::ThreadCaches &local) {
+                num_cached[0] += local.triangles.Size();
+                bytes[0] += local.triangles.GetMemoryUsage();
+                hits[0] += local.triangles.num_hits;
+                misses[0] += local.triangles.num_misses;
+                evictions[0] += local.triangles.num_evictions;
+                num_cached[1] += local.four_cycles.Size();
+                bytes[1] += local.four_cycles.GetMemoryUsage();
+                hits[1] += local.four_cycles.num_hits;
+                misses[1] += local.four_cycles.num_misses;
+                evictions[1] += local.four_cycles.num_evictions;
+            });
+            const char *names[2] = {"triangles", "four-cycles"};
+            for (int i = 0; i < 2; i++) {
+                fprintf(log_to, "[LocalMotif] Lazy %s: %zu edges cached, %.2lf MB, %llu hits / %llu misses / %llu evictions\n",
+                        names[i], num_cached[i], bytes[i] / 1048576.0, hits[i], misses[i], evictions[i]);
+            }
+            return;
+        }
+        // per-edge std::vector headers plus 12-byte tuples / 24-byte FourMotifs for both edge directions
+        int copies = directed ? 1 : 2;
+        double legacy_triangles = 24.0 * GetNumEdges() + 12.0 * copies * local_triangles.NumMotifs();
+        double legacy_four_cycles = 24.0 * GetNumEdges() + 24.0 * copies * local_four_cycles.NumMotifs();
+        fprintf(log_to, "[LocalMotif] Triangles: %lld stored, %.2lf MB (per-edge tuple lists: %.2lf MB)\n",
+                local_triangles.NumMotifs(), local_triangles.GetMemoryUsage() / 1048576.0, legacy_triangles / 1048576.0);
+        fprintf(log_to, "[LocalMotif] FourCycles: %lld stored, %.2lf MB (per-edge tuple lists: %.2lf MB)\n",
+                local_four_cycles.NumMotifs(), local_four_cycles.GetMemoryUsage() / 1048576.0, legacy_four_cycles / 1048576.0);
     }
 
     void Graph::ChibaNishizeki() {
@@ -0,0 +1,215 @@
+#pragma once
+#include <array>
+#include "DataStructure/Graph.h"
+#include "Base/BasicAlgorithms.h"
+#include "Base/Parallel.h"
+
+namespace GraphLib {
+/**
+ * @brief Direct embedding counts of labeled wedge, triangle and four-cycle patterns
+ * @details Vertices are ranked by (degree, id). Triangles are listed once from their two lowest-ranked
+ * vertices, by intersecting out-neighbor lists (towards higher rank) restricted to the missing label.
+ * Four-cycles are counted once from their highest-ranked vertex a: wedges a-b-c with b, c ranked below a
+ * are grouped by c and by the label of b, and every pair of middles closes a cycle.
+ * Counts are numbers of embeddings, i.e. label-preserving injective maps from the pattern.
+ */
+    class SmallPatternCounter {
+        Graph *graph_;
+        std::vector<int> rank;
+        // out-neighbors (higher rank) sorted by (label, id), with their labels
+        std::vector<long long> out_offset;
+        std::vector<int> out_adj, out_label;
+        // all neighbors sorted by rank
+        std::vector<long long> rank_offset;
+        std::vector<int> rank_adj;
+
+        inline std::pair<const int *, const int *> OutNeighborsWithLabel(int v, int l) const {
+            auto first = out_label.begin() + out_offset[v], last = out_label.begin() + out_offset[v + 1];
+            auto [lo, hi] = std::equal_range(first, last, l);
+            return {out_adj.data() + (lo - out_label.begin()), out_adj.data() + (hi - out_label.begin())};
+        }
+    public:
+        explicit SmallPatternCounter(Graph *graph);
+
+        /**
+         * @brief Paths end - center - end with the given labels
+         */
+        unsigned long long CountWedges(int end_label1, int center_label, int end_label2);
+
+        unsigned long long CountTriangles(const std::array<int, 3> &labels);
+
+        /**
+         * @param labels labels of the pattern vertices in cyclic order
+         */
+        unsigned long long CountFourCycles(const std::array<int, 4> &labels);
+    };
+
+    SmallPatternCounter::SmallPatternCounter(Graph *graph) : graph_(graph) {
+        int n = graph_->GetNumVertices();
+        std::vector<int> by_degree(n);
+        for (int v = 0; v < n; v++) by_degree[v] = v;
+        std::sort(by_degree.begin(), by_degree.end(), [this](int a, int b) {
+            return std::make_pair(graph_->GetDegree(a), a) < std::make_pair(graph_->GetDegree(b), b);
+        });
+        rank.resize(n);
+        for (int i = 0; i < n; i++) rank[by_degree[i]] = i;
+
+        out_offset.assign(n + 1, 0);
+        for (int v = 0; v < n; v++) {
+            for (int u : graph_->GetNeighbors(v)) {
+                if (rank[u] > rank[v]) out_offset[v + 1]++;
+            }
+        }
+        for (int v = 0; v < n; v++) out_offset[v + 1] += out_offset[v];
+        out_adj.resize(out_offset[n]);
+        out_label.resize(out_offset[n]);
+        rank_offset.assign(n + 1, 0);
+        for (int v = 0; v < n; v++) rank_offset[v + 1] = rank_offset[v] + graph_->GetDegree(v);
+        rank_adj.resize(rank_offset[n]);
+        ParallelFor(0, n, [&](long long v, int) {
+            std::vector<std::pair<int, int>> nbrs;
+            for (int u : graph_->GetNeighbors(v)) {
+                if (rank[u] > rank[v]) nbrs.emplace_back(graph_->GetVertexLabel(u), u);
+            }
+            std::sort(nbrs.begin(), nbrs.end());
+            for (size_t j = 0; j < nbrs.size(); j++) {
+                std::tie(out_label[out_offset[v] + j], out_adj[out_offset[v] + j]) = nbrs[j];
+            }
+            auto all_nbrs = graph_->GetNeighbors(v);
+            int *dst = rank_adj.data() + rank_offset[v];
+            std::copy(all_nbrs.begin(), all_nbrs.end(), dst);
+            std::sort(dst, dst + all_nbrs.size(), [this](int a, int b) { return rank[a] < rank[b]; });
+        }, 1024);
+    }
+
+    unsigned long long SmallPatternCounter::CountWedges(int end_label1, int center_label, int end_label2) {
+        std::vector<unsigned long long> thread_count(num_worker_threads, 0);
+        ParallelFor(0, graph_->GetNumVertices(), [&](long long v, int thread_id) {
+            if (graph_->GetVertexLabel(v) != center_label) return;
+            unsigned long long n1 = 0, n2 = 0;
+            for (int u : graph_->GetNeighbors(v)) {
+                int l = graph_->GetVertexLabel(u);
+                n1 += (l == end_label1);
+                n2 += (l == end_label2);
+            }
+            // ordered pairs of distinct end vertices
+            thread_count[thread_id] += (end_label1 == end_label2) ? n1 * (n1 - 1) : n1 * n2;
+        }, 1024);
+        unsigned long long total = 0;
+        for (auto c : thread_count) total += c;
+        return total;
+    }
+
+    unsigned long long SmallPatternCounter::CountTriangles(const std::array<int, 3> &labels) {
+        std::array<int, 3> sorted_labels = labels;
+        std::sort(sorted_labels.begin(), sorted_labels.end());
+        // label-preserving automorphisms of the pattern
+        unsigned long long num_automorphisms = 1;
+        if (sorted_labels[0] == sorted_labels[2]) num_automorphisms = 6;
+        else if (sorted_labels[0] == sorted_labels[1] or sorted_labels[1] == sorted_labels[2]) num_automorphisms = 2;
+
+        std::vector<unsigned long long> thread_count(num_worker_threads, 0);
+        ParallelFor(0, graph_->GetNumVertices(), [&](long long x, int thread_id) {
+            int lx = graph_->GetVertexLabel(x);
+            int pos_x = std::find(sorted_labels.begin(), sorted_labels.end(), lx) - sorted_labels.begin();
+            if (pos_x == 3) return;
+            std::array<int, 2> rest;
+            for (int i = 0, j = 0; i < 3; i++) if (i != pos_x) rest[j++] = sorted_labels[i];
+            unsigned long long count = 0;
+            for (long long pos = out_offset[x]; pos < out_offset[x + 1]; pos++) {
+                int y = out_adj[pos], ly = out_label[pos];
+                int missing;
+                if (ly == rest[0]) missing = rest[1];
+                else if (ly == rest[1]) missing = rest[0];
+                else continue;
+                auto [x_first, x_last] = OutNeighborsWithLabel(x, missing);
+                auto [y_first, y_last] = OutNeighborsWithLabel(y, missing);
+                count += SortedIntersectionCount(x_first, x_last - x_first, y_first, y_last - y_first);
+            }
+            thread_count[thread_id] += count;
+        }, 256);
+        unsigned long long total = 0;
+        for (auto c : thread_count) total += c;
+        return total * num_automorphisms;
+    }
+
+    unsigned long long SmallPatternCounter::CountFourCycles(const std::array<int, 4> &labels) {
+        // slots: distinct pattern labels
+        std::vector<int> slot_label;
+        for (int l : labels) {
+            if (std::find(slot_label.begin(), slot_label.end(), l) == slot_label.end()) slot_label.push_back(l);
+        }
+        int S = slot_label.size();
+        std::array<int, 4> q;
+        for (int i = 0; i < 4; i++) q[i] = std::find(slot_label.begin(), slot_label.end(), labels[i]) - slot_label.begin();
+        // maps[a][b][c][d] : number of dihedral maps sending the pattern onto a data cycle with slots a-b-c-d
+        std::vector<unsigned long long> maps(S * S * S * S, 0);
+        for (int code = 0; code < S * S * S * S; code++) {
+            std::array<int, 4> d = {code / (S * S * S), code / (S * S) % S, code / S % S, code % S};
+            for (int r = 0; r < 4; r++) {
+                bool rotation = true, reflection = true;
+                for (int i = 0; i < 4; i++) {
+                    rotation &= (d[(i + r) % 4] == q[i]);
+                    reflection &= (d[(r - i + 4) % 4] == q[i]);
+                }
+                maps[code] += rotation + reflection;
+            }
+        }
+        auto Slot = [&](int v) {
+            int l = graph_->GetVertexLabel(v);
+            for (int s = 0; s < S; s++) if (slot_label[s] == l) return s;
+            return -1;
+        };
+        int n = graph_->GetNumVertices();
+        std::vector<int> vertex_slot(n);
+        for (int v = 0; v < n; v++) vertex_slot[v] = Slot(v);
+
+        std::vector<unsigned long long> thread_count(num_worker_threads, 0);
+        // sparse accumulator per thread: the wedge counts of the end vertices c reached from the current a, one
+        // row of S counts per c in the order c is first reached; row_of[c] is the row of c (-1 if not reached)
+        std::vector<std::vector<unsigned int>> wedge_count(num_worker_threads);
+        std::vector<std::vector<int>> row_of(num_worker_threads), touched(num_worker_threads);
+        ParallelFor(0, n, [&](long long a, int thread_id) {
+            int sa = vertex_slot[a];
+            if (sa == -1) return;
+            auto &cnt = wedge_count[thread_id];
+            auto &row_idx = row_of[thread_id];
+            auto &seen = touched[thread_id];
+            if (row_idx.empty()) row_idx.assign(n, -1);
+            for (long long j = rank_offset[a]; j < rank_offset[a + 1] and rank[rank_adj[j]] < rank[a]; j++) {
+                int b = rank_adj[j], sb = vertex_slot[b];
+                if (sb == -1) continue;
+                for (long long k = rank_offset[b]; k < rank_offset[b + 1] and rank[rank_adj[k]] < rank[a]; k++) {
+                    int c = rank_adj[k];
+                    if (vertex_slot[c] == -1) continue;
+                    if (row_idx[c] == -1) {
+                        row_idx[c] = seen.size();
+                        seen.push_back(c);
+                        cnt.resize(cnt.size() + S, 0);
+                    }
+                    cnt[(size_t)row_idx[c] * S + sb]++;
+                }
+            }
+            unsigned long long count = 0;
+            for (int i = 0; i < (int)seen.size(); i++) {
+                int c = seen[i], sc = vertex_slot[c];
+                const unsigned int *row = cnt.data() + (size_t)i * S;
+                for (int s1 = 0; s1 < S; s1++) {
+                    if (row[s1] == 0) continue;
+                    unsigned long long m1 = row[s1];
+                    count += m1 * (m1 - 1) / 2 * maps[((sa * S + s1) * S + sc) * S + s1];
+                    for (int s2 = s1 + 1; s2 < S; s2++) {
+                        count += m1 * row[s2] * maps[((sa * S + s1) * S + sc) * S + s2];
+                    }
+                }
+                row_idx[c] = -1;
+            }
+            seen.clear();
+            cnt.clear();
+            thread_count[thread_id] += count;
+        }, 256);
+        unsigned long long total = 0;
+        for (auto c : thread_count) total += c;
+        return total;
+    }
+}
@@ -1,7 +1,11 @@
 #pragma once
+#include <chrono>
 #include <boost/dynamic_bitset.hpp>
+#include "Base/EmbeddingSink.h"
 #include "SubgraphMatching/BipartiteConstraint.h"
 #include "SubgraphMatching/CandidateSpace.h"
+#include "SpecialSubgraphs/Clique.h"
+#include "SpecialSubgraphs/SmallPattern.h"
 
 
 const int INVALID = -2;
@@ -22,6 +26,19 @@ namespace GraphLib {
     }
 
 namespace SubgraphMatching {
+    // how a search ended: complete, or stopped early with the counts of the part searched
+    enum SEARCH_STATUS {
+        SEARCH_COMPLETE,
+        SEARCH_MATCH_LIMIT,
+        SEARCH_NODE_LIMIT,
+        SEARCH_TIME_LIMIT,
+        SEARCH_CANCELLED,
+        SEARCH_STOPPED_BY_SINK
+    };
+    const std::vector<std::string> search_status_names = {
+        "ok", "match_limit", "node_limit", "time_limit", "cancelled", "stopped_by_sink"
+    };
+
     class BacktrackEngine {
     public:
         unsigned long long num_embeddings = 0, traversed_nodes = 0, pruned_nodes = 0;
@@ -30,6 +47,8 @@ namespace SubgraphMatching {
         DataGraph *data_;
         PatternGraph *query_;
         CandidateSpace *CS;
+        CliqueEngine *clique_engine = nullptr;
+        SmallPatternCounter *pattern_counter = nullptr;
         SubgraphMatchingOption opt_;
         int *seen, *isolated_vertex_candidates;
         std::vector<std::vector<std::vector<int>>> local_candidates;
@@ -37,6 +56,50 @@ namespace SubgraphMatching {
         int root = -1;
         std::vector<int> M;
         unsigned long long cnt = 0, conflicts = 0, dead_end = 0, bp_failure = 0;
+        // receives the embeddings if set; otherwise they are only counted
+        EmbeddingSink *sink = nullptr;
+        std::vector<int> embedding;
+        // factorized result being handed to the sink (see FactorizedEmbedding)
+        std::vector<int> free_vertices, group_offsets, candidate_offsets, free_candidates;
+        // set when the search stops early, for the reason in status
+        bool stopped = false;
+        SEARCH_STATUS status = SEARCH_COMPLETE;
+        // the limits other than max_num_matches are checked when traversed_nodes reaches next_limit_check
+        unsigned long long next_limit_check = 0;
+        std::chrono::steady_clock::time_point deadline;
+
+        void Stop(SEARCH_STATUS reason) {
+            if (stopped) return;
+            stopped = true;
+            status = reason;
+        }
+        /**
+         * @brief Check the node limit, the deadline and the cancel flag, and schedule the next check
+         * @return true if the search has to stop
+         */
+        bool CheckLimits() {
+            next_limit_check = traversed_nodes + std::max(opt_.limit_check_interval, 1);
+            if (opt_.max_search_nodes >= 0) {
+                if (traversed_nodes > (unsigned long long)opt_.max_search_nodes) Stop(SEARCH_NODE_LIMIT);
+                next_limit_check = std::min(next_limit_check, (unsigned long long)opt_.max_search_nodes + 1);
+            }
+            if (opt_.cancel != nullptr and opt_.cancel->load(std::memory_order_relaxed)) Stop(SEARCH_CANCELLED);
+            if (opt_.time_limit_ms >= 0 and std::chrono::steady_clock::now() >= deadline) Stop(SEARCH_TIME_LIMIT);
+            return stopped;
+        }
+        // whether a limit or a cancel flag may stop the search early
+        bool HasLimits() const {
+            return opt_.max_num_matches >= 0 or opt_.max_search_nodes >= 0 or opt_.time_limit_ms >= 0 or
+                   opt_.cancel != nullptr;
+        }
+        // count num_found more embeddings, up to max_num_matches
+        void AddEmbeddings(unsigned long long num_found) {
+            num_embeddings += num_found;
+            if (opt_.max_num_matches >= 0 and num_embeddings >= (unsigned long long)opt_.max_num_matches) {
+                num_embeddings = opt_.max_num_matches;
+                Stop(SEARCH_MATCH_LIMIT);
+            }
+        }
 
 
         void print_cands(std::vector<int> &v, int who) {
@@ -69,7 +132,7 @@ namespace SubgraphMatching {
         }
 
         bool PropagateExtendableVertex(int u, int v_idx, int print_idx=0) {
-            auto &q_nbrs = query_->GetNeighbors(u);
+            auto q_nbrs = query_->GetNeighbors(u);
             for (int i = 0; i < q_nbrs.size(); i++) {
                 int q_nbr = q_nbrs[i];
                 auto &cand_nbr = CS->GetCandidateNeighbors(u, v_idx, q_nbr);
@@ -117,8 +180,45 @@ namespace SubgraphMatching {
         UnionFind isolated_vertex_groups;
         std::vector <std::vector<int>> isolated_bipartite_graph;
         std::vector <int> bp_cand_idx, isolated_vertices, isolated_candidates;
-        long long bipartite_count_dp[1<<15][2];
+        // groups of isolated vertices up to this size are counted by the dp over subsets of the group
+        static const int MAX_COUNTED_GROUP = 15;
+        long long bipartite_count_dp[1<<MAX_COUNTED_GROUP][2];
         std::vector<int> distinct_candidates;
+        /**
+         * @brief Number of injective assignments of a group of isolated vertices too large for the dp
+         * @details Vertices with the same remaining candidates (e.g. leaves of one hyperedge sharing a label) are
+         * counted at once by a falling factorial; otherwise the assignments are counted one by one.
+         */
+        long long CountLargeGroup(int l, int r) {
+            std::vector<std::vector<int>> group_candidates(r - l + 1);
+            for (int i = l; i <= r; i++) {
+                int u = isolated_vertices[i];
+                for (int &uc : local_candidates[u][which_local_candidate[u]]) {
+                    int v = CS->GetCandidate(u, uc);
+                    if (seen[v] == -1) group_candidates[i - l].push_back(v);
+                }
+                std::sort(group_candidates[i - l].begin(), group_candidates[i - l].end());
+            }
+            if (std::all_of(group_candidates.begin(), group_candidates.end(),
+                            [&](auto &cands) { return cands == group_candidates[0]; })) {
+                long long count = 1;
+                for (int i = 0; i <= r - l; i++) count *= (long long)group_candidates[0].size() - i;
+                return std::max(count, 0LL);
+            }
+            std::vector<int> used;
+            std::function<long long(int)> Count = [&](int i) -> long long {
+                if (i == (int)group_candidates.size()) return 1;
+                long long count = 0;
+                for (int v : group_candidates[i]) {
+                    if (std::find(used.begin(), used.end(), v) != used.end()) continue;
+                    used.push_back(v);
+                    count += Count(i + 1);
+                    used.pop_back();
+                }
+                return count;
+            };
+            return Count(0);
+        }
         long long CountMaximumMatchings(int l, int r) {
             if (l + 1 == r) {
                 long long a, b, common;
@@ -145,6 +245,9 @@ namespace SubgraphMatching {
                 }
                 return (a - common) * b + common * (b - 1);
             }
+            else if (r - l + 1 > MAX_COUNTED_GROUP) {
+                return CountLargeGroup(l, r);
+            }
             else {
                 cnt++;
                 int num_distinct_candidates = 0;
@@ -308,16 +411,81 @@ namespace SubgraphMatching {
 //            return true;
 //        }
 
+        /**
+         * @brief Extend the current partial embedding over isolated_vertices[k..] one vertex at a time, handing
+         * every full embedding to the sink (MatchIsolatedVertices only counts them)
+         */
+        bool EnumerateIsolatedVertices(int k) {
+            if (k == (int)isolated_vertices.size()) {
+                for (int u = 0; u < query_->GetNumVertices(); u++) embedding[u] = CS->GetCandidate(u, M[u]);
+                AddEmbeddings(1);
+                if (!sink->Consume({embedding, {}})) Stop(SEARCH_STOPPED_BY_SINK);
+                return true;
+            }
+            bool found = false;
+            int u = isolated_vertices[k];
+            for (int v_idx : local_candidates[u][which_local_candidate[u]]) {
+                int v = CS->GetCandidate(u, v_idx);
+                if (seen[v] != -1) continue;
+                M[u] = v_idx;
+                seen[v] = u;
+                found |= EnumerateIsolatedVertices(k + 1);
+                seen[v] = -1;
+                M[u] = -1;
+                if (stopped) break;
+            }
+            return found;
+        }
+
+        /**
+         * @brief Hand the embeddings extending the current partial embedding to the sink at once, factorized over
+         * the groups of isolated vertices that MatchIsolatedVertices found (and counted: num_found)
+         */
+        void EmitFactorized(unsigned long long num_found) {
+            for (int u = 0; u < query_->GetNumVertices(); u++) {
+                embedding[u] = M[u] == -1 ? -1 : CS->GetCandidate(u, M[u]);
+            }
+            free_vertices.clear();
+            free_candidates.clear();
+            group_offsets.assign(1, 0);
+            candidate_offsets.assign(1, 0);
+            for (int i = 0; i < (int)isolated_vertices.size(); i++) {
+                int u = isolated_vertices[i];
+                if (i > 0 and isolated_vertex_groups.find(u) != isolated_vertex_groups.find(isolated_vertices[i - 1]))
+                    group_offsets.push_back(i);
+                free_vertices.push_back(u);
+                for (int v_idx : local_candidates[u][which_local_candidate[u]]) {
+                    int v = CS->GetCandidate(u, v_idx);
+                    if (seen[v] == -1) free_candidates.push_back(v);
+                }
+                candidate_offsets.push_back(free_candidates.size());
+            }
+            if (!isolated_vertices.empty()) group_offsets.push_back(isolated_vertices.size());
+            if (!sink->ConsumeFactorized({embedding, {}, free_vertices, group_offsets, candidate_offsets,
+                                          free_candidates, num_found}))
+                Stop(SEARCH_STOPPED_BY_SINK);
+        }
+
         bool FindEmbeddings(int idx) {
             traversed_nodes++;
             if (traversed_nodes % 5'000'000 == 0) {
                 fprintf(stderr, "Traversed nodes: %llu Embeddings: %llu\n", traversed_nodes, num_embeddings);
                 fflush(stderr);
             }
+            if (traversed_nodes >= next_limit_check and CheckLimits()) return false;
             int u = ChooseExtendableVertex(idx);
+            if (u == -1 and sink != nullptr and !sink->Factorized()) {
+                isolated_vertices.clear();
+                for (int i = 0; i < query_->GetNumVertices(); i++) {
+                    if (M[i] == -1 and which_local_candidate[i] + 1 == query_->GetDegree(i))
+                        isolated_vertices.push_back(i);
+                }
+                return EnumerateIsolatedVertices(0);
+            }
             if (u == -1) {
                 unsigned long long num_found = MatchIsolatedVertices();
-                num_embeddings += num_found;
+                if (num_found > 0 and sink != nullptr) EmitFactorized(num_found);
+                AddEmbeddings(num_found);
                 RevertIsolatedCandidates();
                 return (num_found > 0);
             }
@@ -339,6 +507,7 @@ namespace SubgraphMatching {
                 else dead_end++;
                 M[u] = -1;
                 seen[v] = -1;
+                if (stopped) break;
             }
             return found;
         }
@@ -369,26 +538,119 @@ namespace SubgraphMatching {
         };
         ~BacktrackEngine(){
             delete[] seen;
+            delete[] isolated_vertex_candidates;
+            delete GlobalBipartiteConstraint;
+            delete CS;
+            delete clique_engine;
+            delete pattern_counter;
         };
 
 
         void ResetOptions() {
-            if (!data_->FourCycleEnumerated()) {
+            // the backtracking reads GetCandidateNeighbors as candidate indices, which only the CS index provides
+            CS->opt.use_cs_index = true;
+            if (!data_->FourCycleEnumerated() and !opt_.restrict_motifs_to_candidates) {
                 CS->opt.structure_filter = std::min(opt_.structure_filter, TRIANGLE_SAFETY);
             }
-            CS->opt.use_cs_index = false;
         }
-        void Match(PatternGraph *query) {
+        /**
+         * @brief Count small cyclic patterns and cliques directly, without building the candidate space.
+         * The kernels (and their oriented adjacency) are kept across queries.
+         * @return false if the pattern has no direct kernel
+         */
+        bool MatchSpecialShape() {
+            auto shape = query_->ClassifyShape();
+            auto L = [this](int u) { return query_->GetVertexLabel(u); };
+            if (opt_.use_pattern_kernels and shape != GENERAL_PATTERN and shape != CLIQUE_PATTERN) {
+                if (pattern_counter == nullptr) pattern_counter = new SmallPatternCounter(data_);
+                if (shape == WEDGE_PATTERN) {
+                    int center = 0;
+                    while (query_->GetDegree(center) != 2) center++;
+                    int end1 = query_->GetNeighbors(center)[0], end2 = query_->GetNeighbors(center)[1];
+                    num_embeddings = pattern_counter->CountWedges(L(end1), L(center), L(end2));
+                }
+                else if (shape == TRIANGLE_PATTERN) {
+                    num_embeddings = pattern_counter->CountTriangles({L(0), L(1), L(2)});
+                }
+                else {
+                    auto cycle = query_->GetCycleOrder();
+                    num_embeddings = pattern_counter->CountFourCycles({L(cycle[0]), L(cycle[1]), L(cycle[2]), L(cycle[3])});
+                }
+                return true;
+            }
+            if (opt_.use_clique_engine and (shape == TRIANGLE_PATTERN or shape == CLIQUE_PATTERN)) {
+                if (clique_engine == nullptr) clique_engine = new CliqueEngine(data_);
+                std::vector<int> labels(query_->GetNumVertices());
+                for (int i = 0; i < query_->GetNumVertices(); i++) labels[i] = L(i);
+                num_embeddings = clique_engine->CountEmbeddings(labels);
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Count the embeddings of query, or hand each of them to sink_ as the data vertex matched to each
+         * query vertex (until sink_ asks to stop; num_embeddings then counts the embeddings handed over), then
+         * call sink_->Finish(). Without a sink, the count-only shortcuts (MatchSpecialShape without limits,
+         * counting the matchings of isolated vertices) apply; with one, every embedding is enumerated, except that a
+         * factorized sink receives the isolated vertices of each partial embedding as candidate lists.
+         * @details The search stops early at the limits of the options (max_num_matches, max_search_nodes,
+         * time_limit_ms, cancel), GetStatus telling which; num_embeddings then counts the embeddings found so far
+         * (at most max_num_matches; a factorized result is handed to the sink whole). The limits other than
+         * max_num_matches are checked every limit_check_interval search nodes, so a search overruns them by at
+         * most that many nodes. MatchSpecialShape, which cannot be interrupted, is skipped when any limit or a cancel
+         * flag is set; the counting of the matchings of isolated vertices is not interrupted. Each engine keeps its own counters and
+         * deadline, so engines on several threads can share one cancel flag.
+         */
+        void Match(PatternGraph *query, EmbeddingSink *sink_ = nullptr) {
+            sink = sink_;
+            stopped = false;
+            status = SEARCH_COMPLETE;
+            next_limit_check = 0;
+            if (opt_.time_limit_ms >= 0) {
+                deadline = std::chrono::steady_clock::now() +
+                           std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                               std::chrono::duration<double, std::milli>(opt_.time_limit_ms));
+            }
+            MatchQuery(query);
+            if (stopped) {
+                fprintf(stderr, "Search stopped (%s) after %llu nodes and %llu embeddings\n",
+                        search_status_names[status].c_str(), traversed_nodes, num_embeddings);
+            }
+            if (sink != nullptr) sink->Finish();
+            sink = nullptr;
+        }
+
+        bool IsStopped() const {
+            return stopped;
+        }
+
+        // SEARCH_COMPLETE unless the last search stopped early
+        SEARCH_STATUS GetStatus() const {
+            return status;
+        }
+
+    private:
+        void MatchQuery(PatternGraph *query) {
+            PROFILE_SCOPE("Match");
             ResetOptions();
             query_ = query;
             num_embeddings = traversed_nodes = pruned_nodes = bp_failure = dead_end = conflicts = 0;
-            memset(seen, -1, data_->GetNumVertices());
-            memset(isolated_vertex_candidates, -1, data_->GetNumVertices());
+            // the direct kernels cannot be interrupted: a search with limits backtracks
+            if (!HasLimits() and sink == nullptr and MatchSpecialShape()) {
+                return;
+            }
+            memset(seen, -1, sizeof(int) * data_->GetNumVertices());
+            memset(isolated_vertex_candidates, -1, sizeof(int) * data_->GetNumVertices());
             std::fill(which_local_candidate.begin(), which_local_candidate.end(), -1);
             isolated_vertex_groups = UnionFind(query_->GetNumVertices());
             M.resize(query_->GetNumVertices(), -1);
-            CS->BuildCS(query_);
+            embedding.resize(query_->GetNumVertices());
+            if (!CS->BuildCS(query_)) {
+                return;
+            }
             if (opt_.max_num_matches == 0) {
+                Stop(SEARCH_MATCH_LIMIT);
                 return;
             }
             std::vector <int> num_cands(query_->GetNumVertices());
@@ -396,7 +658,10 @@ namespace SubgraphMatching {
                 num_cands[i] = CS->GetCandidateSetSize(i);
             }
             root = std::min_element(num_cands.begin(), num_cands.end()) - num_cands.begin();
+            PROFILE_SCOPE("Backtrack");
             for (int i = 0; i < CS->GetCandidateSetSize(root); i++) {
+                // the roots whose propagation fails traverse no node: check the limits every interval of roots too
+                if (i % std::max(opt_.limit_check_interval, 1) == 0 and CheckLimits()) break;
                 int v = CS->GetCandidate(root, i);
                 M[root] = i;
                 seen[v] = root;
@@ -405,6 +670,7 @@ namespace SubgraphMatching {
                 ReleaseNeighbors(root);
                 seen[v] = -1;
                 M[root] = -1;
+                if (stopped) break;
             }
             printf("Total BP Count : %llu\n",cnt);
             printf("Dead end nodes : %llu\n",dead_end);
@@ -412,6 +678,12 @@ namespace SubgraphMatching {
             printf("BP-Failure : %llu\n",bp_failure);
         };
 
+    public:
+        void ReportMemory(MemoryReport &report) const {
+            CS->ReportMemory(report);
+            report.Add("Backtrack/local_candidates", MemoryBytes(local_candidates) + MemoryBytes(which_local_candidate));
+        }
+
         unsigned long long GetNumEmbeddings() {
             return num_embeddings;
         }
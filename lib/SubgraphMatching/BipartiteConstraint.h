@@ -35,6 +35,20 @@ namespace GraphLib::SubgraphMatching {
             }
             matched = false;
         }
+        ~BipartiteConstraint() {
+            for (int i = 0; i < left_size; i++) {
+                delete[] adj[i];
+                delete[] adj_index[i];
+            }
+            delete[] adj;
+            delete[] adj_size;
+            delete[] adj_index;
+            delete[] left;
+            delete[] right;
+            delete[] used;
+        }
+        BipartiteConstraint(const BipartiteConstraint &) = delete;
+        BipartiteConstraint &operator=(const BipartiteConstraint &) = delete;
 
         void Reset(int left_size_, int right_size_) {
             memset(left, -1, sizeof(int) * left_size);
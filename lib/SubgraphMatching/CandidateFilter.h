@@ -1,7 +1,9 @@
 #include "SubgraphMatching/CandidateSpace.h"
+#include "SpecialSubgraphs/SmallCycle.h"
 
 namespace GraphLib::SubgraphMatching {
     bool CandidateSpace::BuildInitialCS() {
+        PROFILE_SCOPE("BuildInitialCS");
         std::vector<int> initial_cs_size(query_->GetNumVertices(), 0);
         std::vector<std::vector<int>> built_neighbors(query_->GetNumVertices());
         int root = 0;
@@ -35,6 +37,8 @@ namespace GraphLib::SubgraphMatching {
                         if (num_visit_cs_[cand] < num_parent) continue;
                         if (data_->GetDegree(cand) < query_->GetDegree(cur)) break;
                         if (data_->GetCoreNum(cand) < query_->GetCoreNum(cur)) continue;
+                        if (opt.use_neighbor_label_signature and
+                            !data_->GetNeighborLabelSignature(cand).Covers(query_signature_[cur])) continue;
                         if (num_visit_cs_[cand] == num_parent) {
                             num_visit_cs_[cand] += 1;
                             if (num_visit_cs_[cand] == 1) {
@@ -59,7 +63,8 @@ namespace GraphLib::SubgraphMatching {
                 }
                 num_visit_cs_[cand] = 0;
             }
-            if (candidate_set_[cur].empty()) exit(2);
+            // some pattern vertex has no candidate: the pattern has no embedding
+            if (candidate_set_[cur].empty()) return false;
             for (int uc : query_->GetNeighbors(cur)) {
                 if (candidate_set_[uc].empty()) {
                     built_neighbors[uc].push_back(cur);
@@ -86,11 +91,37 @@ namespace GraphLib::SubgraphMatching {
         return true;
     }
 
+    /**
+     * @brief Enumerate data four-cycles only for the data edges that are candidates of a query edge
+     * lying on a query four-cycle. These are the only edges FourCycleSafety is asked about.
+     * @details The cycles go to this candidate space, not to the data graph, which engines may share.
+     */
+    void CandidateSpace::EnumerateCandidateFourCycles() {
+        std::vector<bool> is_target(data_->GetNumEdges(), false);
+        std::vector<int> target_edges;
+        for (int q_edge_idx = 0; q_edge_idx < query_->GetNumEdges(); q_edge_idx++) {
+            if (query_->GetLocalFourCycles(q_edge_idx).empty()) continue;
+            auto [u, uc] = query_->GetEdge(q_edge_idx);
+            int uc_label = query_->GetVertexLabel(uc);
+            for (int v : candidate_set_[u]) {
+                for (int d_edge_idx : data_->GetIncidentEdges(v, uc_label)) {
+                    if (BitsetEdgeCS[q_edge_idx][d_edge_idx] and !is_target[d_edge_idx]) {
+                        is_target[d_edge_idx] = true;
+                        target_edges.push_back(d_edge_idx);
+                    }
+                }
+            }
+        }
+        data_->EnumerateLocalFourCycles(target_edges, candidate_four_cycles_);
+    }
+
     bool CandidateSpace::InitRootCandidates(int root) {
         int root_label = query_->GetVertexLabel(root);
         for (int cand : data_->GetVerticesByLabel(root_label)) {
             if (data_->GetDegree(cand) < query_->GetDegree(root)) break;
             if (data_->GetCoreNum(cand) < query_->GetCoreNum(root)) continue;
+            if (opt.use_neighbor_label_signature and
+                !data_->GetNeighborLabelSignature(cand).Covers(query_signature_[root])) continue;
             candidate_set_[root].emplace_back(cand);
             BitsetCS[root][cand] = true;
         }
@@ -98,8 +129,17 @@ namespace GraphLib::SubgraphMatching {
     }
 
     bool CandidateSpace::RefineCS(){
+        PROFILE_SCOPE("RefineCS");
+        static const char *neighbor_filter_names[] = {"neighbor_safety", "neighbor_bipartite", "edge_bipartite"};
+        long long num_candidates = 0;
+        for (int i = 0; i < query_->GetNumVertices(); i++) num_candidates += candidate_set_[i].size();
+        refine_stats.Start({"structure", neighbor_filter_names[opt.neighborhood_filter]}, num_candidates);
         std::vector<int> local_stage(query_->GetNumVertices(), 0);
         std::vector<double> priority(query_->GetNumVertices(), 0.50);
+        // a vertex is in the queue while its priority is at least the cutoff
+        for (int i = 0; i < query_->GetNumVertices(); i++) {
+            if (priority[i] >= opt.priority_cutoff) refine_stats.Push();
+        }
         int queue_pop_count = 0;
         int current_stage = 0;
         while (true) {
@@ -119,6 +159,7 @@ namespace GraphLib::SubgraphMatching {
             if (priority[cur] < opt.priority_cutoff) break;
             current_stage++;
             queue_pop_count++;
+            refine_stats.Pop();
             int bef_cand_size = candidate_set_[cur].size();
             if (opt.neighborhood_filter == NEIGHBOR_SAFETY) {
                 std::fill(neighbor_label_frequency.begin(), neighbor_label_frequency.end(), 0);
@@ -130,8 +171,12 @@ namespace GraphLib::SubgraphMatching {
                 bool valid = true;
                 if (opt.structure_filter > NO_STRUCTURE_FILTER) {
                     valid = CheckSubStructures(cur, cand);
+                    if (!valid) refine_stats.Remove(STRUCTURE_RULE);
+                }
+                if (valid) {
+                    valid = NeighborFilter(cur, cand);
+                    if (!valid) refine_stats.Remove(NEIGHBOR_RULE);
                 }
-                if (valid) valid = NeighborFilter(cur, cand);
                 if (!valid) {
                     int removed = candidate_set_[cur][i];
                     for (int query_edge_idx : query_->GetAllIncidentEdges(cur)) {
@@ -153,9 +198,13 @@ namespace GraphLib::SubgraphMatching {
                 }
             }
             if (candidate_set_[cur].empty()) {
-                exit(2);
+                refine_stats.EndRound(num_candidates - bef_cand_size, cur, cur_priority);
+                refine_stats.Print(log_to, "RefineCS");
+                return false;
             }
             int aft_cand_size = candidate_set_[cur].size();
+            num_candidates -= bef_cand_size - aft_cand_size;
+            refine_stats.EndRound(num_candidates, cur, cur_priority);
             if (aft_cand_size == bef_cand_size) {
                 priority[cur] = 0;
                 continue;
@@ -164,12 +213,15 @@ namespace GraphLib::SubgraphMatching {
             priority[cur] = 0;
 //            fprintf(stdout, "Reduced CS[%d] from %d to %d\n",cur,bef_cand_size,aft_cand_size);
             for (int nxt : query_->GetNeighbors(cur)) {
-                priority[nxt] = 1 - (1 - out_prob) * (1 - priority[nxt]);
+                double raised = 1 - (1 - out_prob) * (1 - priority[nxt]);
+                if (priority[nxt] < opt.priority_cutoff and raised >= opt.priority_cutoff) refine_stats.Push();
+                priority[nxt] = raised;
                 local_stage[nxt] = current_stage;
 //                fprintf(stdout, "    Cur=[%d] pushes Nxt=[%d] with priority %lf\n",cur,nxt,priority[nxt]);
             }
 //            fflush(stdout);
         }
+        refine_stats.Print(log_to, "RefineCS");
         return true;
     }
 
@@ -211,39 +263,48 @@ namespace GraphLib::SubgraphMatching {
     }
 
     inline bool CandidateSpace::TriangleSafety(int query_edge_id, int data_edge_id) {
-        auto &query_triangles = query_->GetLocalTriangles(query_edge_id);
+        auto query_triangles = query_->GetLocalTriangles(query_edge_id);
         if (query_triangles.empty()) return true;
-        auto &candidate_triangles = data_->GetLocalTriangles(data_edge_id);
+        auto candidate_triangles = data_->GetLocalTriangles(data_edge_id);
         if (query_triangles.size() > candidate_triangles.size()) return false;
-        for (auto qtv: query_triangles) {
-            bool found = std::any_of(candidate_triangles.begin(),
-                                     candidate_triangles.end(),
-                                     [&](auto tv) {
-                                         return BitsetEdgeCS[get<1>(qtv)][get<1>(tv)] and  BitsetEdgeCS[get<2>(qtv)][get<2>(tv)];
-                                     });
+        for (int i = 0; i < query_triangles.size(); i++) {
+            bool *fst_cs = BitsetEdgeCS[query_triangles.FstEdge(i)];
+            bool *snd_cs = BitsetEdgeCS[query_triangles.SndEdge(i)];
+            bool found = false;
+            for (int j = 0; j < candidate_triangles.size(); j++) {
+                if (fst_cs[candidate_triangles.FstEdge(j)] and snd_cs[candidate_triangles.SndEdge(j)]) {
+                    found = true;
+                    break;
+                }
+            }
             if (!found) return false;
         }
         return true;
     };
 
     bool CandidateSpace::FourCycleSafety(int query_edge_id, int data_edge_id) {
-        auto &query_cycles = query_->GetLocalFourCycles(query_edge_id);
-        auto &data_cycles = data_->GetLocalFourCycles(data_edge_id);
+        bool from_data = data_->FourCycleEnumerated();
+        if (from_data ? !data_->HasLocalFourCycles(data_edge_id) : !candidate_four_cycles_.Covers(data_edge_id))
+            return true;
+        auto query_cycles = query_->GetLocalFourCycles(query_edge_id);
+        auto data_cycles = from_data ? data_->GetLocalFourCycles(data_edge_id)
+                                     : candidate_four_cycles_.GetView(data_edge_id);
         if (query_cycles.size() > data_cycles.size()) return false;
         for (int i = 0; i < query_cycles.size(); i++) {
-            auto &q_info = query_cycles[i];
+            bool *snd_cs = BitsetEdgeCS[query_cycles.SndEdge(i)];
+            bool *third_cs = BitsetEdgeCS[query_cycles.ThirdEdge(i)];
+            bool *fourth_cs = BitsetEdgeCS[query_cycles.FourthEdge(i)];
+            int q_fst_diag = query_cycles.FstDiag(i), q_snd_diag = query_cycles.SndDiag(i);
             for (int j = 0; j < data_cycles.size(); j++) {
-                auto &d_info =  data_cycles[j];
-                bool validity = true;
-                validity &= BitsetEdgeCS[get<1>(q_info.edges)][get<1>(d_info.edges)];
+                bool validity = snd_cs[data_cycles.SndEdge(j)];
                 if (!validity) continue;
-                validity &= BitsetEdgeCS[get<2>(q_info.edges)][get<2>(d_info.edges)];
+                validity &= third_cs[data_cycles.ThirdEdge(j)];
                 if (!validity) continue;
-                validity &= BitsetEdgeCS[get<3>(q_info.edges)][get<3>(d_info.edges)];
-                if (validity and get<0>(q_info.diags) != -1)
-                    validity &= EdgeCandidacy(get<0>(q_info.diags),get<0>(d_info.diags));
-                if (validity and get<1>(q_info.diags) != -1)
-                    validity &= EdgeCandidacy(get<1>(q_info.diags), get<1>(d_info.diags));
+                validity &= fourth_cs[data_cycles.FourthEdge(j)];
+                if (validity and q_fst_diag != -1)
+                    validity &= EdgeCandidacy(q_fst_diag, data_cycles.FstDiag(j));
+                if (validity and q_snd_diag != -1)
+                    validity &= EdgeCandidacy(q_snd_diag, data_cycles.SndDiag(j));
                 if (validity) {
                     goto nxt_cycle;
                 }
@@ -1,9 +1,11 @@
 #pragma once
+#include <atomic>
 #include "SubgraphMatching/DataGraph.h"
 #include "SubgraphMatching/PatternGraph.h"
 #include "DataStructure/Graph.h"
 #include "Base/Base.h"
 #include "Base/BasicAlgorithms.h"
+#include "Base/RefinementStatistics.h"
 
 /**
  * @brief The Candidate Space structure
@@ -12,7 +14,6 @@
 
 namespace GraphLib {
 namespace SubgraphMatching {
-    BipartiteMaximumMatching BPSolver;
     enum STRUCTURE_FILTER {
         NO_STRUCTURE_FILTER,
         TRIANGLE_SAFETY,
@@ -28,9 +29,31 @@ namespace SubgraphMatching {
         STRUCTURE_FILTER structure_filter = FOURCYCLE_SAFETY;
         NEIGHBOR_FILTER neighborhood_filter = EDGE_BIPARTITE_SAFETY;
         int MAX_QUERY_VERTEX = 50, MAX_QUERY_EDGE = 250;
-        long long max_num_matches = -1;
+        // limits of the backtracking (-1 for none): embeddings, search nodes (calls of FindEmbeddings) and time
+        // from the start of Match; a search stopped by one keeps the embeddings found so far
+        long long max_num_matches = -1, max_search_nodes = -1;
+        double time_limit_ms = -1;
+        // if set, the backtracking stops soon after *cancel becomes true; one flag may stop engines on many threads
+        const std::atomic<bool> *cancel = nullptr;
+        // search nodes between two reads of the clock and of *cancel
+        int limit_check_interval = 1024;
         double priority_cutoff = 0.05;
+        // candidate_neighbors hold candidate indices (true) or data vertices (false); Backtrack needs indices
         bool use_cs_index = true;
+        // If the data four-cycles are not fully enumerated, enumerate them for the candidate edges of each query
+        bool restrict_motifs_to_candidates = true;
+        // Reject initial candidates whose neighbor-label signature does not cover the query vertex's
+        bool use_neighbor_label_signature = true;
+        // Count clique patterns with the clique engine instead of backtracking
+        bool use_clique_engine = true;
+        // Count wedge, triangle and four-cycle patterns with the direct kernels instead of backtracking
+        bool use_pattern_kernels = true;
+    };
+
+    // rules by which RefineCS removes a candidate: CheckSubStructures, then NeighborFilter
+    enum CS_REFINEMENT_RULE {
+        STRUCTURE_RULE,
+        NEIGHBOR_RULE
     };
 
     class CandidateSpace {
@@ -48,8 +71,17 @@ namespace SubgraphMatching {
 
         inline int GetCandidate(int u, int v_idx) const {return candidate_set_[u][v_idx];};
 
+        /**
+         * @brief Build the candidate space of query
+         * @return false if some query vertex is left without candidates (so the query has no embedding)
+         */
         bool BuildCS(PatternGraph *query);
 
+        void ReportMemory(MemoryReport &report, const std::string &prefix = "CS") const;
+
+        // removals per CS_REFINEMENT_RULE of the last RefineCS, one round per refined query vertex
+        RefinementStatistics refine_stats;
+
         std::vector<int>& GetCandidates(int u) {
             return candidate_set_[u];
         }
@@ -65,10 +97,15 @@ namespace SubgraphMatching {
 
         std::vector<std::vector<int>> candidate_set_;
         std::vector<int> neighbor_label_frequency;
+        std::vector<NeighborLabelSignature> query_signature_;
+        // four-cycles of the candidate data edges of the current query, if the data graph has not enumerated them
+        LocalFourCycleStore candidate_four_cycles_;
         bool* in_neighbor_cs;
         bool** BitsetCS;
         bool** BitsetEdgeCS;
         int* num_visit_cs_;
+        // per instance, so that engines on different threads do not share it
+        BipartiteMaximumMatching BPSolver;
         int GetNumCSVertex() {
             int sz = 0;
             for (auto &v : candidate_set_) sz += v.size();
@@ -77,6 +114,8 @@ namespace SubgraphMatching {
 
         bool BuildInitialCS();
 
+        void EnumerateCandidateFourCycles();
+
         void ConstructCS();
 
         bool InitRootCandidates(int root);
@@ -156,7 +195,19 @@ namespace SubgraphMatching {
     }
 
 
+    void CandidateSpace::ReportMemory(MemoryReport &report, const std::string &prefix) const {
+        report.Add(prefix + "/BitsetCS", (size_t)opt.MAX_QUERY_VERTEX * (data_->GetNumVertices() + sizeof(bool *)));
+        report.Add(prefix + "/BitsetEdgeCS", (size_t)opt.MAX_QUERY_EDGE * (data_->GetNumEdges() + sizeof(bool *)));
+        report.Add(prefix + "/vertex_scratch", (size_t)data_->GetNumVertices() * (sizeof(bool) + sizeof(int)) +
+                                               MemoryBytes(neighbor_label_frequency));
+        report.AddVector(prefix + "/candidate_set", candidate_set_);
+        report.AddVector(prefix + "/candidate_neighbors", candidate_neighbors);
+        report.AddVector(prefix + "/query_signature", query_signature_);
+        report.Add(prefix + "/candidate_four_cycles", candidate_four_cycles_.GetMemoryUsage());
+    }
+
     bool CandidateSpace::BuildCS(PatternGraph *query) {
+        PROFILE_SCOPE("BuildCS");
         query_ = query;
         for (int i = 0; i < query_->GetNumVertices(); i++) {
             memset(BitsetCS[i], false, data_->GetNumVertices());
@@ -164,13 +215,20 @@ namespace SubgraphMatching {
         for (int i = 0; i < query_->GetNumEdges(); i++) {
             memset(BitsetEdgeCS[i], false, data_->GetNumEdges());
         }
-        memset(num_visit_cs_, 0, data_->GetNumVertices());
+        memset(num_visit_cs_, 0, sizeof(int) * data_->GetNumVertices());
         BPSolver.Initialize(query_->GetMaxDegree(), data_->GetMaxDegree(), opt.MAX_QUERY_VERTEX);
         for (int i = 0; i < query_->GetNumVertices(); i++) {
             candidate_set_[i].clear();
         }
-        BuildInitialCS();
-        RefineCS();
+        query_signature_.resize(query_->GetNumVertices());
+        for (int i = 0; i < query_->GetNumVertices(); i++) {
+            query_signature_[i] = data_->ComputeNeighborLabelSignature(*query_, i);
+        }
+        if (!BuildInitialCS()) return false;
+        if (opt.structure_filter == FOURCYCLE_SAFETY and !data_->FourCycleEnumerated()) {
+            EnumerateCandidateFourCycles();
+        }
+        if (!RefineCS()) return false;
         ConstructCS();
         return true;
     }
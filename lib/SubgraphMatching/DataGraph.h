@@ -13,25 +13,63 @@ namespace GraphLib { namespace SubgraphMatching {
         std::vector<double> vertex_label_probability, edge_label_probability;
         double vertex_label_entropy = 0.0, edge_label_entropy = 0.0;
     };
+    /**
+     * @brief Compact summary of the labels around a vertex: a bitmask of the neighbor labels (the label of
+     * frequency rank r sets bit r mod 64) and saturating neighbor counts of the NUM_COUNTED most frequent labels.
+     * @details A data vertex can only match a query vertex whose signature it covers.
+     */
+    struct NeighborLabelSignature {
+        static constexpr int NUM_COUNTED = 8;
+        uint64_t mask = 0;
+        uint8_t count[NUM_COUNTED] = {0};
+
+        inline bool Covers(const NeighborLabelSignature &other) const {
+            if (other.mask & ~mask) return false;
+            for (int i = 0; i < NUM_COUNTED; i++) {
+                if (count[i] < other.count[i]) return false;
+            }
+            return true;
+        }
+    };
+
     class DataGraph : public GraphLib::Graph {
     protected:
         // array of vertices, grouped by label, ordered by decreasing order of degree
         std::vector<std::vector<int>> vertex_by_labels, num_vertex_by_label_degree;
         std::unordered_map<int, int> transferred_label_map;
         LabelStatistics label_statistics;
+        // signature_slot[l] : rank of label l by decreasing frequency
+        std::vector<int> signature_slot;
+        std::vector<NeighborLabelSignature> neighbor_label_signature;
+        void BuildNeighborLabelSignatures();
     public:
         DataGraph(const Graph &g) : Graph(g) {};
         DataGraph(){};
         std::vector<int>& GetVerticesByLabel(int label) { return vertex_by_labels[label]; }
         int GetNumVerticesByLabelDegree(int label, int deg) const {
-            if (deg >= num_vertex_by_label_degree[label].size()) return 0;
+            if (deg >= (int)num_vertex_by_label_degree[label].size()) return 0;
             return num_vertex_by_label_degree[label][deg];
         }
         inline int GetTransferredLabel(int l) {return transferred_label_map[l];}
+        inline const NeighborLabelSignature &GetNeighborLabelSignature(int v) const {return neighbor_label_signature[v];}
+        /**
+         * @brief Signature of vertex v of g (whose labels are already transferred), using the label ranks of this graph
+         */
+        NeighborLabelSignature ComputeNeighborLabelSignature(Graph &g, int v) const;
         void Preprocess();
+        void ReportMemory(MemoryReport &report, const std::string &prefix = "DataGraph") const;
         void TransformLabel();
         void ComputeLabelStatistics();
-        bool FourCycleEnumerated() {return !local_four_cycles.empty();}
+        /**
+         * @brief Write the preprocessed data graph (optionally with its local motifs) as a binary snapshot
+         */
+        void WriteSnapshot(const std::string &filename, bool with_motifs = false);
+        /**
+         * @brief Load a snapshot written by WriteSnapshot through mmap, instead of LoadLabeledGraph + Preprocess
+         */
+        void LoadSnapshot(const std::string &filename);
+        // every edge can be looked up, either from the full store or through the lazy cache
+        bool FourCycleEnumerated() {return FourCyclesFullyEnumerated() or LazyLocalMotifs();}
     };
 
 
@@ -64,12 +102,96 @@ namespace GraphLib { namespace SubgraphMatching {
     }
 
 
+    static const uint64_t DATA_GRAPH_SNAPSHOT_MAGIC = 0x31504E5348475344ULL; // "DSGHSNP1"
+    static const uint32_t DATA_GRAPH_SNAPSHOT_VERSION = 2;
+
+    void DataGraph::WriteSnapshot(const std::string &filename, bool with_motifs) {
+        BinaryWriter out(filename);
+        out.Write<uint64_t>(DATA_GRAPH_SNAPSHOT_MAGIC);
+        out.Write<uint32_t>(DATA_GRAPH_SNAPSHOT_VERSION);
+        WriteSnapshotBody(out, with_motifs);
+        std::vector<std::pair<int, int>> label_map(transferred_label_map.begin(), transferred_label_map.end());
+        out.WriteVector(label_map);
+        out.WriteNested(vertex_by_labels);
+        out.WriteNested(num_vertex_by_label_degree);
+        out.WriteVector(label_statistics.vertex_label_probability);
+        out.WriteVector(label_statistics.edge_label_probability);
+        out.Write<double>(label_statistics.vertex_label_entropy);
+        out.Write<double>(label_statistics.edge_label_entropy);
+        out.WriteVector(signature_slot);
+        out.WriteVector(neighbor_label_signature);
+        fprintf(log_to, "Wrote snapshot %s (%llu bytes)\n", filename.c_str(), (unsigned long long)out.BytesWritten());
+    }
+
+    void DataGraph::LoadSnapshot(const std::string &filename) {
+        MappedFileReader in(filename);
+        if (in.Size() < 16 or in.Read<uint64_t>() != DATA_GRAPH_SNAPSHOT_MAGIC) {
+            fprintf(stderr, "%s is not a data graph snapshot\n", filename.c_str());
+            exit(1);
+        }
+        uint32_t version = in.Read<uint32_t>();
+        if (version != DATA_GRAPH_SNAPSHOT_VERSION) {
+            fprintf(stderr, "Snapshot %s has version %u, expected %u\n", filename.c_str(), version, DATA_GRAPH_SNAPSHOT_VERSION);
+            exit(1);
+        }
+        ReadSnapshotBody(in);
+        std::vector<std::pair<int, int>> label_map;
+        in.ReadVector(label_map);
+        transferred_label_map = std::unordered_map<int, int>(label_map.begin(), label_map.end());
+        in.ReadNested(vertex_by_labels);
+        in.ReadNested(num_vertex_by_label_degree);
+        in.ReadVector(label_statistics.vertex_label_probability);
+        in.ReadVector(label_statistics.edge_label_probability);
+        label_statistics.vertex_label_entropy = in.Read<double>();
+        label_statistics.edge_label_entropy = in.Read<double>();
+        in.ReadVector(signature_slot);
+        in.ReadVector(neighbor_label_signature);
+        std::cerr << "#Vertex = " << GetNumVertices() << " " << "#Edges = " << GetNumEdges() << std::endl;
+        std::cerr << "Degeneracy = " << degeneracy << std::endl;
+    }
+
+    NeighborLabelSignature DataGraph::ComputeNeighborLabelSignature(Graph &g, int v) const {
+        NeighborLabelSignature signature;
+        for (int nbr : g.GetNeighbors(v)) {
+            int l = g.GetVertexLabel(nbr);
+            if (l < 0 or l >= (int)signature_slot.size()) continue;
+            int slot = signature_slot[l];
+            signature.mask |= 1ULL << (slot & 63);
+            if (slot < NeighborLabelSignature::NUM_COUNTED and signature.count[slot] < UINT8_MAX) {
+                signature.count[slot]++;
+            }
+        }
+        return signature;
+    }
+
+    void DataGraph::BuildNeighborLabelSignatures() {
+        std::vector<int> labels_by_frequency(GetNumLabels());
+        for (int l = 0; l < GetNumLabels(); l++) labels_by_frequency[l] = l;
+        std::stable_sort(labels_by_frequency.begin(), labels_by_frequency.end(), [this](int a, int b) {
+            return label_statistics.vertex_label_probability[a] > label_statistics.vertex_label_probability[b];
+        });
+        signature_slot.assign(GetNumLabels(), 0);
+        for (int r = 0; r < GetNumLabels(); r++) signature_slot[labels_by_frequency[r]] = r;
+        neighbor_label_signature.resize(GetNumVertices());
+        ParallelFor(0, GetNumVertices(), [&](long long v, int) {
+            neighbor_label_signature[v] = ComputeNeighborLabelSignature(*this, v);
+        }, 4096);
+    }
+
+    void DataGraph::ReportMemory(MemoryReport &report, const std::string &prefix) const {
+        Graph::ReportMemory(report, prefix);
+        report.Add(prefix + "/vertex_by_labels", MemoryBytes(vertex_by_labels) + MemoryBytes(num_vertex_by_label_degree));
+        report.AddVector(prefix + "/neighbor_label_signature", neighbor_label_signature);
+    }
+
     void DataGraph::Preprocess() {
-        for (auto &it : adj_list) max_degree = std::max(max_degree, (int)it.size());
+        PROFILE_SCOPE("Preprocess");
         TransformLabel();
         BuildIncidenceList();
-        ComputeCoreNum();
+        if (num_worker_threads > 1) ComputeCoreNumParallel();
+        else ComputeCoreNum();
         ComputeLabelStatistics();
+        BuildNeighborLabelSignatures();
         vertex_by_labels.resize(GetNumLabels());
         num_vertex_by_label_degree.resize(GetNumLabels());
         for (int i = 0; i < GetNumVertices(); i++) {
@@ -80,7 +202,7 @@ namespace GraphLib { namespace SubgraphMatching {
             std::sort(vertex_by_labels[i].begin(), vertex_by_labels[i].end(), [this](int a, int b) {
                 return GetDegree(a) > GetDegree(b);
             });
-            num_vertex_by_label_degree[i].resize(GetDegree(vertex_by_labels[i].front())+1, 0);
+            num_vertex_by_label_degree[i].resize(GetDegree(vertex_by_labels[i].front())+2, 0);
             for (int v : vertex_by_labels[i]) {
                 int d = GetDegree(v);
                 if (num_vertex_by_label_degree[i][d] == 0) {
@@ -2,7 +2,9 @@
 /**
 * @brief Class for subgraph pattern
 */
+#include <array>
 #include "DataStructure/Graph.h"
+#include "DataStructure/CanonicalLabeling.h"
 #include "SubgraphMatching/DataGraph.h"
 
 //#include "ortools/linear_solver/linear_solver.h"
@@ -13,6 +15,13 @@
 //const double infinity = solver->infinity();
 
 namespace GraphLib::SubgraphMatching {
+    enum PATTERN_SHAPE {
+        GENERAL_PATTERN,
+        WEDGE_PATTERN,
+        TRIANGLE_PATTERN,
+        FOURCYCLE_PATTERN,
+        CLIQUE_PATTERN
+    };
     class PatternGraph : public Graph {
     public:
         PatternGraph(){};
@@ -24,6 +33,30 @@ namespace GraphLib::SubgraphMatching {
 
         void ProcessPattern(DataGraph &data);
 
+        /**
+         * @brief True if the pattern is a simple complete graph on at least three vertices
+         */
+        bool IsClique();
+
+        /**
+         * @brief Recognize the shapes that have direct counting kernels (a triangle is reported as TRIANGLE_PATTERN)
+         */
+        PATTERN_SHAPE ClassifyShape();
+
+        /**
+         * @brief Vertices of a FOURCYCLE_PATTERN in cyclic order
+         */
+        std::array<int, 4> GetCycleOrder();
+
+        /**
+         * @brief Code of the pattern that does not depend on the numbering of its vertices: the canonical code
+         * (CanonicalLabeling) of the pattern colored by its current labels (as read, or as transferred by
+         * ProcessPattern)
+         * @param canonical_vertex_id if given, receives the canonical position of each vertex
+         * @return false if the search was cut (the code is exact, but isomorphic patterns may differ in it)
+         */
+        bool GetCanonicalCode(std::vector<int> &code, std::vector<int> *canonical_vertex_id = nullptr);
+
 //        void FindFractionalEdgeCover(std::vector<double> &weights);
 //
 //        std::vector<double> fractional_edge_cover;
@@ -35,7 +68,7 @@ namespace GraphLib::SubgraphMatching {
         for (int v = 0; v < GetNumVertices(); v++) {
             int l = data.GetTransferredLabel(GetVertexLabel(v));
             vertex_label[v] = l;
-            max_degree = std::max(max_degree, (int)(adj_list[v].size()));
+            max_degree = std::max(max_degree, GetDegree(v));
         }
         num_vertex_labels = data.GetNumLabels();
         BuildIncidenceList();
@@ -44,6 +77,60 @@ namespace GraphLib::SubgraphMatching {
 //        std::cerr << "Degeneracy = " << degeneracy << std::endl;
     }
 
+    bool PatternGraph::GetCanonicalCode(std::vector<int> &code, std::vector<int> *canonical_vertex_id) {
+        std::vector<std::vector<int>> colors(GetNumVertices()), nbrs(GetNumVertices());
+        for (int v = 0; v < GetNumVertices(); v++) {
+            colors[v] = {GetVertexLabel(v)};
+            nbrs[v].assign(GetNeighbors(v).begin(), GetNeighbors(v).end());
+        }
+        CanonicalLabeling labeling(colors, nbrs);
+        code = labeling.GetCode();
+        if (canonical_vertex_id != nullptr) *canonical_vertex_id = labeling.GetPosition();
+        return labeling.IsComplete();
+    }
+
+    PATTERN_SHAPE PatternGraph::ClassifyShape() {
+        int n = GetNumVertices();
+        for (int v = 0; v < n; v++) {
+            auto nbrs = GetNeighbors(v);
+            for (size_t j = 0; j < nbrs.size(); j++) {
+                if (nbrs[j] == v or (j > 0 and nbrs[j] == nbrs[j - 1])) return GENERAL_PATTERN;
+            }
+        }
+        if (n == 3 and GetNumEdges() == 4) return WEDGE_PATTERN;
+        if (n == 4 and GetNumEdges() == 8) {
+            bool all_degree_two = true;
+            for (int v = 0; v < n; v++) all_degree_two &= (GetDegree(v) == 2);
+            if (all_degree_two) return FOURCYCLE_PATTERN;
+        }
+        if (IsClique()) return n == 3 ? TRIANGLE_PATTERN : CLIQUE_PATTERN;
+        return GENERAL_PATTERN;
+    }
+
+    std::array<int, 4> PatternGraph::GetCycleOrder() {
+        std::array<int, 4> order;
+        order[0] = 0;
+        order[1] = GetNeighbors(0)[0];
+        order[3] = GetNeighbors(0)[1];
+        for (int x : GetNeighbors(order[1])) {
+            if (x != order[0]) order[2] = x;
+        }
+        return order;
+    }
+
+    bool PatternGraph::IsClique() {
+        int n = GetNumVertices();
+        if (n < 3 or GetNumEdges() != n * (n - 1)) return false;
+        for (int v = 0; v < n; v++) {
+            auto nbrs = GetNeighbors(v);
+            if (nbrs.size() != (size_t)(n - 1)) return false;
+            for (size_t j = 0; j < nbrs.size(); j++) {
+                if (nbrs[j] == v or (j > 0 and nbrs[j] == nbrs[j - 1])) return false;
+            }
+        }
+        return true;
+    }
+
     /*void PatternGraph::FindFractionalEdgeCover(std::vector<double> &weights) {
         std::vector<OR::MPVariable*> edgevariables(GetNumEdges()/2);
         std::vector<OR::MPConstraint*> vertexconstraints(GetNumVertices());
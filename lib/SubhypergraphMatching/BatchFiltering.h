@@ -0,0 +1,139 @@
+#pragma once
+#include <map>
+#include "SubhypergraphMatching/DataHyperGraph.h"
+#include "SubhypergraphMatching/PatternHyperGraph.h"
+#include "SubhypergraphMatching/HyperCandidateSpace.h"
+#include "Base/Timer.h"
+
+namespace GraphLib::SubHyperGraphMatching {
+    /**
+     * @brief Candidate filtering shared by the queries of a batch, over their common stars
+     * @details The star of a query vertex u (in at least two hyperedges) is the sub-pattern made of the hyperedges
+     * incident to u. Every embedding of a query restricts to an embedding of each of its stars, so the candidates
+     * left by the refined HCS of a star are candidates of the query vertices it covers. Stars are told apart up to
+     * isomorphism by their canonical code (PatternHyperGraph::GetCanonicalCode), so a star shared by several
+     * queries, or by several vertices of one query, is extracted and refined once. The candidates of a query
+     * vertex are the intersection over the stars that contain it; the data hypergraph of the query is then
+     * extracted from these candidates only (DataHyperGraph::BuildFromDataset) and its HCS starts from them
+     * (HyperCandidateSpace). Queries that DirectCounter answers are skipped. The dataset should be indexed
+     * (BuildSignatureIndex).
+     */
+    class BatchFilter {
+        const HyperGraphDataset &data;
+        SubHyperGraphMatchingOption opt;
+        // candidate dataset vertices (sorted) of each canonical position of each star seen so far, by canonical
+        // code; no position for the stars whose HCS is over opt.max_memory_bytes
+        std::map<std::vector<int>, std::vector<std::vector<int>>> star_candidates;
+        // per query, candidate dataset vertices of each query vertex; empty for the queries not filtered
+        std::vector<std::vector<std::vector<int>>> vertex_candidates;
+
+        // candidates of star S by canonical position; false if its HCS is over the memory limit
+        bool RefineStar(PatternHyperGraph &S, const std::vector<int> &position,
+                        std::vector<std::vector<int>> &candidates);
+        void FilterQuery(int i, PatternHyperGraph &P);
+    public:
+        BatchFilter(const HyperGraphDataset &data_, std::vector<PatternHyperGraph> &patterns,
+                    SubHyperGraphMatchingOption opt_);
+
+        /**
+         * @brief Candidate dataset vertices of each vertex of query i (sorted), for BuildFromDataset; nullptr if
+         * the query was not filtered
+         */
+        const std::vector<std::vector<int>> *GetVertexCandidates(int i) const {
+            return vertex_candidates[i].empty() ? nullptr : &vertex_candidates[i];
+        }
+
+        // stars over all queries, and those refined (distinct up to isomorphism)
+        long long num_stars = 0, num_distinct_stars = 0;
+        double filter_time = 0.0;
+    };
+
+    BatchFilter::BatchFilter(const HyperGraphDataset &data_, std::vector<PatternHyperGraph> &patterns,
+                             SubHyperGraphMatchingOption opt_) : data(data_), opt(opt_) {
+        PROFILE_SCOPE("BatchFilter");
+        Timer timer;
+        timer.Start();
+        vertex_candidates.resize(patterns.size());
+        for (int i = 0; i < (int)patterns.size(); i++) FilterQuery(i, patterns[i]);
+        timer.Stop();
+        filter_time = timer.GetTime();
+    }
+
+    bool BatchFilter::RefineStar(PatternHyperGraph &S, const std::vector<int> &position,
+                                 std::vector<std::vector<int>> &candidates) {
+        DataHyperGraph HG;
+        HG.BuildFromDataset(data, S);
+        if (opt.max_memory_bytes > 0 and HyperCandidateSpace::EstimateMemory(&HG, &S) > opt.max_memory_bytes) {
+            return false;
+        }
+        HyperCandidateSpace HCS(&HG, &S, opt);
+        candidates.assign(S.GetNumVertices(), {});
+        // an emptied candidate set leaves every position empty: no query containing S has an embedding
+        if (HCS.HasEmptyCandidateSet()) return true;
+        for (int w = 0; w < S.GetNumVertices(); w++) {
+            auto &cands = candidates[position[w]];
+            for (int v : HCS.GetCandidateVertices(w)) cands.push_back(HG.GetDatasetVertexId(v));
+            std::sort(cands.begin(), cands.end());
+        }
+        return true;
+    }
+
+    void BatchFilter::FilterQuery(int i, PatternHyperGraph &P) {
+        if (opt.use_direct_counting and P.ClassifyShape() != GENERAL_HYPERGRAPH_PATTERN) return;
+        int n = P.GetNumVertices();
+        std::vector<int> labels = P.GetDatasetVertexLabels();
+        std::vector<std::vector<int>> candidates(n);
+        std::vector<bool> covered(n, false);
+        for (int u = 0; u < n; u++) {
+            // vertices with no hyperedge have no star, and match no extracted vertex anyway
+            if (P.GetDegree(u) == 0) return;
+            // the star of a vertex in one hyperedge is that hyperedge, which extraction by signature already covers
+            if (P.GetDegree(u) == 1) continue;
+            std::vector<int> local_id(n, -1), star_vertices, star_labels;
+            std::vector<std::vector<int>> star_edges;
+            for (int e : P.GetIncidentHyperedges(u)) {
+                star_edges.emplace_back();
+                for (int w : P.GetHyperedge(e)) {
+                    if (local_id[w] == -1) {
+                        local_id[w] = star_vertices.size();
+                        star_vertices.push_back(w);
+                        star_labels.push_back(labels[w]);
+                    }
+                    star_edges.back().push_back(local_id[w]);
+                }
+            }
+            PatternHyperGraph S;
+            S.LoadPatternHyperGraph(star_labels, star_edges);
+            std::vector<int> code, position;
+            S.GetCanonicalCode(code, &position);
+            num_stars++;
+            auto it = star_candidates.find(code);
+            if (it == star_candidates.end()) {
+                std::vector<std::vector<int>> star_cands;
+                if (!RefineStar(S, position, star_cands)) star_cands.clear();
+                it = star_candidates.emplace(code, std::move(star_cands)).first;
+                num_distinct_stars++;
+            }
+            if (it->second.empty()) continue;
+            for (size_t k = 0; k < star_vertices.size(); k++) {
+                int w = star_vertices[k];
+                auto &cands = it->second[position[k]];
+                if (!covered[w]) {
+                    candidates[w] = cands;
+                    covered[w] = true;
+                    continue;
+                }
+                std::vector<int> both;
+                std::set_intersection(candidates[w].begin(), candidates[w].end(), cands.begin(), cands.end(),
+                                      std::back_inserter(both));
+                candidates[w].swap(both);
+            }
+        }
+        // a vertex in no refined star (only in hyperedges of degree-1 vertices, or in stars over the memory limit)
+        // may match any vertex of its label: leave the query
+        for (int u = 0; u < n; u++) {
+            if (!covered[u]) return;
+        }
+        vertex_candidates[i] = std::move(candidates);
+    }
+}
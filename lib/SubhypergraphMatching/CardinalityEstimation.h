@@ -0,0 +1,218 @@
+#pragma once
+#include <cmath>
+#include "SubhypergraphMatching/DataHyperGraph.h"
+#include "SubhypergraphMatching/PatternHyperGraph.h"
+#include "SubhypergraphMatching/HyperCandidateSpace.h"
+#include "Base/Random.h"
+#include "Base/Timer.h"
+
+namespace GraphLib::SubHyperGraphMatching {
+    struct EstimationOption {
+        // sampling stops after max_samples samples or time_budget_ms milliseconds, whichever comes first
+        long long max_samples = 1'000'000;
+        double time_budget_ms = 100.0;
+        // coverage of the confidence interval
+        double confidence = 0.95;
+        uint64_t seed = 0;
+    };
+
+    /**
+     * @brief Estimated number of embeddings, with the standard error of the estimate and a confidence interval
+     * (normal approximation, clipped at 0)
+     */
+    struct CardinalityEstimate {
+        double estimate = 0.0, std_error = 0.0, ci_low = 0.0, ci_high = 0.0;
+        // samples drawn, and those that reached a full embedding
+        long long num_samples = 0, num_successes = 0;
+        double time_ms = 0.0;
+    };
+
+    /**
+     * @brief Unbiased estimate of the number of embeddings by random walks over the refined HCS (WanderJoin)
+     * @details A sample matches the query hyperedges in a fixed connected order. The first hyperedge of each
+     * component takes a random HCS candidate; a later one takes a random HCS candidate among the data hyperedges
+     * incident to the image of one of its matched vertices that contain the images of all of them and no vertex
+     * matched elsewhere. Its unmatched vertices then take random unused HCS candidates in that hyperedge, and
+     * vertices in no hyperedge any unused HCS candidate. Each embedding is reached by exactly one walk, with
+     * probability the inverse of the product of the numbers of choices along it, so the walk weighs that product
+     * (0 if it gets stuck) and the mean weight is an unbiased estimate. Walks are pruned only by the HCS, which
+     * never removes the image of an embedding, so the estimate stays unbiased.
+     */
+    class CardinalityEstimator {
+        DataHyperGraph *data;
+        PatternHyperGraph *query;
+        const HyperCandidateSpace *HCS;
+        // query hyperedges in sampling order, and the query vertices in no hyperedge
+        std::vector<int> order, isolated_vertices;
+        // data vertex matched to each query vertex and query vertex matched to each data vertex (-1 if none)
+        std::vector<int> mapping, owner;
+        std::vector<int> matched_vertices, choices;
+
+        void ComputeOrder();
+        // whether data hyperedge f may extend the current partial embedding as the image of query hyperedge e
+        bool Extends(int e, int f);
+        void Map(int u, int v);
+        // weight of one random walk
+        double Sample(SplitMix64 &rng);
+    public:
+        CardinalityEstimator(DataHyperGraph *data_, PatternHyperGraph *query_, const HyperCandidateSpace *HCS_);
+
+        CardinalityEstimate Estimate(const EstimationOption &opt);
+
+        /**
+         * @brief z such that a normal variable is within z standard deviations of its mean with this probability
+         */
+        static double NormalQuantile(double confidence);
+    };
+
+    CardinalityEstimator::CardinalityEstimator(DataHyperGraph *data_, PatternHyperGraph *query_,
+                                               const HyperCandidateSpace *HCS_) : data(data_), query(query_),
+                                                                                   HCS(HCS_) {
+        mapping.assign(query->GetNumVertices(), -1);
+        owner.assign(data->GetNumVertices(), -1);
+        ComputeOrder();
+    }
+
+    void CardinalityEstimator::ComputeOrder() {
+        int m = query->GetNumHyperedges();
+        std::vector<char> placed(m, 0), covered(query->GetNumVertices(), 0);
+        for (int step = 0; step < m; step++) {
+            // most vertices already covered, then fewest candidates: the walk branches as little as possible
+            int best = -1, best_covered = -1;
+            for (int e = 0; e < m; e++) {
+                if (placed[e]) continue;
+                int num_covered = 0;
+                for (int u : query->GetHyperedge(e)) num_covered += covered[u];
+                if (best == -1 or num_covered > best_covered or
+                    (num_covered == best_covered and
+                     HCS->GetCandidateHyperedges(e).size() < HCS->GetCandidateHyperedges(best).size())) {
+                    best = e;
+                    best_covered = num_covered;
+                }
+            }
+            placed[best] = 1;
+            order.push_back(best);
+            for (int u : query->GetHyperedge(best)) covered[u] = 1;
+        }
+        for (int u = 0; u < query->GetNumVertices(); u++) {
+            if (!covered[u]) isolated_vertices.push_back(u);
+        }
+    }
+
+    bool CardinalityEstimator::Extends(int e, int f) {
+        if (!HCS->isHyperedgeCandidate(e, f)) return false;
+        int num_matched = 0, num_owned = 0;
+        for (int u : query->GetHyperedge(e)) {
+            if (mapping[u] == -1) continue;
+            num_matched++;
+            auto &vertices = data->GetHyperedge(f);
+            if (std::find(vertices.begin(), vertices.end(), mapping[u]) == vertices.end()) return false;
+        }
+        for (int v : data->GetHyperedge(f)) num_owned += (owner[v] != -1);
+        return num_owned == num_matched;
+    }
+
+    void CardinalityEstimator::Map(int u, int v) {
+        mapping[u] = v;
+        owner[v] = u;
+        matched_vertices.push_back(u);
+    }
+
+    double CardinalityEstimator::Sample(SplitMix64 &rng) {
+        double weight = 1.0;
+        auto Pick = [&]() {
+            weight *= choices.size();
+            return choices[std::uniform_int_distribution<size_t>(0, choices.size() - 1)(rng)];
+        };
+        for (int e : order) {
+            // the candidates of e are incident to the image of any matched vertex of e: take the smallest list
+            int anchor = -1;
+            for (int u : query->GetHyperedge(e)) {
+                if (mapping[u] != -1 and (anchor == -1 or data->GetDegree(mapping[u]) < data->GetDegree(anchor)))
+                    anchor = mapping[u];
+            }
+            choices.clear();
+            for (int f : anchor == -1 ? HCS->GetCandidateHyperedges(e) : data->GetIncidentHyperedges(anchor)) {
+                if (Extends(e, f)) choices.push_back(f);
+            }
+            if (choices.empty()) {
+                weight = 0.0;
+                break;
+            }
+            int f = Pick();
+            for (int u : query->GetHyperedge(e)) {
+                if (mapping[u] != -1) continue;
+                choices.clear();
+                for (int v : data->GetHyperedge(f)) {
+                    if (owner[v] == -1 and HCS->isVertexCandidate(u, v)) choices.push_back(v);
+                }
+                if (choices.empty()) {
+                    weight = 0.0;
+                    break;
+                }
+                Map(u, Pick());
+            }
+            if (weight == 0.0) break;
+        }
+        for (size_t i = 0; i < isolated_vertices.size() and weight > 0.0; i++) {
+            int u = isolated_vertices[i];
+            choices.clear();
+            for (int v : HCS->GetCandidateVertices(u)) {
+                if (owner[v] == -1) choices.push_back(v);
+            }
+            if (choices.empty()) weight = 0.0;
+            else Map(u, Pick());
+        }
+        for (int u : matched_vertices) {
+            owner[mapping[u]] = -1;
+            mapping[u] = -1;
+        }
+        matched_vertices.clear();
+        return weight;
+    }
+
+    CardinalityEstimate CardinalityEstimator::Estimate(const EstimationOption &opt) {
+        CardinalityEstimate result;
+        Timer timer;
+        timer.Start();
+        if (HCS->HasEmptyCandidateSet()) {
+            timer.Stop();
+            result.time_ms = timer.GetTime();
+            return result;
+        }
+        SplitMix64 rng(opt.seed);
+        // running mean and sum of squared deviations of the weights (Welford)
+        double mean = 0.0, m2 = 0.0;
+        long long n = 0;
+        while (n < opt.max_samples) {
+            // read the clock once per 64 samples
+            if (n % 64 == 0 and n > 0 and timer.Peek() >= opt.time_budget_ms) break;
+            double weight = Sample(rng);
+            n++;
+            if (weight > 0.0) result.num_successes++;
+            double delta = weight - mean;
+            mean += delta / n;
+            m2 += delta * (weight - mean);
+        }
+        timer.Stop();
+        result.num_samples = n;
+        result.estimate = mean;
+        result.std_error = n > 1 ? std::sqrt(m2 / (n - 1) / n) : 0.0;
+        double z = NormalQuantile(opt.confidence);
+        result.ci_low = std::max(0.0, mean - z * result.std_error);
+        result.ci_high = mean + z * result.std_error;
+        result.time_ms = timer.GetTime();
+        return result;
+    }
+
+    double CardinalityEstimator::NormalQuantile(double confidence) {
+        // P(|Z| > z) = erfc(z / sqrt(2)) decreases in z: bisect for 1 - confidence
+        double lo = 0.0, hi = 40.0;
+        for (int i = 0; i < 100; i++) {
+            double mid = (lo + hi) / 2;
+            if (std::erfc(mid / std::sqrt(2.0)) > 1.0 - confidence) lo = mid;
+            else hi = mid;
+        }
+        return (lo + hi) / 2;
+    }
+}
@@ -1,70 +1,269 @@
 #pragma once
+#include <numeric>
+#include <set>
 #include "DataStructure/HyperGraph/HyperGraph.h"
 #include "SubhypergraphMatching/PatternHyperGraph.h"
 
 namespace GraphLib {
     namespace SubHyperGraphMatching {
+        /**
+         * @brief Raw hypergraph dataset in Benson's format (labels as in the file, minus one), read once and
+         * shared by every query of a batch
+         */
+        struct HyperGraphDataset {
+            std::string name;
+            std::vector<int> vertex_label;
+            // sorted, duplicate-free hyperedges of arity >= 2
+            std::vector<std::vector<int>> hyperedges;
+            // hyperedge ids by label signature (sorted vertex labels); empty until BuildSignatureIndex
+            std::map<std::vector<int>, std::vector<int>> hyperedges_by_signature;
+            // hash of the labels and hyperedges, so that results cached for one dataset are not reused for another
+            std::size_t version = 0;
+
+            /**
+             * @param signatures if given, keep only the hyperedges whose label signature is in it
+             */
+            void Load(const std::string &dataset, const std::string &path,
+                      const std::set<std::vector<int>> *signatures = nullptr);
+            /**
+             * @brief Load, in one scan of the hyperedge file, only the hyperedges that some pattern of a batch can
+             * match (whose label signature appears in one of them), and index them by signature; BuildFromDataset
+             * then extracts the data hypergraph of each pattern from this dataset without scanning it
+             */
+            void LoadForPatterns(const std::string &dataset, const std::string &path,
+                                 const std::vector<PatternHyperGraph> &patterns);
+            /**
+             * @brief Index the hyperedges by label signature, so that BuildFromDataset visits only the hyperedges
+             * whose signature appears in the pattern instead of the whole dataset
+             */
+            void BuildSignatureIndex();
+            /**
+             * @brief Recompute version from the content; Load calls it, so do other builders of the dataset
+             */
+            void ComputeVersion();
+        };
+
         class DataHyperGraph : public GraphLib::HyperGraph {
         protected:
             std::vector<std::vector<int>> vertex_by_labels;
             std::vector<std::vector<int>> hyperedges_by_label;
+            // id in the dataset of each vertex (increasing)
+            std::vector<int> dataset_vertex_id;
+            // index in HyperGraphDataset::hyperedges of each hyperedge
+            std::vector<int> dataset_hyperedge_id;
         public:
             std::vector<int>& GetHyperedgesByLabel(const int l) {return hyperedges_by_label[l];}
             std::vector<int>& GetVerticesByLabel(const int l) {return vertex_by_labels[l];}
+            int GetDatasetVertexId(const int v) const {return dataset_vertex_id[v];}
+            int GetDatasetHyperedgeId(const int e) const {return dataset_hyperedge_id[e];}
             void LoadDataGraph(std::string dataset, std::string path, PatternHyperGraph &P);
+            /**
+             * @brief Extract the part of the dataset relevant to P: hyperedges whose label signature appears in P,
+             * and the vertices they contain, with labels mapped through P
+             * @param vertex_candidates if given, dataset vertices that each vertex of P may match (e.g. from
+             * BatchFilter): only the hyperedges whose vertices are all candidates of some vertex of P are extracted
+             */
+            void BuildFromDataset(const HyperGraphDataset &D, PatternHyperGraph &P,
+                                  const std::vector<std::vector<int>> *vertex_candidates = nullptr);
+            /**
+             * @brief Ids in this hypergraph of lists of dataset vertices; the vertices not extracted are dropped
+             */
+            std::vector<std::vector<int>> ToLocalVertices(const std::vector<std::vector<int>> &dataset_vertices) const;
+            void ReportMemory(MemoryReport &report, const std::string &prefix = "DataHyperGraph") const {
+                HyperGraph::ReportMemory(report, prefix);
+                report.Add(prefix + "/by_label", MemoryBytes(vertex_by_labels) + MemoryBytes(hyperedges_by_label));
+            }
         };
 
-        void DataHyperGraph::LoadDataGraph(std::string dataset, std::string path, PatternHyperGraph &P) {
+        void HyperGraphDataset::Load(const std::string &dataset, const std::string &path,
+                                     const std::set<std::vector<int>> *signatures) {
+            PROFILE_SCOPE("LoadDataset");
+            name = dataset;
             std::string hyperedge_file = path + "/" + dataset + "/hyperedges-" + dataset + ".txt";
             std::string vertex_label_file = path + "/" + dataset + "/node-labels-" + dataset + ".txt";
             std::cerr << "Read " << fileSize(hyperedge_file.c_str()) << " bytes from " << hyperedge_file << endl;
             std::ifstream fin(vertex_label_file);
+            if (!fin.is_open()) {
+                fprintf(stderr, "Cannot open %s\n", vertex_label_file.c_str());
+                exit(1);
+            }
             std::string line;
-            std::vector<int> tmp_vertex_label;
+            vertex_label.clear();
             while (getline(fin, line)) {
-                int l = stoi(line)-1;
-                tmp_vertex_label.push_back(P.GetMappedVertexLabel(l));
+                vertex_label.push_back(stoi(line)-1);
             }
-            num_vertex = tmp_vertex_label.size();
-            std::vector<int> vertex_used(num_vertex, -1);
-
             fin = std::ifstream(hyperedge_file);
+            hyperedges.clear();
+            std::vector<int> signature;
             while (getline(fin, line)) {
                 auto edge = parse(line, ",");
                 std::vector<int> current_hyperedge;
-                std::vector<int> current_signature;
                 for (auto &elem : edge) {
                     current_hyperedge.push_back(stoi(elem)-1);
                 }
                 std::sort(current_hyperedge.begin(), current_hyperedge.end());
                 current_hyperedge.erase(std::unique(current_hyperedge.begin(), current_hyperedge.end()), current_hyperedge.end());
                 if (current_hyperedge.size() == 1) { continue; }
+                if (signatures != nullptr) {
+                    signature.clear();
+                    for (int v : current_hyperedge) signature.push_back(vertex_label[v]);
+                    std::sort(signature.begin(), signature.end());
+                    if (signatures->find(signature) == signatures->end()) continue;
+                }
+                hyperedges.push_back(current_hyperedge);
+            }
+            std::sort(hyperedges.begin(), hyperedges.end());
+            hyperedges.erase(std::unique(hyperedges.begin(), hyperedges.end()), hyperedges.end());
+            ComputeVersion();
+        }
+
+        std::vector<std::vector<int>> DataHyperGraph::ToLocalVertices(
+                const std::vector<std::vector<int>> &dataset_vertices) const {
+            std::vector<std::vector<int>> local(dataset_vertices.size());
+            for (size_t i = 0; i < dataset_vertices.size(); i++) {
+                for (int v : dataset_vertices[i]) {
+                    auto it = std::lower_bound(dataset_vertex_id.begin(), dataset_vertex_id.end(), v);
+                    if (it != dataset_vertex_id.end() and *it == v) local[i].push_back(it - dataset_vertex_id.begin());
+                }
+            }
+            return local;
+        }
+
+        void HyperGraphDataset::LoadForPatterns(const std::string &dataset, const std::string &path,
+                                                const std::vector<PatternHyperGraph> &patterns) {
+            std::set<std::vector<int>> signatures;
+            for (auto &P : patterns) {
+                for (auto &signature : P.GetDatasetHyperedgeSignatures()) signatures.insert(signature);
+            }
+            Load(dataset, path, &signatures);
+            BuildSignatureIndex();
+        }
+
+        void HyperGraphDataset::ComputeVersion() {
+            version = vertex_label.size();
+            for (int l : vertex_label) std::combine(version, l);
+            for (auto &e : hyperedges) {
+                std::combine(version, e.size());
+                for (int v : e) std::combine(version, v);
+            }
+        }
+
+        void HyperGraphDataset::BuildSignatureIndex() {
+            PROFILE_SCOPE("BuildSignatureIndex");
+            hyperedges_by_signature.clear();
+            std::vector<int> signature;
+            for (int f = 0; f < (int)hyperedges.size(); f++) {
+                signature.clear();
+                for (int v : hyperedges[f]) signature.push_back(vertex_label[v]);
+                std::sort(signature.begin(), signature.end());
+                hyperedges_by_signature[signature].push_back(f);
+            }
+        }
+
+        void DataHyperGraph::LoadDataGraph(std::string dataset, std::string path, PatternHyperGraph &P) {
+            PROFILE_SCOPE("LoadDataGraph");
+            HyperGraphDataset D;
+            D.Load(dataset, path);
+            BuildFromDataset(D, P);
+        }
+
+        void DataHyperGraph::BuildFromDataset(const HyperGraphDataset &D, PatternHyperGraph &P,
+                                              const std::vector<std::vector<int>> *vertex_candidates) {
+            PROFILE_SCOPE("ExtractDataGraph");
+            // dataset label -> label of P, -1 for the labels P does not use
+            std::vector<int> mapped_label;
+            for (auto &signature : P.GetDatasetHyperedgeSignatures()) {
+                for (int l : signature) {
+                    if (l >= (int)mapped_label.size()) mapped_label.resize(l + 1, -1);
+                    mapped_label[l] = P.GetMappedVertexLabel(l);
+                }
+            }
+            auto MappedLabel = [&](int v) {
+                int l = D.vertex_label[v];
+                return (size_t)l < mapped_label.size() ? mapped_label[l] : -1;
+            };
+
+            std::vector<int> allowed_vertices;
+            if (vertex_candidates != nullptr) {
+                for (auto &cands : *vertex_candidates) {
+                    allowed_vertices.insert(allowed_vertices.end(), cands.begin(), cands.end());
+                }
+                std::sort(allowed_vertices.begin(), allowed_vertices.end());
+                allowed_vertices.erase(std::unique(allowed_vertices.begin(), allowed_vertices.end()),
+                                       allowed_vertices.end());
+            }
+
+            auto AddHyperedge = [&](int f) {
+                auto &current_hyperedge = D.hyperedges[f];
+                if (vertex_candidates != nullptr) {
+                    for (int v : current_hyperedge) {
+                        if (!std::binary_search(allowed_vertices.begin(), allowed_vertices.end(), v)) return;
+                    }
+                }
+                std::vector<int> current_signature;
                 for (auto &elem : current_hyperedge) {
-                    current_signature.push_back(tmp_vertex_label[elem]);
+                    current_signature.push_back(MappedLabel(elem));
                 }
                 std::sort(current_signature.begin(), current_signature.end());
                 int l = P.GetMappedHyperedgeLabel(current_signature);
-                if (l == -1) continue;
-                for (auto &elem : current_hyperedge) {
-                    vertex_used[elem] = 0;
-                }
+                if (l == -1) return;
                 total_arity += current_hyperedge.size();
                 hyperedges.push_back(current_hyperedge);
+                dataset_hyperedge_id.push_back(f);
+            };
+            if (D.hyperedges_by_signature.empty()) {
+                for (int f = 0; f < (int)D.hyperedges.size(); f++) AddHyperedge(f);
+            }
+            else {
+                for (auto &signature : P.GetDatasetHyperedgeSignatures()) {
+                    auto it = D.hyperedges_by_signature.find(signature);
+                    if (it == D.hyperedges_by_signature.end()) continue;
+                    for (int f : it->second) AddHyperedge(f);
+                }
             }
-            num_vertex = 0;
-            for (int i = 0; i < vertex_used.size(); i++) {
-                if (vertex_used[i] >= 0) {
-                    vertex_label.push_back(tmp_vertex_label[i]);
-                    vertex_used[i] = num_vertex++;
+            // the dataset vertices of the extracted hyperedges, in order of their new ids
+            std::vector<int> used_vertices;
+            if (D.hyperedges_by_signature.empty()) {
+                std::vector<int> new_id(D.vertex_label.size(), -1);
+                for (auto &e : hyperedges) {
+                    for (int v : e) new_id[v] = 0;
+                }
+                for (int v = 0; v < (int)new_id.size(); v++) {
+                    if (new_id[v] >= 0) {
+                        new_id[v] = used_vertices.size();
+                        used_vertices.push_back(v);
+                    }
+                }
+                for (auto &e : hyperedges) {
+                    for (int &v : e) v = new_id[v];
                 }
             }
-            for (int i = 0; i < hyperedges.size(); i++) {
-                for (int j = 0; j < hyperedges[i].size(); j++) {
-                    hyperedges[i][j] = vertex_used[hyperedges[i][j]];
+            else {
+                // sort instead of marking, so that extracting from an indexed dataset costs the size of the
+                // extracted part only
+                for (auto &e : hyperedges) used_vertices.insert(used_vertices.end(), e.begin(), e.end());
+                std::sort(used_vertices.begin(), used_vertices.end());
+                used_vertices.erase(std::unique(used_vertices.begin(), used_vertices.end()), used_vertices.end());
+                for (auto &e : hyperedges) {
+                    for (int &v : e) v = std::lower_bound(used_vertices.begin(), used_vertices.end(), v) -
+                                         used_vertices.begin();
                 }
             }
-            std::sort(hyperedges.begin(), hyperedges.end());
-            hyperedges.erase(std::unique(hyperedges.begin(), hyperedges.end()), hyperedges.end());
+            num_vertex = used_vertices.size();
+            for (int v : used_vertices) vertex_label.push_back(MappedLabel(v));
+            dataset_vertex_id = std::move(used_vertices);
+            // the dataset hyperedges are distinct and the renumbering keeps them so: sort, moving their ids along
+            std::vector<int> order(hyperedges.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](int a, int b) { return hyperedges[a] < hyperedges[b]; });
+            std::vector<std::vector<int>> sorted_hyperedges(hyperedges.size());
+            std::vector<int> sorted_ids(hyperedges.size());
+            for (size_t i = 0; i < order.size(); i++) {
+                sorted_hyperedges[i] = std::move(hyperedges[order[i]]);
+                sorted_ids[i] = dataset_hyperedge_id[order[i]];
+            }
+            hyperedges = std::move(sorted_hyperedges);
+            dataset_hyperedge_id = std::move(sorted_ids);
             num_edge = hyperedges.size();
             for (auto &E : hyperedges) {
                 hyperedge_signatures.push_back(std::vector<int>());
@@ -0,0 +1,178 @@
+#pragma once
+#include "SubhypergraphMatching/DataHyperGraph.h"
+#include "SubhypergraphMatching/PatternHyperGraph.h"
+#include "Base/Parallel.h"
+
+namespace GraphLib {
+    namespace SubHyperGraphMatching {
+    /**
+     * @brief Embedding counts of single-hyperedge and star patterns, straight from the label buckets
+     * @details An embedding is a label-preserving injective map of the pattern vertices that sends every pattern
+     * hyperedge onto a data hyperedge. Data hyperedges carry the label of their vertex label signature, so
+     * - a single hyperedge e is matched by every data hyperedge f of the same label, in prod_l (m_l(e))! ways;
+     * - a star with center c and petals e_1..e_k is matched, for each data vertex v of the label of c, by the
+     *   ordered tuples (f_1..f_k) of hyperedges incident to v with label(f_i) = label(e_i) that pairwise meet
+     *   only at v. The petal vertices other than c are then mapped in prod_i prod_l (m_l(e_i - c))! ways.
+     * If no two candidate hyperedges of v share a vertex besides v, the number of tuples is the product of
+     * falling factorials n_l (n_l - 1) ... (n_l - k_l + 1), where n_l candidates of label l fill k_l petals;
+     * otherwise the tuples are enumerated, and only the last petal is counted instead of listed.
+     */
+        class DirectCounter {
+            DataHyperGraph *data;
+            PatternHyperGraph *query;
+
+            struct Workspace {
+                // vertex_owner[x] : candidate hyperedge (+1) containing x, 0 if none, -1 if more than one
+                std::vector<int> vertex_owner, vertex_used;
+                std::vector<char> edge_used;
+                std::vector<std::vector<int>> candidates;
+            };
+            std::vector<Workspace> workspaces;
+
+            // number of label-preserving bijections between the vertices of e (minus skip) and a matching hyperedge
+            unsigned long long NumVertexBijections(int e, int skip = -1);
+            unsigned long long CountPetalTuples(Workspace &ws, int v, const std::vector<int> &petal_label,
+                                                int depth);
+        public:
+            DirectCounter(DataHyperGraph *data_, PatternHyperGraph *query_) : data(data_), query(query_) {};
+
+            unsigned long long CountSingleHyperedge();
+            unsigned long long CountStar(int center);
+
+            /**
+             * @brief Count the embeddings of a single-hyperedge or star query
+             * @return false if the query has another shape (count is left untouched)
+             */
+            bool Count(unsigned long long &count);
+        };
+
+        unsigned long long DirectCounter::NumVertexBijections(int e, int skip) {
+            std::vector<int> labels;
+            for (int u : query->GetHyperedge(e)) {
+                if (u != skip) labels.push_back(query->GetVertexLabel(u));
+            }
+            std::sort(labels.begin(), labels.end());
+            unsigned long long num_bijections = 1;
+            for (int i = 0, run = 0; i < (int)labels.size(); i++) {
+                run = (i > 0 and labels[i] == labels[i - 1]) ? run + 1 : 1;
+                num_bijections *= run;
+            }
+            return num_bijections;
+        }
+
+        unsigned long long DirectCounter::CountSingleHyperedge() {
+            int l = query->GetHyperedgeLabel(0);
+            if (l < 0 or l >= data->GetNumHyperedgeLabels()) return 0;
+            return data->GetHyperedgesByLabel(l).size() * NumVertexBijections(0);
+        }
+
+        unsigned long long DirectCounter::CountPetalTuples(Workspace &ws, int v, const std::vector<int> &petal_label,
+                                                           int depth) {
+            auto &cand = ws.candidates[petal_label[depth]];
+            bool last = (depth + 1 == (int)petal_label.size());
+            unsigned long long count = 0;
+            for (int f : cand) {
+                if (ws.edge_used[f]) continue;
+                bool disjoint = true;
+                for (int x : data->GetHyperedge(f)) {
+                    if (x != v and ws.vertex_used[x]) { disjoint = false; break; }
+                }
+                if (!disjoint) continue;
+                if (last) { count++; continue; }
+                ws.edge_used[f] = 1;
+                for (int x : data->GetHyperedge(f)) ws.vertex_used[x] = 1;
+                count += CountPetalTuples(ws, v, petal_label, depth + 1);
+                for (int x : data->GetHyperedge(f)) ws.vertex_used[x] = 0;
+                ws.edge_used[f] = 0;
+            }
+            return count;
+        }
+
+        unsigned long long DirectCounter::CountStar(int center) {
+            int center_label = query->GetVertexLabel(center);
+            if (center_label < 0 or center_label >= data->GetNumVertexLabels()) return 0;
+            std::vector<int> petal_label;
+            unsigned long long num_petal_bijections = 1;
+            for (int e = 0; e < query->GetNumHyperedges(); e++) {
+                int l = query->GetHyperedgeLabel(e);
+                if (l < 0 or l >= data->GetNumHyperedgeLabels()) return 0;
+                petal_label.push_back(l);
+                num_petal_bijections *= NumVertexBijections(e, center);
+            }
+            // petals of the same label are consecutive; num_petals_by_label[l] = k_l
+            std::sort(petal_label.begin(), petal_label.end());
+            std::vector<int> num_petals_by_label(data->GetNumHyperedgeLabels(), 0);
+            for (int l : petal_label) num_petals_by_label[l]++;
+
+            workspaces.resize(num_worker_threads);
+            std::vector<unsigned long long> thread_count(num_worker_threads, 0);
+            auto &roots = data->GetVerticesByLabel(center_label);
+            ParallelFor(0, roots.size(), [&](long long idx, int thread_id) {
+                int v = roots[idx];
+                auto &ws = workspaces[thread_id];
+                if (ws.vertex_owner.empty()) {
+                    ws.vertex_owner.assign(data->GetNumVertices(), 0);
+                    ws.vertex_used.assign(data->GetNumVertices(), 0);
+                    ws.edge_used.assign(data->GetNumHyperedges(), 0);
+                    ws.candidates.resize(data->GetNumHyperedgeLabels());
+                }
+                for (int f : data->GetIncidentHyperedges(v)) {
+                    int l = data->GetHyperedgeLabel(f);
+                    if (num_petals_by_label[l] > 0) ws.candidates[l].push_back(f);
+                }
+                bool enough = true, overlapping = false;
+                for (int i = 0; i < (int)petal_label.size(); i++) {
+                    if (i > 0 and petal_label[i] == petal_label[i - 1]) continue;
+                    auto &cand = ws.candidates[petal_label[i]];
+                    if ((int)cand.size() < num_petals_by_label[petal_label[i]]) enough = false;
+                    for (int f : cand) {
+                        for (int x : data->GetHyperedge(f)) {
+                            if (x == v) continue;
+                            if (ws.vertex_owner[x] != 0 and ws.vertex_owner[x] != f + 1) overlapping = true;
+                            ws.vertex_owner[x] = f + 1;
+                        }
+                    }
+                }
+                unsigned long long count = 0;
+                if (enough and !overlapping) {
+                    count = 1;
+                    for (int i = 0; i < (int)petal_label.size(); i++) {
+                        int j = i;
+                        while (j > 0 and petal_label[j - 1] == petal_label[i]) j--;
+                        count *= ws.candidates[petal_label[i]].size() - (i - j);
+                    }
+                }
+                else if (enough) {
+                    ws.vertex_used[v] = 1;
+                    count = CountPetalTuples(ws, v, petal_label, 0);
+                    ws.vertex_used[v] = 0;
+                }
+                thread_count[thread_id] += count;
+                for (int i = 0; i < (int)petal_label.size(); i++) {
+                    auto &cand = ws.candidates[petal_label[i]];
+                    for (int f : cand) {
+                        for (int x : data->GetHyperedge(f)) ws.vertex_owner[x] = 0;
+                    }
+                    cand.clear();
+                }
+            }, 256);
+            unsigned long long total = 0;
+            for (auto c : thread_count) total += c;
+            return total * num_petal_bijections;
+        }
+
+        bool DirectCounter::Count(unsigned long long &count) {
+            int center = -1;
+            switch (query->ClassifyShape(&center)) {
+                case SINGLE_HYPEREDGE_PATTERN:
+                    count = CountSingleHyperedge();
+                    return true;
+                case STAR_HYPERGRAPH_PATTERN:
+                    count = CountStar(center);
+                    return true;
+                default:
+                    return false;
+            }
+        }
+    }
+}
@@ -1,10 +1,26 @@
 #pragma once
 #include "SubhypergraphMatching/DataHyperGraph.h"
 #include "SubhypergraphMatching/PatternHyperGraph.h"
+#include "Base/Timer.h"
+#include "Base/RefinementStatistics.h"
 
 namespace GraphLib::SubHyperGraphMatching {
     struct SubHyperGraphMatchingOption{
+        // answer single-hyperedge and star queries by direct counting (DirectCounting.h), without the HCS
+        bool use_direct_counting = true;
+        // refuse to build a HCS whose estimated size (EstimateMemory) exceeds this, 0 for no limit
+        size_t max_memory_bytes = 0;
+    };
 
+    // rules by which RefineHCS removes a candidate; see HyperEdgeSafety and VertexSafety
+    enum HCS_REFINEMENT_RULE {
+        HYPEREDGE_ZERO_NEIGHBOR,
+        HYPEREDGE_LABEL_COUNT,
+        VERTEX_ZERO_NEIGHBOR,
+        VERTEX_LABEL_COUNT
+    };
+    const std::vector<std::string> hcs_refinement_rule_names = {
+        "hyperedge_zero_nbr", "hyperedge_label_count", "vertex_zero_nbr", "vertex_label_count"
     };
 
     class HyperCandidateSpace {
@@ -12,6 +28,8 @@ namespace GraphLib::SubHyperGraphMatching {
         SubHyperGraphMatchingOption opt;
         DataHyperGraph *data;
         PatternHyperGraph *query;
+        // if given, BuildInitialHCS keeps only these candidates of each query vertex
+        const std::vector<std::vector<int>> *initial_vertex_candidates = nullptr;
         std::vector<std::vector<int>> candidate_vertex_set_;
         std::vector<std::vector<int>> candidate_hyperedge_set_;
 
@@ -43,9 +61,33 @@ namespace GraphLib::SubHyperGraphMatching {
 
 
     public:
-        HyperCandidateSpace(DataHyperGraph *data_, PatternHyperGraph *query_, SubHyperGraphMatchingOption filter_option);
+        /**
+         * @param initial_vertex_candidates_ if given, the data vertices each query vertex may match (known from
+         * elsewhere, e.g. BatchFilter), used instead of every data vertex of its label
+         */
+        HyperCandidateSpace(DataHyperGraph *data_, PatternHyperGraph *query_, SubHyperGraphMatchingOption filter_option,
+                            const std::vector<std::vector<int>> *initial_vertex_candidates_ = nullptr);
         ~HyperCandidateSpace();
 
+        // milliseconds spent in BuildInitialHCS and RefineHCS, and the candidate set sizes after BuildInitialHCS
+        double initial_time = 0.0, refine_time = 0.0;
+        long long num_initial_candidate_vertices = 0, num_initial_candidate_hyperedges = 0;
+        long long GetNumCandidateVertices() const;
+        long long GetNumCandidateHyperedges() const;
+        // whether refinement emptied the candidate set of some query vertex or hyperedge: no embedding then
+        bool HasEmptyCandidateSet() const;
+        const std::vector<int> &GetCandidateVertices(int u) const { return candidate_vertex_set_[u]; }
+        const std::vector<int> &GetCandidateHyperedges(int e) const { return candidate_hyperedge_set_[e]; }
+        // removals per HCS_REFINEMENT_RULE and candidates (vertices + hyperedges) left per queue generation
+        RefinementStatistics refine_stats;
+
+        /**
+         * @brief Bytes that Initialize and BuildInitialHCS will allocate for this query and data, computed from
+         * their sizes only (nothing is allocated), so that the caller can refuse the query or switch modes.
+         */
+        static size_t EstimateMemory(DataHyperGraph *data, PatternHyperGraph *query);
+        void ReportMemory(MemoryReport &report, const std::string &prefix = "HCS") const;
+
         inline bool isVertexCandidate(int u, int v) const { return vertex_cs_index[u][v] >= 0; }
         inline bool isHyperedgeCandidate(int e, int f) const { return edge_cs_index[e][f] >= 0; }
         void BuildInitialHCS();
@@ -55,17 +97,23 @@ namespace GraphLib::SubHyperGraphMatching {
 
         void PrintCSStatistics(int level = 0);
 
-        bool HyperEdgeSafety(int e, int f);
-        bool VertexSafety(int u, int v);
+        /**
+         * @brief Whether hyperedge candidate (e, f) is kept; if not and rule is given, *rule is the violated
+         * HCS_REFINEMENT_RULE
+         */
+        bool HyperEdgeSafety(int e, int f, int *rule = nullptr);
+        bool VertexSafety(int u, int v, int *rule = nullptr);
 
         void RemoveHyperedge(int e, int f);
         void RemoveVertex(int u, int v);
     };
 
-    HyperCandidateSpace::HyperCandidateSpace(DataHyperGraph *data_, PatternHyperGraph *query_, SubHyperGraphMatchingOption filter_option) {
+    HyperCandidateSpace::HyperCandidateSpace(DataHyperGraph *data_, PatternHyperGraph *query_, SubHyperGraphMatchingOption filter_option,
+                                             const std::vector<std::vector<int>> *initial_vertex_candidates_) {
         opt = filter_option;
         data = data_;
         query = query_;
+        initial_vertex_candidates = initial_vertex_candidates_;
         Initialize();
         BuildHyperCandidateSpace();
     }
@@ -145,11 +193,84 @@ namespace GraphLib::SubHyperGraphMatching {
     }
 
     void HyperCandidateSpace::BuildHyperCandidateSpace() {
+        Timer phase_timer;
+        phase_timer.Start();
         BuildInitialHCS();
+        phase_timer.Stop();
+        initial_time = phase_timer.GetTime();
+        num_initial_candidate_vertices = GetNumCandidateVertices();
+        num_initial_candidate_hyperedges = GetNumCandidateHyperedges();
+
+        phase_timer = Timer();
+        phase_timer.Start();
         RefineHCS();
+        phase_timer.Stop();
+        refine_time = phase_timer.GetTime();
+    }
+
+    size_t HyperCandidateSpace::EstimateMemory(DataHyperGraph *data, PatternHyperGraph *query) {
+        const size_t VEC = sizeof(std::vector<int>), INT = sizeof(int);
+        size_t Vd = data->GetNumVertices(), Ed = data->GetNumHyperedges(), Ad = data->GetTotalArity();
+        size_t bytes = 0;
+        for (int u = 0; u < query->GetNumVertices(); u++) {
+            size_t num_cands = data->GetVerticesByLabel(query->GetVertexLabel(u)).size();
+            // vertex_cs_index, candidate_vertex_set_
+            bytes += 2 * VEC + Vd * INT + num_cands * INT;
+            // vertex_cand_nbr_count, vertex_incidence_count, vertex_label_nbr_count
+            bytes += 3 * VEC + Vd * (VEC + query->GetDegree(u) * INT);
+            bytes += Vd * VEC + Ad * INT;
+            bytes += Vd * (VEC + query->GetNumHyperedgeLabels() * INT);
+            // required_vertex_label_nbrs
+            bytes += VEC + query->GetNumHyperedgeLabels() * INT;
+        }
+        for (int e = 0; e < query->GetNumHyperedges(); e++) {
+            size_t num_cands = data->GetHyperedgesByLabel(query->GetHyperedgeLabel(e)).size();
+            // edge_cs_index, in_queue, candidate_hyperedge_set_
+            bytes += 3 * VEC + 2 * Ed * INT + num_cands * INT;
+            // hyperedge_cand_nbr_count, hyperedge_contained_count, hyperedge_label_nbr_count
+            bytes += 3 * VEC + Ed * (VEC + query->GetArity(e) * INT);
+            bytes += Ed * VEC + Ad * INT;
+            bytes += Ed * (VEC + query->GetNumVertexLabels() * INT);
+            // required_hyperedge_label_nbrs
+            bytes += VEC + query->GetNumVertexLabels() * INT;
+        }
+        return bytes;
+    }
+
+    void HyperCandidateSpace::ReportMemory(MemoryReport &report, const std::string &prefix) const {
+        report.Add(prefix + "/candidate_sets", MemoryBytes(candidate_vertex_set_) + MemoryBytes(candidate_hyperedge_set_));
+        report.AddVector(prefix + "/vertex_cs_index", vertex_cs_index);
+        report.AddVector(prefix + "/edge_cs_index", edge_cs_index);
+        report.AddVector(prefix + "/in_queue", in_queue);
+        report.AddVector(prefix + "/vertex_cand_nbr_count", vertex_cand_nbr_count);
+        report.AddVector(prefix + "/vertex_incidence_count", vertex_incidence_count);
+        report.AddVector(prefix + "/vertex_label_nbr_count", vertex_label_nbr_count);
+        report.AddVector(prefix + "/hyperedge_cand_nbr_count", hyperedge_cand_nbr_count);
+        report.AddVector(prefix + "/hyperedge_contained_count", hyperedge_contained_count);
+        report.AddVector(prefix + "/hyperedge_label_nbr_count", hyperedge_label_nbr_count);
+        report.Add(prefix + "/required_label_nbrs", MemoryBytes(required_vertex_label_nbrs) + MemoryBytes(required_hyperedge_label_nbrs));
+    }
+
+    long long HyperCandidateSpace::GetNumCandidateVertices() const {
+        long long num_vertices = 0;
+        for (auto &cands : candidate_vertex_set_) num_vertices += cands.size();
+        return num_vertices;
+    }
+
+    long long HyperCandidateSpace::GetNumCandidateHyperedges() const {
+        long long num_edges = 0;
+        for (auto &cands : candidate_hyperedge_set_) num_edges += cands.size();
+        return num_edges;
+    }
+
+    bool HyperCandidateSpace::HasEmptyCandidateSet() const {
+        for (auto &cands : candidate_vertex_set_) if (cands.empty()) return true;
+        for (auto &cands : candidate_hyperedge_set_) if (cands.empty()) return true;
+        return false;
     }
 
     void HyperCandidateSpace::BuildInitialHCS() {
+        PROFILE_SCOPE("BuildInitialHCS");
         for (int e = 0; e < query->GetNumHyperedges(); e++) {
             int query_hyperedge_label = query->GetHyperedgeLabel(e);
             for (int &f : data->GetHyperedgesByLabel(query_hyperedge_label)) {
@@ -157,9 +278,15 @@ namespace GraphLib::SubHyperGraphMatching {
                 candidate_hyperedge_set_[e].push_back(f);
             }
         }
+        std::vector<char> allowed;
         for (int u = 0; u < query->GetNumVertices(); u++) {
+            if (initial_vertex_candidates != nullptr) {
+                allowed.assign(data->GetNumVertices(), 0);
+                for (int v : (*initial_vertex_candidates)[u]) allowed[v] = 1;
+            }
             int query_vertex_label = query->GetVertexLabel(u);
             for (int &v : data->GetVerticesByLabel(query_vertex_label)) {
+                if (initial_vertex_candidates != nullptr and !allowed[v]) continue;
                 for (int &e : query->GetIncidentHyperedges(u)) {
                     bool ok = false;
                     for (int &f : data->GetIncidentHyperedges(v)) {
@@ -231,16 +358,18 @@ namespace GraphLib::SubHyperGraphMatching {
     }
 
 
-    bool HyperCandidateSpace::HyperEdgeSafety(int e, int f) {
+    bool HyperCandidateSpace::HyperEdgeSafety(int e, int f, int *rule) {
         for (int i = 0; i < query->GetArity(e); i++) {
             if (hyperedge_cand_nbr_count[e][f][i] == 0) {
 //                fprintf(stderr, "Remove Hyperedge (%d, %d) as there are no %dth nbr of %d\n",e,f,i,e);
+                if (rule != nullptr) *rule = HYPEREDGE_ZERO_NEIGHBOR;
                 return false;
             }
         }
         for (int l = 0; l < query->GetNumVertexLabels(); l++) {
             if (hyperedge_label_nbr_count[e][f][l] < required_hyperedge_label_nbrs[e][l]) {
 //                fprintf(stderr, "Remove Hyperedge (%d, %d) as there are only %d %d-nbrs while %d required\n",e,f,hyperedge_label_nbr_count[e][f][l],l,required_hyperedge_label_nbrs[e][l]);
+                if (rule != nullptr) *rule = HYPEREDGE_LABEL_COUNT;
                 return false;
             }
         }
@@ -255,10 +384,6 @@ namespace GraphLib::SubHyperGraphMatching {
 //            fprintf(stderr, "\n");
 //        }
 //        fprintf(stderr, "Remove HyperedgePair (%d, %d)\n",e,f);
-        if (candidate_hyperedge_set_[e].size() == 1) {
-            fprintf(stderr, "[ERROR] ??? HyperEdgeEmpty");
-            exit(-1);
-        }
         int idx = edge_cs_index[e][f];
         int last_hyperedge = candidate_hyperedge_set_[e].back();
         edge_cs_index[e][last_hyperedge] = idx;
@@ -283,16 +408,18 @@ namespace GraphLib::SubHyperGraphMatching {
     }
 
 
-    bool HyperCandidateSpace::VertexSafety(int u, int v) {
+    bool HyperCandidateSpace::VertexSafety(int u, int v, int *rule) {
         for (int i = 0; i < query->GetDegree(u); i++) {
             if (vertex_cand_nbr_count[u][v][i] == 0) {
 //                fprintf(stderr, "Remove Vertex (%d, %d) as there are no %dth nbr of %d\n",u,v,i,u);
+                if (rule != nullptr) *rule = VERTEX_ZERO_NEIGHBOR;
                 return false;
             }
         }
         for (int l = 0; l < query->GetNumHyperedgeLabels(); l++) {
             if (vertex_label_nbr_count[u][v][l] < required_vertex_label_nbrs[u][l]) {
 //                fprintf(stderr, "Remove Vertex (%d, %d) as there are only %d %d-nbrs while %d required\n",u,v,vertex_label_nbr_count[u][v][l],l,required_vertex_label_nbrs[u][l]);
+                if (rule != nullptr) *rule = VERTEX_LABEL_COUNT;
                 return false;
             }
         }
@@ -301,10 +428,6 @@ namespace GraphLib::SubHyperGraphMatching {
 
     void HyperCandidateSpace::RemoveVertex(int u, int v) {
 //        fprintf(stderr, "Remove VertexPair (%d, %d)\n",u,v);
-        if (candidate_vertex_set_[u].size() == 1) {
-            fprintf(stderr, "[ERROR] ??? VertexEmpty (%d, %d)\n", u, v);
-            exit(-1);
-        }
         int idx = vertex_cs_index[u][v];
         int last_vertex = candidate_vertex_set_[u].back();
         vertex_cs_index[u][last_vertex] = idx;
@@ -329,29 +452,42 @@ namespace GraphLib::SubHyperGraphMatching {
     }
 
     void HyperCandidateSpace::RefineHCS() {
+        PROFILE_SCOPE("RefineHCS");
+        refine_stats.Start(hcs_refinement_rule_names, GetNumCandidateVertices() + GetNumCandidateHyperedges());
         std::queue<std::pair<int, int>> refinement_queue;
         for (int e = 0; e < query->GetNumHyperedges(); e++) {
             for (int f : candidate_hyperedge_set_[e]) {
                 refinement_queue.emplace(e, f);
                 in_queue[e][f] = true;
+                refine_stats.Push();
             }
         }
+        // the current generation of the queue ends at this many pops
+        long long round_end = refinement_queue.size();
+        long long num_candidates = refine_stats.initial_candidates;
+        int rule = -1;
         while (!refinement_queue.empty()) {
             auto [e, f] = refinement_queue.front();
             refinement_queue.pop();
             in_queue[e][f] = false;
-            if (!HyperEdgeSafety(e, f)) {
+            refine_stats.Pop();
+            if (!HyperEdgeSafety(e, f, &rule)) {
                 RemoveHyperedge(e, f);
+                refine_stats.Remove(rule);
+                num_candidates--;
                 for (auto u : query->GetHyperedge(e)) {
                     for (auto v : data->GetHyperedge(f)) {
                         if (isVertexCandidate(u, v)) {
-                            if (!VertexSafety(u, v)) {
+                            if (!VertexSafety(u, v, &rule)) {
                                 RemoveVertex(u, v);
+                                refine_stats.Remove(rule);
+                                num_candidates--;
                                 for (auto ec : query->GetIncidentHyperedges(u)) {
                                     for (auto fc : data->GetIncidentHyperedges(v)) {
                                         if (isHyperedgeCandidate(ec, fc) and (in_queue[ec][fc] == 0)) {
                                             refinement_queue.emplace(ec, fc);
                                             in_queue[ec][fc] = true;
+                                            refine_stats.Push();
                                         }
                                     }
                                 }
@@ -360,7 +496,12 @@ namespace GraphLib::SubHyperGraphMatching {
                     }
                 }
             }
+            if (refine_stats.queue_pops == round_end) {
+                refine_stats.EndRound(num_candidates);
+                round_end += refinement_queue.size();
+            }
         }
         PrintCSStatistics(0);
+        refine_stats.Print(log_to, "RefineHCS");
     }
 }
\ No newline at end of file
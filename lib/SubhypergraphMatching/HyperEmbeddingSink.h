@@ -0,0 +1,58 @@
+#pragma once
+#include "Base/EmbeddingSink.h"
+#include "SubhypergraphMatching/DataHyperGraph.h"
+
+namespace GraphLib::SubHyperGraphMatching {
+    /**
+     * @brief Sink for the backtracking over the bipartite representations (HyperGraph::BipartiteRepresentation) of
+     * a query and its data hypergraph: turns each embedding of the bipartite query into the dataset vertices and
+     * hyperedges it matches (GetDatasetVertexId, GetDatasetHyperedgeId), handed to out
+     * @details Bipartite vertices 0..|V|-1 are the vertices of the hypergraph and |V|+i is its hyperedge i, in the
+     * query as in the data, so factorized results keep their free elements and only their ids are mapped. Finish
+     * is not forwarded: the owner of out finishes it.
+     */
+    class HyperEmbeddingSink : public EmbeddingSink {
+        EmbeddingSink &out;
+        const DataHyperGraph &data;
+        int num_query_vertices, num_data_vertices;
+        std::vector<int> vertices, hyperedges, candidates;
+
+        int DatasetId(int query_element, int data_element) const {
+            if (data_element == -1) return -1;
+            if (query_element < num_query_vertices) return data.GetDatasetVertexId(data_element);
+            return data.GetDatasetHyperedgeId(data_element - num_data_vertices);
+        }
+    public:
+        HyperEmbeddingSink(EmbeddingSink &out_, DataHyperGraph &data_, int num_query_vertices_,
+                           int num_query_hyperedges)
+            : out(out_), data(data_), num_query_vertices(num_query_vertices_),
+              num_data_vertices(data_.GetNumVertices()), vertices(num_query_vertices_),
+              hyperedges(num_query_hyperedges) {};
+
+        bool Consume(const EmbeddingView &embedding) override {
+            for (int u = 0; u < num_query_vertices; u++) vertices[u] = DatasetId(u, embedding.vertices[u]);
+            for (int e = 0; e < (int)hyperedges.size(); e++) {
+                hyperedges[e] = DatasetId(num_query_vertices + e, embedding.vertices[num_query_vertices + e]);
+            }
+            return out.Consume({vertices, hyperedges});
+        }
+        bool Factorized() const override { return out.Factorized(); }
+        bool ConsumeFactorized(const FactorizedEmbedding &embeddings) override {
+            for (int u = 0; u < num_query_vertices; u++) vertices[u] = DatasetId(u, embeddings.vertices[u]);
+            for (int e = 0; e < (int)hyperedges.size(); e++) {
+                hyperedges[e] = DatasetId(num_query_vertices + e, embeddings.vertices[num_query_vertices + e]);
+            }
+            candidates.resize(embeddings.candidates.size());
+            for (size_t i = 0; i < embeddings.free.size(); i++) {
+                for (int c = embeddings.candidate_offsets[i]; c < embeddings.candidate_offsets[i + 1]; c++) {
+                    candidates[c] = DatasetId(embeddings.free[i], embeddings.candidates[c]);
+                }
+            }
+            FactorizedEmbedding mapped = embeddings;
+            mapped.vertices = vertices;
+            mapped.hyperedges = hyperedges;
+            mapped.candidates = candidates;
+            return out.ConsumeFactorized(mapped);
+        }
+    };
+}
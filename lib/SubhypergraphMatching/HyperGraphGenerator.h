@@ -0,0 +1,217 @@
+#pragma once
+#include <charconv>
+#include <climits>
+#include <numeric>
+#include <filesystem>
+#include "SubhypergraphMatching/DataHyperGraph.h"
+#include "Base/Parallel.h"
+#include "Base/Random.h"
+#include "Base/Timer.h"
+
+namespace GraphLib::SubHyperGraphMatching {
+    struct HyperGraphGeneratorOption {
+        // vertices are ints: num_vertices plus the planted motif vertices must not exceed INT_MAX
+        long long num_vertices = 1000000;
+        long long num_hyperedges = 1000000;
+        // arity = min_arity + Zipf(arity_skew) over [0, max_arity - min_arity]
+        int min_arity = 2, max_arity = 25;
+        double arity_skew = 2.0;
+        // vertex popularity ~ 1 / rank^degree_skew, so that degrees follow a power law of exponent 1 + 1/degree_skew
+        double degree_skew = 0.8;
+        // vertex labels ~ Zipf(label_skew) over [0, num_labels)
+        int num_labels = 8;
+        double label_skew = 1.0;
+        // copies of the planted motif (SetPlantedMotif), each on its own fresh vertices
+        long long num_planted = 0;
+        unsigned long long seed = 1;
+    };
+
+    /**
+     * @brief Reproducible synthetic labeled hypergraphs, written in Benson's format (as read by HyperGraphDataset)
+     * @details Hyperedges are generated in fixed-size chunks, each from its own stream derived from the seed, and
+     * labels per vertex; chunks are generated in parallel and written in order, so the output depends only on the
+     * options (not on the number of threads) and billions of incidences can be streamed to disk in O(chunk)
+     * memory. Background vertices get ids through a bijection of their popularity rank, so that popular vertices
+     * are spread over the id space. Planted motif copies use the vertices after the background ones, labeled as
+     * in the motif; background hyperedges can touch them too.
+     */
+    class HyperGraphGenerator {
+        HyperGraphGeneratorOption opt;
+        std::vector<int> motif_labels;
+        std::vector<std::vector<int>> motif_hyperedges;
+        // popularity rank r is vertex (r * rank_multiplier) mod num_vertices, a bijection
+        unsigned long long rank_multiplier = 1;
+        static constexpr long long CHUNK_SIZE = 1 << 16;
+
+        long long GetNumBackgroundChunks() const { return (opt.num_hyperedges + CHUNK_SIZE - 1) / CHUNK_SIZE; }
+        template <typename Emit>
+        void GenerateChunk(long long chunk, Emit &&emit) const;
+        // run fill(chunk, buffer) for every chunk in parallel waves, writing the buffers to fp in chunk order
+        template <typename Fill>
+        void WriteChunks(FILE *fp, long long num_chunks, Fill &&fill) const;
+    public:
+        explicit HyperGraphGenerator(const HyperGraphGeneratorOption &opt_);
+
+        /**
+         * @brief Motif to plant opt.num_planted times: labels (in the dataset's 0-based label space) and hyperedges
+         * over 0..labels.size()-1, e.g. as in a query file
+         */
+        void SetPlantedMotif(const std::vector<int> &labels, const std::vector<std::vector<int>> &hyperedges);
+
+        long long GetNumVertices() const { return opt.num_vertices + opt.num_planted * (long long)motif_labels.size(); }
+        long long GetNumHyperedges() const {
+            return opt.num_hyperedges + opt.num_planted * (long long)motif_hyperedges.size();
+        }
+        int GetVertexLabel(long long v) const;
+
+        /**
+         * @brief Write path/dataset/hyperedges-dataset.txt and node-labels-dataset.txt
+         * @return total arity of the written hyperedges
+         */
+        long long Write(const std::string &dataset, const std::string &path) const;
+
+        /**
+         * @brief Generate into memory (same hyperedges as Write, sorted and deduplicated as by HyperGraphDataset::Load)
+         */
+        void Generate(HyperGraphDataset &D, const std::string &dataset = "synthetic") const;
+    };
+
+    HyperGraphGenerator::HyperGraphGenerator(const HyperGraphGeneratorOption &opt_) : opt(opt_) {
+        opt.num_vertices = std::max(1LL, opt.num_vertices);
+        opt.min_arity = std::max(2, opt.min_arity);
+        opt.max_arity = std::max(opt.min_arity, opt.max_arity);
+        opt.num_labels = std::max(1, opt.num_labels);
+        if (opt.num_vertices > INT_MAX) {
+            fprintf(stderr, "HyperGraphGenerator: at most %d vertices are supported\n", INT_MAX);
+            exit(1);
+        }
+        rank_multiplier = 0x9E3779B1ULL % opt.num_vertices;
+        while (std::gcd(rank_multiplier, (unsigned long long)opt.num_vertices) != 1) rank_multiplier++;
+    }
+
+    void HyperGraphGenerator::SetPlantedMotif(const std::vector<int> &labels,
+                                              const std::vector<std::vector<int>> &hyperedges) {
+        motif_labels = labels;
+        motif_hyperedges = hyperedges;
+        if (GetNumVertices() > INT_MAX) {
+            fprintf(stderr, "HyperGraphGenerator: %lld vertices with the planted motifs, at most %d are supported\n",
+                    GetNumVertices(), INT_MAX);
+            exit(1);
+        }
+    }
+
+    int HyperGraphGenerator::GetVertexLabel(long long v) const {
+        if (v >= opt.num_vertices) return motif_labels[(v - opt.num_vertices) % motif_labels.size()];
+        SplitMix64 rng(SplitMix64::StreamSeed(opt.seed, 2 * v + 1));
+        return ZipfDistribution(opt.num_labels, opt.label_skew)(rng);
+    }
+
+    template <typename Emit>
+    void HyperGraphGenerator::GenerateChunk(long long chunk, Emit &&emit) const {
+        std::vector<int> e;
+        if (chunk == GetNumBackgroundChunks()) {
+            for (long long copy = 0; copy < opt.num_planted; copy++) {
+                long long offset = opt.num_vertices + copy * (long long)motif_labels.size();
+                for (auto &motif_edge : motif_hyperedges) {
+                    e.clear();
+                    for (int u : motif_edge) e.push_back((int)(offset + u));
+                    emit(e);
+                }
+            }
+            return;
+        }
+        SplitMix64 rng(SplitMix64::StreamSeed(opt.seed, 2 * chunk));
+        ZipfDistribution member(opt.num_vertices, opt.degree_skew);
+        ZipfDistribution arity(opt.max_arity - opt.min_arity + 1, opt.arity_skew);
+        long long end = std::min(opt.num_hyperedges, (chunk + 1) * CHUNK_SIZE);
+        for (long long i = chunk * CHUNK_SIZE; i < end; i++) {
+            long long a = std::min(opt.min_arity + arity(rng), opt.num_vertices);
+            e.clear();
+            while ((long long)e.size() < a) {
+                // below num_vertices <= INT_MAX
+                int v = (int)((unsigned __int128)member(rng) * rank_multiplier % opt.num_vertices);
+                if (std::find(e.begin(), e.end(), v) == e.end()) e.push_back(v);
+            }
+            emit(e);
+        }
+    }
+
+    template <typename Fill>
+    void HyperGraphGenerator::WriteChunks(FILE *fp, long long num_chunks, Fill &&fill) const {
+        long long wave = 4LL * num_worker_threads;
+        std::vector<std::string> buffers(wave);
+        for (long long first = 0; first < num_chunks; first += wave) {
+            long long last = std::min(num_chunks, first + wave);
+            ParallelFor(first, last, [&](long long chunk, int) {
+                buffers[chunk - first].clear();
+                fill(chunk, buffers[chunk - first]);
+            }, 1);
+            for (long long chunk = first; chunk < last; chunk++) {
+                auto &buffer = buffers[chunk - first];
+                if (fwrite(buffer.data(), 1, buffer.size(), fp) != buffer.size()) {
+                    fprintf(stderr, "HyperGraphGenerator: write failed\n");
+                    exit(1);
+                }
+            }
+        }
+    }
+
+    long long HyperGraphGenerator::Write(const std::string &dataset, const std::string &path) const {
+        PROFILE_SCOPE("GenerateHyperGraph");
+        std::string dir = path + "/" + dataset;
+        std::filesystem::create_directories(dir);
+        std::string hyperedge_file = dir + "/hyperedges-" + dataset + ".txt";
+        std::string vertex_label_file = dir + "/node-labels-" + dataset + ".txt";
+        auto AppendInt = [](std::string &buffer, long long x, char delimiter) {
+            char digits[24];
+            auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), x);
+            buffer.append(digits, end);
+            buffer.push_back(delimiter);
+        };
+
+        FILE *fp = fopen(vertex_label_file.c_str(), "w");
+        if (fp == nullptr) {
+            fprintf(stderr, "Cannot open %s\n", vertex_label_file.c_str());
+            exit(1);
+        }
+        long long num_vertices = GetNumVertices();
+        WriteChunks(fp, (num_vertices + CHUNK_SIZE - 1) / CHUNK_SIZE, [&](long long chunk, std::string &buffer) {
+            long long end = std::min(num_vertices, (chunk + 1) * CHUNK_SIZE);
+            for (long long v = chunk * CHUNK_SIZE; v < end; v++) AppendInt(buffer, GetVertexLabel(v) + 1, '\n');
+        });
+        fclose(fp);
+
+        fp = fopen(hyperedge_file.c_str(), "w");
+        if (fp == nullptr) {
+            fprintf(stderr, "Cannot open %s\n", hyperedge_file.c_str());
+            exit(1);
+        }
+        std::vector<long long> chunk_arity(GetNumBackgroundChunks() + 1, 0);
+        WriteChunks(fp, GetNumBackgroundChunks() + 1, [&](long long chunk, std::string &buffer) {
+            GenerateChunk(chunk, [&](const std::vector<int> &e) {
+                for (size_t i = 0; i < e.size(); i++) AppendInt(buffer, e[i] + 1, i + 1 < e.size() ? ',' : '\n');
+                chunk_arity[chunk] += e.size();
+            });
+        });
+        fclose(fp);
+        long long total_arity = 0;
+        for (long long a : chunk_arity) total_arity += a;
+        return total_arity;
+    }
+
+    void HyperGraphGenerator::Generate(HyperGraphDataset &D, const std::string &dataset) const {
+        D.name = dataset;
+        D.vertex_label.resize(GetNumVertices());
+        for (long long v = 0; v < GetNumVertices(); v++) D.vertex_label[v] = GetVertexLabel(v);
+        D.hyperedges.clear();
+        for (long long chunk = 0; chunk <= GetNumBackgroundChunks(); chunk++) {
+            GenerateChunk(chunk, [&](const std::vector<int> &e) {
+                D.hyperedges.push_back(e);
+                std::sort(D.hyperedges.back().begin(), D.hyperedges.back().end());
+            });
+        }
+        std::sort(D.hyperedges.begin(), D.hyperedges.end());
+        D.hyperedges.erase(std::unique(D.hyperedges.begin(), D.hyperedges.end()), D.hyperedges.end());
+        D.ComputeVersion();
+    }
+}
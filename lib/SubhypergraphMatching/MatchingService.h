@@ -0,0 +1,408 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <sstream>
+#include "SubhypergraphMatching/DataHyperGraph.h"
+#include "SubhypergraphMatching/PatternHyperGraph.h"
+#include "SubhypergraphMatching/HyperCandidateSpace.h"
+#include "SubhypergraphMatching/DirectCounting.h"
+#include "SubhypergraphMatching/HyperEmbeddingSink.h"
+#include "SubgraphMatching/DataGraph.h"
+#include "SubgraphMatching/PatternGraph.h"
+#include "SubgraphMatching/CandidateSpace.h"
+#include "SubgraphMatching/CandidateFilter.h"
+#include "SubgraphMatching/Backtrack.h"
+#include "Base/LRUCache.h"
+#include "Base/Timer.h"
+
+namespace GraphLib::SubHyperGraphMatching {
+    struct MatchingServiceOption {
+        SubHyperGraphMatchingOption matching;
+        // options of the backtracking over the bipartite representation; bounds the query sizes it accepts
+        SubgraphMatching::SubgraphMatchingOption backtrack;
+        // count the queries that are not counted directly, by backtracking over the bipartite representation
+        bool enumerate = true;
+        int max_query_vertices = 300;
+        // number of answers kept by canonical form of the query (0 for no cache)
+        size_t cache_capacity = 0;
+        // also keep the data hypergraph and refined HCS of the cached queries that reached the HCS, which
+        // Enumerate then backtracks over for the isomorphic queries instead of building them again
+        bool cache_candidate_space = false;
+    };
+
+    /**
+     * @brief Outcome of one query: status is "ok", "too_large" (over the query size limits), "memory_limit" (HCS
+     * over opt.matching.max_memory_bytes), "error" (malformed query, see message), or the reason the backtracking
+     * stopped at a limit of opt.backtrack ("match_limit", "node_limit", "time_limit", "cancelled"; see
+     * SubgraphMatching::search_status_names), num_embeddings then counting the embeddings found so far
+     */
+    struct QueryAnswer {
+        std::string status = "ok", message;
+        // "direct", "hcs" (HCS only, enumeration disabled), "backtrack" or "empty_hcs" (refined to no candidate)
+        std::string method = "none";
+        long long num_embeddings = -1;
+        int num_query_vertices = 0, num_query_hyperedges = 0;
+        long long num_data_vertices = 0, num_data_hyperedges = 0;
+        double extract_ms = 0.0, filter_ms = 0.0, refine_ms = 0.0, enumerate_ms = 0.0, total_ms = 0.0;
+        // answered from the cache: the phase times are those of the query that filled it, total_ms is the lookup
+        bool cached = false;
+    };
+
+    /**
+     * @brief Cached answer of a query, shared by every query isomorphic to it
+     * @details With MatchingServiceOption::cache_candidate_space, also the pattern, data hypergraph and refined
+     * HCS it was answered with. Vertex u of another query with the same code corresponds to the vertex of pattern
+     * with the same canonical position (PatternHyperGraph::GetCanonicalCode), which MatchingService::Enumerate
+     * uses to hand over the embeddings of pattern as those of that query.
+     */
+    struct CachedQuery {
+        QueryAnswer answer;
+        std::unique_ptr<PatternHyperGraph> pattern;
+        std::unique_ptr<DataHyperGraph> data;
+        std::unique_ptr<HyperCandidateSpace> candidate_space;
+        std::vector<int> canonical_vertex_id;
+    };
+
+    /**
+     * @brief Sink handing the embeddings of a cached pattern to out as those of an isomorphic query: vertex u of
+     * the query is vertex vertex_map[u] of the pattern, and hyperedge e of the query its hyperedge hyperedge_map[e]
+     * @details Factorized results are expanded first (Factorized() is false), their free elements being numbered
+     * as in the pattern. Finish is not forwarded: the owner of out finishes it.
+     */
+    class RenumberingSink : public EmbeddingSink {
+        EmbeddingSink &out;
+        const std::vector<int> &vertex_map, &hyperedge_map;
+        std::vector<int> vertices, hyperedges;
+    public:
+        RenumberingSink(EmbeddingSink &out_, const std::vector<int> &vertex_map_,
+                        const std::vector<int> &hyperedge_map_)
+            : out(out_), vertex_map(vertex_map_), hyperedge_map(hyperedge_map_), vertices(vertex_map_.size()),
+              hyperedges(hyperedge_map_.size()) {};
+
+        bool Consume(const EmbeddingView &embedding) override {
+            for (size_t u = 0; u < vertices.size(); u++) vertices[u] = embedding.vertices[vertex_map[u]];
+            for (size_t e = 0; e < hyperedges.size(); e++) hyperedges[e] = embedding.hyperedges[hyperedge_map[e]];
+            return out.Consume({vertices, hyperedges});
+        }
+    };
+
+    /**
+     * @brief Answers queries against one resident dataset, as RunQuery of the subhypergraph-matching driver does
+     * @details Answer only reads the dataset, so any number of threads may call it concurrently; every query
+     * builds its own DataHyperGraph and candidate space. Build the signature index of the dataset
+     * (HyperGraphDataset::BuildSignatureIndex) first, so that extracting the data graph of a query does not scan
+     * the whole dataset.
+     * With opt.cache_capacity > 0, answers are cached by (dataset version, options, canonical code of the query),
+     * so a query isomorphic to a recent one (same shape and labels, any numbering) is answered by one lookup.
+     */
+    class MatchingService {
+        const HyperGraphDataset &data;
+        MatchingServiceOption opt;
+        // the part of the cache key shared by every query: dataset version and the options the answer depends on
+        std::string key_prefix;
+        mutable LRUCache<std::string, std::shared_ptr<const CachedQuery>> cache;
+
+        // false, with the status and message of answer set, if the query cannot be answered
+        bool CheckQuery(const std::vector<int> &labels, const std::vector<std::vector<int>> &hyperedges,
+                        QueryAnswer &answer) const;
+        // cache key of the query PG, with the canonical position of each of its vertices
+        std::string CacheKey(const PatternHyperGraph &PG, std::vector<int> &canonical_vertex_id) const;
+        QueryAnswer Compute(std::unique_ptr<PatternHyperGraph> PG, CachedQuery *entry,
+                            const SubgraphMatching::SubgraphMatchingOption &backtrack_opt,
+                            EmbeddingSink *sink = nullptr) const;
+        QueryAnswer EnumerateCached(PatternHyperGraph &PG, const std::vector<int> &canonical_vertex_id,
+                                    const CachedQuery &entry,
+                                    const SubgraphMatching::SubgraphMatchingOption &backtrack_opt,
+                                    EmbeddingSink &sink) const;
+        // backtrack over the bipartite representations of PG and HG, which it only reads; sets the method, count
+        // and enumeration time of answer and returns its status, with message
+        std::string Backtrack(PatternHyperGraph &PG, DataHyperGraph &HG,
+                              const SubgraphMatching::SubgraphMatchingOption &backtrack_opt, EmbeddingSink *sink,
+                              QueryAnswer &answer, std::string &message) const;
+    public:
+        MatchingService(const HyperGraphDataset &data_, const MatchingServiceOption &opt_);
+
+        /**
+         * @brief Count the embeddings of the query with vertex labels (dataset label space) and hyperedges over
+         * 0..labels.size()-1
+         * @param entry if given and the answer is cached, receives the cache entry (see CachedQuery)
+         */
+        QueryAnswer Answer(const std::vector<int> &labels, const std::vector<std::vector<int>> &hyperedges,
+                           std::shared_ptr<const CachedQuery> *entry = nullptr) const;
+        /**
+         * @brief Hand every embedding of the query to sink, as the dataset vertex matched to each query vertex and
+         * the dataset hyperedge (index in HyperGraphDataset::hyperedges) matched to each hyperedge of the pattern
+         * (PatternHyperGraph order: sorted, without duplicates), then call sink.Finish()
+         * @details DirectCounter is not used, and the cache only with opt.cache_candidate_space: a query
+         * isomorphic to a cached one that reached the HCS backtracks over its data hypergraph (answer.cached, with
+         * the phase times of this search only), and nothing is cached. num_embeddings of the answer counts the embeddings
+         * handed over, fewer than all of them if the sink stopped the search (status "ok") or a limit of
+         * opt.backtrack did (status tells which).
+         * @param max_num_matches if not negative, replaces opt.backtrack.max_num_matches for this query
+         * @param cancel if given, replaces opt.backtrack.cancel for this query (e.g. EmbeddingChannel::CancelFlag)
+         */
+        QueryAnswer Enumerate(const std::vector<int> &labels, const std::vector<std::vector<int>> &hyperedges,
+                              EmbeddingSink &sink, long long max_num_matches = -1,
+                              const std::atomic<bool> *cancel = nullptr) const;
+        const LRUCache<std::string, std::shared_ptr<const CachedQuery>> &GetCache() const { return cache; }
+    };
+
+    MatchingService::MatchingService(const HyperGraphDataset &data_, const MatchingServiceOption &opt_)
+        : data(data_), opt(opt_), cache(opt_.cache_capacity) {
+        std::ostringstream prefix;
+        prefix << data.version << ' ' << opt.matching.use_direct_counting << ' ' << opt.matching.max_memory_bytes
+               << ' ' << opt.enumerate << ' ' << opt.max_query_vertices << ' ' << opt.backtrack.MAX_QUERY_VERTEX
+               << ' ' << opt.backtrack.MAX_QUERY_EDGE << ' ' << opt.backtrack.max_num_matches << ' '
+               << opt.backtrack.max_search_nodes << ' ' << opt.cache_candidate_space << ':';
+        key_prefix = prefix.str();
+    }
+
+    std::string MatchingService::CacheKey(const PatternHyperGraph &PG, std::vector<int> &canonical_vertex_id) const {
+        std::vector<int> code;
+        PG.GetCanonicalCode(code, &canonical_vertex_id);
+        std::string key = key_prefix;
+        key.append(reinterpret_cast<const char *>(code.data()), code.size() * sizeof(int));
+        return key;
+    }
+
+    QueryAnswer MatchingService::Answer(const std::vector<int> &labels,
+                                        const std::vector<std::vector<int>> &hyperedges,
+                                        std::shared_ptr<const CachedQuery> *entry) const {
+        PROFILE_SCOPE("Answer");
+        QueryAnswer answer;
+        Timer total_timer;
+        total_timer.Start();
+        auto Finish = [&](const std::string &status, const std::string &message) {
+            answer.status = status;
+            answer.message = message;
+            total_timer.Stop();
+            answer.total_ms = total_timer.GetTime();
+            return answer;
+        };
+        if (!CheckQuery(labels, hyperedges, answer)) return Finish(answer.status, answer.message);
+
+        auto PG = std::make_unique<PatternHyperGraph>();
+        PG->LoadPatternHyperGraph(labels, hyperedges);
+        if (opt.cache_capacity == 0) {
+            answer = Compute(std::move(PG), nullptr, opt.backtrack);
+            total_timer.Stop();
+            answer.total_ms = total_timer.GetTime();
+            return answer;
+        }
+
+        auto computed = std::make_shared<CachedQuery>();
+        std::string key = CacheKey(*PG, computed->canonical_vertex_id);
+        std::shared_ptr<const CachedQuery> hit;
+        if (cache.Get(key, hit)) {
+            answer = hit->answer;
+            answer.cached = true;
+            if (entry != nullptr) *entry = hit;
+            total_timer.Stop();
+            answer.total_ms = total_timer.GetTime();
+            return answer;
+        }
+        // isomorphic queries missing at the same time are all computed; the last one stays cached
+        answer = Compute(std::move(PG), computed.get(), opt.backtrack);
+        total_timer.Stop();
+        answer.total_ms = total_timer.GetTime();
+        computed->answer = answer;
+        // a search stopped by the clock or a cancellation may go further next time
+        if (answer.status != "error" and answer.status != "time_limit" and answer.status != "cancelled") {
+            cache.Put(key, computed);
+            if (entry != nullptr) *entry = computed;
+        }
+        return answer;
+    }
+
+    QueryAnswer MatchingService::Enumerate(const std::vector<int> &labels,
+                                           const std::vector<std::vector<int>> &hyperedges,
+                                           EmbeddingSink &sink, long long max_num_matches,
+                                           const std::atomic<bool> *cancel) const {
+        PROFILE_SCOPE("Answer");
+        QueryAnswer answer;
+        Timer total_timer;
+        total_timer.Start();
+        if (CheckQuery(labels, hyperedges, answer)) {
+            auto PG = std::make_unique<PatternHyperGraph>();
+            PG->LoadPatternHyperGraph(labels, hyperedges);
+            SubgraphMatching::SubgraphMatchingOption backtrack_opt = opt.backtrack;
+            if (max_num_matches >= 0) backtrack_opt.max_num_matches = max_num_matches;
+            if (cancel != nullptr) backtrack_opt.cancel = cancel;
+            std::vector<int> canonical_vertex_id;
+            std::shared_ptr<const CachedQuery> hit;
+            if (opt.cache_capacity > 0 and opt.cache_candidate_space and
+                cache.Get(CacheKey(*PG, canonical_vertex_id), hit) and hit->candidate_space != nullptr) {
+                answer = EnumerateCached(*PG, canonical_vertex_id, *hit, backtrack_opt, sink);
+            }
+            else answer = Compute(std::move(PG), nullptr, backtrack_opt, &sink);
+        }
+        sink.Finish();
+        total_timer.Stop();
+        answer.total_ms = total_timer.GetTime();
+        return answer;
+    }
+
+    bool MatchingService::CheckQuery(const std::vector<int> &labels, const std::vector<std::vector<int>> &hyperedges,
+                                     QueryAnswer &answer) const {
+        auto Fail = [&](const std::string &status, const std::string &message) {
+            answer.status = status;
+            answer.message = message;
+            return false;
+        };
+        if (hyperedges.empty()) return Fail("error", "query has no hyperedge");
+        for (auto &e : hyperedges) {
+            for (int u : e) {
+                if (u < 0 or u >= (int)labels.size()) return Fail("error", "hyperedge vertex out of range");
+            }
+        }
+        if ((int)labels.size() >= opt.max_query_vertices) return Fail("too_large", "too many query vertices");
+        return true;
+    }
+
+    /**
+     * @brief Answer the validated query PG; if entry is given and opt.cache_candidate_space, move the pattern,
+     * data hypergraph and HCS there. With a sink, enumerate the embeddings into it instead of counting them.
+     */
+    QueryAnswer MatchingService::Compute(std::unique_ptr<PatternHyperGraph> PG, CachedQuery *entry,
+                                         const SubgraphMatching::SubgraphMatchingOption &backtrack_opt,
+                                         EmbeddingSink *sink) const {
+        QueryAnswer answer;
+        Timer total_timer;
+        total_timer.Start();
+        std::unique_ptr<DataHyperGraph> HG;
+        std::unique_ptr<HyperCandidateSpace> HCS;
+        auto Finish = [&](const std::string &status, const std::string &message) {
+            answer.status = status;
+            answer.message = message;
+            total_timer.Stop();
+            answer.total_ms = total_timer.GetTime();
+            if (entry != nullptr and opt.cache_candidate_space and HCS != nullptr) {
+                entry->pattern = std::move(PG);
+                entry->data = std::move(HG);
+                entry->candidate_space = std::move(HCS);
+            }
+            return answer;
+        };
+        answer.num_query_vertices = PG->GetNumVertices();
+        answer.num_query_hyperedges = PG->GetNumHyperedges();
+        Timer timer;
+        timer.Start();
+        HG = std::make_unique<DataHyperGraph>();
+        HG->BuildFromDataset(data, *PG);
+        timer.Stop();
+        answer.extract_ms = timer.GetTime();
+        answer.num_data_vertices = HG->GetNumVertices();
+        answer.num_data_hyperedges = HG->GetNumHyperedges();
+
+        if (opt.matching.use_direct_counting and sink == nullptr) {
+            unsigned long long count = 0;
+            timer = Timer();
+            timer.Start();
+            DirectCounter counter(HG.get(), PG.get());
+            bool counted = counter.Count(count);
+            timer.Stop();
+            if (counted) {
+                answer.method = "direct";
+                answer.num_embeddings = count;
+                answer.enumerate_ms = timer.GetTime();
+                return Finish("ok", "");
+            }
+        }
+        if (opt.matching.max_memory_bytes > 0 and
+            HyperCandidateSpace::EstimateMemory(HG.get(), PG.get()) > opt.matching.max_memory_bytes) {
+            return Finish("memory_limit", "HCS over the memory limit");
+        }
+        HCS = std::make_unique<HyperCandidateSpace>(HG.get(), PG.get(), opt.matching);
+        answer.method = "hcs";
+        answer.filter_ms = HCS->initial_time;
+        answer.refine_ms = HCS->refine_time;
+        if (HCS->HasEmptyCandidateSet()) {
+            answer.method = "empty_hcs";
+            answer.num_embeddings = 0;
+            return Finish("ok", "");
+        }
+        if (!opt.enumerate and sink == nullptr) return Finish("ok", "");
+        std::string message;
+        std::string status = Backtrack(*PG, *HG, backtrack_opt, sink, answer, message);
+        return Finish(status, message);
+    }
+
+    /**
+     * @brief Enumerate the embeddings of the validated query PG into sink by backtracking over the data hypergraph
+     * of entry, the cached answer of a query isomorphic to it (canonical_vertex_id as given by CacheKey)
+     */
+    QueryAnswer MatchingService::EnumerateCached(PatternHyperGraph &PG, const std::vector<int> &canonical_vertex_id,
+                                                 const CachedQuery &entry,
+                                                 const SubgraphMatching::SubgraphMatchingOption &backtrack_opt,
+                                                 EmbeddingSink &sink) const {
+        QueryAnswer answer;
+        answer.cached = true;
+        answer.num_query_vertices = PG.GetNumVertices();
+        answer.num_query_hyperedges = PG.GetNumHyperedges();
+        answer.num_data_vertices = entry.data->GetNumVertices();
+        answer.num_data_hyperedges = entry.data->GetNumHyperedges();
+        if (entry.candidate_space->HasEmptyCandidateSet()) {
+            answer.method = "empty_hcs";
+            answer.num_embeddings = 0;
+            return answer;
+        }
+        // the vertices at the same canonical position correspond, and so do the hyperedges over them
+        PatternHyperGraph &cached = *entry.pattern;
+        std::vector<int> cached_vertex_at(PG.GetNumVertices()), vertex_map(PG.GetNumVertices());
+        for (int w = 0; w < cached.GetNumVertices(); w++) cached_vertex_at[entry.canonical_vertex_id[w]] = w;
+        for (int u = 0; u < PG.GetNumVertices(); u++) vertex_map[u] = cached_vertex_at[canonical_vertex_id[u]];
+        std::map<std::vector<int>, int> cached_hyperedge;
+        for (int e = 0; e < cached.GetNumHyperedges(); e++) cached_hyperedge[cached.GetHyperedge(e)] = e;
+        std::vector<int> hyperedge_map(PG.GetNumHyperedges());
+        for (int e = 0; e < PG.GetNumHyperedges(); e++) {
+            std::vector<int> image;
+            for (int u : PG.GetHyperedge(e)) image.push_back(vertex_map[u]);
+            std::sort(image.begin(), image.end());
+            hyperedge_map[e] = cached_hyperedge.at(image);
+        }
+        RenumberingSink renumbered(sink, vertex_map, hyperedge_map);
+        answer.status = Backtrack(cached, *entry.data, backtrack_opt, &renumbered, answer, answer.message);
+        return answer;
+    }
+
+    std::string MatchingService::Backtrack(PatternHyperGraph &PG, DataHyperGraph &HG,
+                                           const SubgraphMatching::SubgraphMatchingOption &backtrack_opt,
+                                           EmbeddingSink *sink, QueryAnswer &answer, std::string &message) const {
+        if (PG.GetNumVertices() + PG.GetNumHyperedges() > backtrack_opt.MAX_QUERY_VERTEX or
+            PG.GetTotalArity() > backtrack_opt.MAX_QUERY_EDGE) {
+            message = "bipartite representation too large to backtrack";
+            return "too_large";
+        }
+
+        PROFILE_SCOPE("Enumerate");
+        Timer timer;
+        timer.Start();
+        SubgraphMatching::DataGraph D(HG.BipartiteRepresentation());
+        D.Preprocess();
+        D.EnumerateLocalTriangles();
+        D.EnumerateLocalFourCycles();
+        SubgraphMatching::PatternGraph P(PG.BipartiteRepresentation());
+        // the engine keeps a large counting table inline, too large for the stack of a worker thread
+        auto backtrack = std::make_unique<SubgraphMatching::BacktrackEngine>(&D, backtrack_opt);
+        P.ProcessPattern(D);
+        P.EnumerateLocalTriangles();
+        P.EnumerateLocalFourCycles();
+        if (sink != nullptr) {
+            HyperEmbeddingSink hyper_sink(*sink, HG, PG.GetNumVertices(), PG.GetNumHyperedges());
+            backtrack->Match(&P, &hyper_sink);
+        }
+        else backtrack->Match(&P);
+        timer.Stop();
+        answer.method = "backtrack";
+        answer.num_embeddings = backtrack->num_embeddings;
+        answer.enumerate_ms = timer.GetTime();
+        auto status = backtrack->GetStatus();
+        // a sink stopping the search asked for no more embeddings: the answer is what it asked for
+        if (status != SubgraphMatching::SEARCH_COMPLETE and status != SubgraphMatching::SEARCH_STOPPED_BY_SINK) {
+            message = "search stopped early, partial count";
+            return SubgraphMatching::search_status_names[status];
+        }
+        message.clear();
+        return "ok";
+    }
+}
@@ -1,8 +1,15 @@
 #pragma once
 #include "DataStructure/HyperGraph/HyperGraph.h"
+#include "DataStructure/CanonicalLabeling.h"
 
 namespace GraphLib {
     namespace SubHyperGraphMatching {
+        enum HYPERGRAPH_PATTERN_SHAPE {
+            GENERAL_HYPERGRAPH_PATTERN,
+            SINGLE_HYPEREDGE_PATTERN,
+            // at least two hyperedges whose only common vertex, pairwise, is the center
+            STAR_HYPERGRAPH_PATTERN
+        };
         class PatternHyperGraph : public HyperGraph {
             std::map<std::vector<int>, int> hyperedge_label_map;
             std::unordered_map<int, int> vertex_label_map;
@@ -12,6 +19,42 @@ namespace GraphLib {
             PatternHyperGraph &operator=(const PatternHyperGraph &) = delete;
             PatternHyperGraph(const PatternHyperGraph &) = delete;
             void ReadPatternHyperGraph(const std::string &filename);
+            /**
+             * @brief Parse a query in the format of the query files: "|V| |E|", the vertex labels, then one
+             * comma-separated hyperedge per whitespace-separated token
+             * @return false if the input ends early or a number is malformed
+             */
+            static bool ParsePatternHyperGraph(std::istream &in, std::vector<int> &labels,
+                                               std::vector<std::vector<int>> &edges);
+            /**
+             * @brief Build the pattern from vertex labels (in the label space of the dataset) and hyperedges over
+             * 0..labels.size()-1, as ReadPatternHyperGraph does after parsing
+             */
+            void LoadPatternHyperGraph(const std::vector<int> &labels, const std::vector<std::vector<int>> &edges);
+
+            /**
+             * @brief Recognize the shapes that are counted directly (see DirectCounting.h)
+             * @param center set to the center of a star pattern
+             */
+            HYPERGRAPH_PATTERN_SHAPE ClassifyShape(int *center = nullptr);
+
+            /**
+             * @brief Distinct hyperedge label signatures of the pattern, in the label space of the dataset (sorted)
+             */
+            std::vector<std::vector<int>> GetDatasetHyperedgeSignatures() const;
+            /**
+             * @brief Label of each vertex in the label space of the dataset (as read)
+             */
+            std::vector<int> GetDatasetVertexLabels() const;
+
+            /**
+             * @brief Code of the pattern that does not depend on the numbering of its vertices or the order of its
+             * hyperedges: the canonical code (CanonicalLabeling) of the vertex-hyperedge incidence graph, with the
+             * vertex labels in the label space of the dataset
+             * @param canonical_vertex_id if given, receives the canonical position of each vertex
+             * @return false if the search was cut (the code is exact, but isomorphic patterns may differ in it)
+             */
+            bool GetCanonicalCode(std::vector<int> &code, std::vector<int> *canonical_vertex_id = nullptr) const;
 
             int GetMappedVertexLabel(const int l) {
                 if (vertex_label_map.find(l) == vertex_label_map.end())
@@ -30,11 +73,42 @@ namespace GraphLib {
         void PatternHyperGraph::ReadPatternHyperGraph(const string &filename) {
             std::cerr << "Read " << fileSize(filename.c_str()) << " bytes from " << filename << endl;
             std::ifstream fin(filename);
-            fin >> num_vertex >> num_edge;
-            vertex_label.resize(num_vertex);
-            for (int i = 0; i < num_vertex; i++) {
-                fin >> vertex_label[i];
+            std::vector<int> labels;
+            std::vector<std::vector<int>> edges;
+            ParsePatternHyperGraph(fin, labels, edges);
+            LoadPatternHyperGraph(labels, edges);
+        }
+
+        bool PatternHyperGraph::ParsePatternHyperGraph(std::istream &in, std::vector<int> &labels,
+                                                       std::vector<std::vector<int>> &edges) {
+            labels.clear();
+            edges.clear();
+            int n = 0, m = 0;
+            if (!(in >> n >> m) or n < 0 or m < 0) return false;
+            for (int i = 0; i < n; i++) {
+                int l;
+                if (!(in >> l)) return false;
+                labels.push_back(l);
+            }
+            std::string line;
+            for (int i = 0; i < m; i++) {
+                if (!(in >> line)) return false;
+                auto edge = parse(line, ",");
+                edges.push_back(std::vector<int>());
+                for (auto &elem : edge) {
+                    char *end = nullptr;
+                    long x = strtol(elem.c_str(), &end, 10);
+                    if (elem.empty() or *end != '\0') return false;
+                    edges.back().push_back(x);
+                }
             }
+            return true;
+        }
+
+        void PatternHyperGraph::LoadPatternHyperGraph(const std::vector<int> &labels,
+                                                      const std::vector<std::vector<int>> &edges) {
+            num_vertex = labels.size();
+            vertex_label = labels;
             for (int i = 0; i < num_vertex; i++) {
                 int l = vertex_label[i];
                 if (vertex_label_map.find(l) == vertex_label_map.end()) {
@@ -43,15 +117,9 @@ namespace GraphLib {
                 vertex_label[i] = vertex_label_map[l];
             }
 
-            std::string line;
-            for (int i = 0; i < num_edge; i++) {
-                fin >> line;
-                auto edge = parse(line, ",");
-                hyperedges.push_back(std::vector<int>());
+            for (auto &edge : edges) {
+                hyperedges.push_back(edge);
                 auto &E = hyperedges.back();
-                for (auto &elem : edge) {
-                    E.push_back(stoi(elem));
-                }
                 std::sort(E.begin(), E.end());
                 E.erase(std::unique(E.begin(), E.end()), E.end());
                 if (E.size() == 1) { hyperedges.pop_back(); continue; }
@@ -86,5 +154,63 @@ namespace GraphLib {
 //                fprintf(stderr,"\n");
 //            }
         }
+
+        std::vector<std::vector<int>> PatternHyperGraph::GetDatasetHyperedgeSignatures() const {
+            std::vector<int> dataset_label(num_vertex_labels);
+            for (auto &[l, mapped] : vertex_label_map) dataset_label[mapped] = l;
+            std::vector<std::vector<int>> signatures;
+            for (auto &[signature, label] : hyperedge_label_map) {
+                signatures.emplace_back();
+                for (int l : signature) signatures.back().push_back(dataset_label[l]);
+                std::sort(signatures.back().begin(), signatures.back().end());
+            }
+            return signatures;
+        }
+
+        std::vector<int> PatternHyperGraph::GetDatasetVertexLabels() const {
+            std::vector<int> dataset_label(num_vertex_labels), labels(num_vertex);
+            for (auto &[l, mapped] : vertex_label_map) dataset_label[mapped] = l;
+            for (int u = 0; u < num_vertex; u++) labels[u] = dataset_label[vertex_label[u]];
+            return labels;
+        }
+
+        bool PatternHyperGraph::GetCanonicalCode(std::vector<int> &code, std::vector<int> *canonical_vertex_id) const {
+            std::vector<int> labels = GetDatasetVertexLabels();
+            // vertices first (color {0, label}), then hyperedges (color {1}), so vertices keep positions 0..|V|-1
+            std::vector<std::vector<int>> colors(num_vertex + num_edge), incidence(num_vertex + num_edge);
+            for (int u = 0; u < num_vertex; u++) colors[u] = {0, labels[u]};
+            for (int e = 0; e < num_edge; e++) {
+                colors[num_vertex + e] = {1};
+                for (int u : hyperedges[e]) {
+                    incidence[u].push_back(num_vertex + e);
+                    incidence[num_vertex + e].push_back(u);
+                }
+            }
+            CanonicalLabeling labeling(colors, incidence);
+            code = labeling.GetCode();
+            if (canonical_vertex_id != nullptr) {
+                auto position = labeling.GetPosition();
+                canonical_vertex_id->assign(position.begin(), position.begin() + num_vertex);
+            }
+            return labeling.IsComplete();
+        }
+
+        HYPERGRAPH_PATTERN_SHAPE PatternHyperGraph::ClassifyShape(int *center) {
+            for (int u = 0; u < GetNumVertices(); u++) {
+                if (GetDegree(u) == 0) return GENERAL_HYPERGRAPH_PATTERN;
+            }
+            if (GetNumHyperedges() == 1) return SINGLE_HYPEREDGE_PATTERN;
+            if (GetNumHyperedges() == 0) return GENERAL_HYPERGRAPH_PATTERN;
+            // a star has exactly one vertex of degree > 1, contained in every hyperedge
+            int c = -1;
+            for (int u = 0; u < GetNumVertices(); u++) {
+                if (GetDegree(u) == 1) continue;
+                if (c != -1 or GetDegree(u) != GetNumHyperedges()) return GENERAL_HYPERGRAPH_PATTERN;
+                c = u;
+            }
+            if (c == -1) return GENERAL_HYPERGRAPH_PATTERN;
+            if (center != nullptr) *center = c;
+            return STAR_HYPERGRAPH_PATTERN;
+        }
     }
 }
\ No newline at end of file
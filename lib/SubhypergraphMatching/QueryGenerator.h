@@ -0,0 +1,153 @@
+#pragma once
+#include <fstream>
+#include <unordered_map>
+#include "SubhypergraphMatching/DataHyperGraph.h"
+#include "Base/Random.h"
+
+namespace GraphLib::SubHyperGraphMatching {
+    struct QueryGeneratorOption {
+        // only hyperedges of arity in [min_arity, max_arity] are walked on
+        int min_arity = 2, max_arity = 1 << 30;
+        // number of distinct vertex labels of an accepted query
+        int min_distinct_labels = 1, max_distinct_labels = 1 << 30;
+        int max_vertices = 1 << 30;
+        // walks tried per query before giving up
+        int max_attempts = 1000;
+    };
+
+    /**
+     * @brief Connected queries sampled from a dataset by random walks over its hyperedges
+     * @details As in testsuite/hyperquery-generation.py: the walk starts at a uniformly random hyperedge and moves
+     * from the current hyperedge to a vertex of it, chosen with probability proportional to (degree - 1), then to a
+     * not yet chosen hyperedge incident to that vertex. When the current vertex has no hyperedge left, the walk
+     * restarts from a random vertex of the chosen hyperedges. The query is the union of the chosen hyperedges with
+     * the data labels, so the identity map is an embedding: every generated query has at least one.
+     */
+    class QueryGenerator {
+        const HyperGraphDataset &data;
+        QueryGeneratorOption opt;
+        std::vector<std::vector<int>> incidence_list;
+        std::vector<int> walkable;
+
+        inline bool Walkable(int f) const {
+            int a = data.hyperedges[f].size();
+            return opt.min_arity <= a and a <= opt.max_arity;
+        }
+        bool Walk(int num_hyperedges, SplitMix64 &rng, std::vector<int> &chosen);
+    public:
+        QueryGenerator(const HyperGraphDataset &data_, const QueryGeneratorOption &opt_);
+
+        /**
+         * @brief Sample a query of num_hyperedges hyperedges: vertex labels (dataset label space) and hyperedges
+         * over 0..labels.size()-1, with vertices numbered in order of appearance
+         * @return false if no walk of that size satisfying the options was found within max_attempts
+         */
+        bool Sample(int num_hyperedges, SplitMix64 &rng, std::vector<int> &labels,
+                    std::vector<std::vector<int>> &hyperedges);
+
+        /**
+         * @brief Write a query in the format of PatternHyperGraph::ReadPatternHyperGraph
+         */
+        static void WriteQuery(const std::string &filename, const std::vector<int> &labels,
+                               const std::vector<std::vector<int>> &hyperedges);
+    };
+
+    QueryGenerator::QueryGenerator(const HyperGraphDataset &data_, const QueryGeneratorOption &opt_)
+        : data(data_), opt(opt_) {
+        incidence_list.resize(data.vertex_label.size());
+        for (int f = 0; f < (int)data.hyperedges.size(); f++) {
+            if (!Walkable(f)) continue;
+            walkable.push_back(f);
+            for (int v : data.hyperedges[f]) incidence_list[v].push_back(f);
+        }
+    }
+
+    bool QueryGenerator::Walk(int num_hyperedges, SplitMix64 &rng, std::vector<int> &chosen) {
+        chosen.clear();
+        if (walkable.empty()) return false;
+        chosen.push_back(walkable[rng() % walkable.size()]);
+        std::vector<double> weight;
+        int num_restarts = 0;
+        while ((int)chosen.size() < num_hyperedges) {
+            auto &last = data.hyperedges[chosen.back()];
+            weight.clear();
+            double total = 0.0;
+            for (int v : last) {
+                weight.push_back(incidence_list[v].size() - 1.0);
+                total += weight.back();
+            }
+            int cur = -1;
+            if (total > 0) {
+                double x = std::uniform_real_distribution<double>(0.0, total)(rng);
+                for (size_t i = 0; i < last.size(); i++) {
+                    cur = last[i];
+                    if ((x -= weight[i]) < 0) break;
+                }
+            }
+            int nxt = -1;
+            if (cur != -1) {
+                auto &incident = incidence_list[cur];
+                for (int trial = 0; trial < 8 and nxt == -1; trial++) {
+                    int f = incident[rng() % incident.size()];
+                    if (std::find(chosen.begin(), chosen.end(), f) == chosen.end()) nxt = f;
+                }
+            }
+            if (nxt == -1) {
+                // restart from a random vertex of the chosen hyperedges
+                if (++num_restarts > 4 * num_hyperedges) return false;
+                auto &e = data.hyperedges[chosen[rng() % chosen.size()]];
+                auto &incident = incidence_list[e[rng() % e.size()]];
+                int f = incident[rng() % incident.size()];
+                if (std::find(chosen.begin(), chosen.end(), f) != chosen.end()) continue;
+                nxt = f;
+            }
+            chosen.push_back(nxt);
+        }
+        return true;
+    }
+
+    bool QueryGenerator::Sample(int num_hyperedges, SplitMix64 &rng, std::vector<int> &labels,
+                                std::vector<std::vector<int>> &hyperedges) {
+        std::vector<int> chosen;
+        std::unordered_map<int, int> local_id;
+        for (int attempt = 0; attempt < opt.max_attempts; attempt++) {
+            if (!Walk(num_hyperedges, rng, chosen)) continue;
+            local_id.clear();
+            labels.clear();
+            hyperedges.clear();
+            for (int f : chosen) {
+                hyperedges.emplace_back();
+                for (int v : data.hyperedges[f]) {
+                    auto [it, inserted] = local_id.try_emplace(v, labels.size());
+                    if (inserted) labels.push_back(data.vertex_label[v]);
+                    hyperedges.back().push_back(it->second);
+                }
+                std::sort(hyperedges.back().begin(), hyperedges.back().end());
+            }
+            std::vector<int> distinct = labels;
+            std::sort(distinct.begin(), distinct.end());
+            int num_distinct = std::unique(distinct.begin(), distinct.end()) - distinct.begin();
+            if ((int)labels.size() > opt.max_vertices) continue;
+            if (num_distinct < opt.min_distinct_labels or num_distinct > opt.max_distinct_labels) continue;
+            return true;
+        }
+        return false;
+    }
+
+    void QueryGenerator::WriteQuery(const std::string &filename, const std::vector<int> &labels,
+                                    const std::vector<std::vector<int>> &hyperedges) {
+        FILE *fp = fopen(filename.c_str(), "w");
+        if (fp == nullptr) {
+            fprintf(stderr, "Cannot open %s\n", filename.c_str());
+            exit(1);
+        }
+        fprintf(fp, "%zu %zu\n", labels.size(), hyperedges.size());
+        for (size_t i = 0; i < labels.size(); i++) fprintf(fp, "%s%d", i ? " " : "", labels[i]);
+        fputc('\n', fp);
+        for (auto &e : hyperedges) {
+            for (size_t i = 0; i < e.size(); i++) fprintf(fp, "%s%d", i ? "," : "", e[i]);
+            fputc('\n', fp);
+        }
+        fclose(fp);
+    }
+}
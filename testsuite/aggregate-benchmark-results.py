@@ -0,0 +1,40 @@
+"""
+Summarize the rows recorded by subhypergraph-matching-benchmark.py, one line per (dataset, commit),
+and compare every commit with the previous one on the same dataset.
+usage: python3 aggregate-benchmark-results.py [SubhypergraphMatching/benchmark-results.csv]
+"""
+import sys
+import pandas as pd
+
+record_path = sys.argv[1] if len(sys.argv) > 1 else "SubhypergraphMatching/benchmark-results.csv"
+phases = ['extract_ms', 'filter_ms', 'refine_ms', 'enumerate_ms']
+
+df = pd.read_csv(record_path)
+df = df[df['status'] == 'ok'].copy()
+df['total_ms'] = df[phases].sum(axis=1)
+# commits in the order they were first benchmarked
+order = {sha: i for i, sha in enumerate(dict.fromkeys(df['gitver']))}
+
+summary = df.groupby(['dataset', 'gitver']).agg(
+    date=('date', 'last'),
+    num_queries=('query', 'nunique'),
+    total_ms=('total_ms', 'sum'),
+    mean_ms=('total_ms', 'mean'),
+    p95_ms=('total_ms', lambda x: x.quantile(0.95)),
+    **{f"{p}_sum": (p, 'sum') for p in phases},
+    cs_v_after=('cs_v_after', 'sum'),
+    cs_e_after=('cs_e_after', 'sum'),
+    peak_rss_kb=('peak_rss_kb', 'max'),
+).reset_index()
+summary['order'] = summary['gitver'].map(order)
+summary = summary.sort_values(['dataset', 'order']).drop(columns='order')
+summary['speedup_vs_prev'] = summary.groupby('dataset')['total_ms'].transform(lambda x: x.shift(1) / x)
+pd.set_option('display.width', 200)
+print(summary.to_string(index=False))
+
+# embedding counts must not depend on the commit
+counts = df[df['num_embeddings'] >= 0].groupby(['dataset', 'query'])['num_embeddings'].nunique()
+inconsistent = counts[counts > 1]
+if len(inconsistent) > 0:
+    print(f"\n{len(inconsistent)} queries have different embedding counts across commits:")
+    print(df.set_index(['dataset', 'query']).loc[inconsistent.index, ['gitver', 'num_embeddings']].to_string())
@@ -0,0 +1,142 @@
+"""
+Behavior checks of the subhypergraph matching driver: every run is compared with the exact counts of a plain -e run
+of the same queries. Usage: subhypergraph-matching-checks.py [dataset [query_name...]]
+"""
+from subprocess import Popen, PIPE
+import csv
+import sys
+import os
+from collections import Counter
+
+binary_path = "../build/SubhypergraphMatching"
+dataset_path = "../dataset/hypergraphs/"
+work_path = "SubhypergraphMatching/checks"
+
+
+def execute_binary(cmd):
+    process = Popen(cmd, shell=True, stdout=PIPE, stderr=PIPE)
+    (std_output, std_error) = process.communicate()
+    process.wait()
+    rc = process.returncode
+    return rc, std_output, std_error
+
+
+def run_batch(data, query_list, tag, flags, expected_rc=0):
+    """Run the batch of query_list with extra flags and read back its result rows, by query name"""
+    output = f"{work_path}/{data}-{tag}.csv"
+    cmd = f"{binary_path} -d {data} -p {dataset_path} -b {query_list} -o {output} {flags}"
+    print(cmd)
+    rc, _, std_error = execute_binary(cmd)
+    if rc != expected_rc:
+        print(str(std_error, encoding='utf-8')[-2000:])
+        raise RuntimeError(f"{cmd} exited with {rc}")
+    with open(output) as f:
+        return {row['query']: row for row in csv.DictReader(f)}
+
+
+def check_sinks(data, query_list, exact):
+    """-E writes one line per embedding; -G enumerates again through GenerateEmbeddings and checks each one"""
+    failures = []
+    embeddings = f"{work_path}/{data}-embeddings.txt"
+    rows = run_batch(data, query_list, "embeddings", f"-E {embeddings}")
+    with open(embeddings) as f:
+        num_lines = Counter(line.split()[0] for line in f if line.strip())
+    for query, count in exact.items():
+        if int(rows[query]['num_embeddings']) != count or num_lines[query] != count:
+            failures.append(f"-E {query}: {num_lines[query]} lines, {rows[query]['num_embeddings']} counted, "
+                            f"expected {count}")
+    rows = run_batch(data, query_list, "generator", "-G")
+    for query, count in exact.items():
+        row = rows[query]
+        if row['generator_check'] != 'ok' or int(row['generated_embeddings']) != count:
+            failures.append(f"-G {query}: {row['generator_check']}, {row['generated_embeddings']} generated, "
+                            f"expected {count}")
+    return failures
+
+
+def check_factorized(data, query_list, exact):
+    """-X writes factorized results; -R reads them back, expands every result and checks each embedding"""
+    failures = []
+    factorized = f"{work_path}/{data}-results.bin"
+    rows = run_batch(data, query_list, "factorized", f"-X {factorized}")
+    for query, count in exact.items():
+        if int(rows[query]['num_embeddings']) != count:
+            failures.append(f"-X {query}: {rows[query]['num_embeddings']} counted, expected {count}")
+    rows = run_batch(data, query_list, "roundtrip", f"-R {factorized}")
+    for query, count in exact.items():
+        row = rows.get(query)
+        if row is None:
+            failures.append(f"-R {query}: no section")
+        elif row['factorized_check'] != 'ok' or int(row['num_embeddings']) != count:
+            failures.append(f"-R {query}: {row['factorized_check']}, {row['num_embeddings']} expanded, "
+                            f"expected {count}")
+    return failures
+
+
+def check_limits(data, query_list, exact):
+    """-L, -N and -t stop the enumeration (method backtrack) with status match_limit, node_limit or time_limit and
+    the embeddings found so far; loose limits change nothing, and directly counted queries ignore them"""
+    failures = []
+
+    def check(tag, flags, expect):
+        rows = run_batch(data, query_list, tag, flags)
+        for query, count in exact.items():
+            row = rows[query]
+            found = int(row['num_embeddings'])
+            if row['method'] == 'backtrack':
+                ok = expect(row['status'], found, count)
+            else:
+                ok = row['status'] == 'ok' and found == count
+            if not ok:
+                failures.append(f"{flags} {query}: {row['status']}, {found} found, {count} exist")
+
+    for k in [0, 5]:
+        check(f"match-limit-{k}", f"-e -L {k}", lambda status, found, count, k=k:
+              found == min(count, k) and status == ('ok' if count < k else 'match_limit'))
+    check("node-limit", "-e -N 1",
+          lambda status, found, count: found <= count and status in ['ok', 'node_limit'])
+    check("time-limit", "-e -t 0.001",
+          lambda status, found, count: found <= count and status in ['ok', 'time_limit'])
+    check("loose-limits", "-e -L 1000000000000 -N 1000000000000 -t 100000000",
+          lambda status, found, count: found == count and status == 'ok')
+    return failures
+
+
+def check_estimates(data, query_list, exact, median_q_error_bound=2.0):
+    """-A estimates every query by sampling: the estimate lies in its confidence interval, is 0 when no embedding
+    exists (a walk only completes on an embedding), and its median q-error stays small"""
+    failures = []
+    rows = run_batch(data, query_list, "estimates", "-e -A 50")
+    q_errors = []
+    for query, count in exact.items():
+        row = rows[query]
+        estimate, low, high = float(row['estimate']), float(row['estimate_ci_low']), float(row['estimate_ci_high'])
+        if not (0 <= low <= estimate <= high) or (count == 0 and estimate != 0):
+            failures.append(f"-A {query}: estimate {estimate} in [{low}, {high}], {count} exist")
+        q_error = float(row['q_error'])
+        if q_error <= 0:
+            failures.append(f"-A {query}: no q-error")
+            continue
+        q_errors.append(max(q_error, 1 / q_error))
+    q_errors.sort()
+    if q_errors and q_errors[len(q_errors) // 2] > median_q_error_bound:
+        failures.append(f"-A median q-error {q_errors[len(q_errors) // 2]:.3f} over {median_q_error_bound}")
+    return failures
+
+
+if __name__ == '__main__':
+    data = sys.argv[1] if len(sys.argv) > 1 else 'contact-high-school'
+    query_names = sys.argv[2:] if len(sys.argv) > 2 else [f"query_{sz}_{idx}" for sz in [3, 4] for idx in range(50)]
+    os.makedirs(work_path, exist_ok=True)
+    query_list = f"{work_path}/{data}-queries.txt"
+    with open(query_list, 'w') as f:
+        f.write("\n".join(query_names) + "\n")
+    exact_rows = run_batch(data, query_list, "exact", "-e")
+    exact = {query: int(row['num_embeddings']) for query, row in exact_rows.items() if row['status'] == 'ok'}
+    failures = []
+    for check in [check_sinks, check_factorized, check_limits, check_estimates]:
+        failures += check(data, query_list, exact)
+    for failure in failures:
+        print("FAILED", failure)
+    print(f"{len(exact)} queries, {len(failures)} failures")
+    sys.exit(1 if failures else 0)